@@ -0,0 +1,480 @@
+/*
+ * AVX-512 versions of vVector's elementwise ops and reductions, with the remainder handled
+ * by opmask loads and stores rather than a scalar tail, and a 256-bit version of each so
+ * that the width can be chosen at run time.
+ *
+ * On many Intel parts sustained 512-bit work lowers the core clock, and the switch takes
+ * some microseconds. A short burst of zmm instructions pays the lower clock without
+ * getting much of the doubled width back, so by default the 512-bit kernels are only used
+ * for vectors of at least min_512_elements(). That threshold can be set, or measured on
+ * the host with calibrate(), and the width can be fixed with set_width() or by setting
+ * CC_SIMD_WIDTH=256 or 512 in the environment. Every op also takes an explicit width.
+ *
+ *   cc::avx512::calibrate();
+ *   cc::avx512::mult (a, b, out);              // width chosen from a.size()
+ *   float s = cc::avx512::sum (a, cc::avx512::width::w512);
+ *
+ * Build with -mavx512f -mavx512vl for both widths (the 256-bit kernels then use AVX-512VL
+ * opmasks too). Built with only -mavx2 there are only the 256-bit kernels, whose tails use
+ * vmaskmov. have_512() chooses between the kernels; it doesn't make a -mavx512f binary safe
+ * on a CPU without AVX-512, as the compiler may use AVX-512 instructions anywhere in such a
+ * build. Hosts without AVX-512 need the -mavx2 build.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+
+#if !defined(__AVX2__)
+# error "avx512_ops.h needs at least -mavx2"
+#endif
+
+namespace cc {
+    namespace avx512 {
+
+        enum class width { automatic, w256, w512 };
+
+        namespace detail {
+
+            // One traits struct per register width and element type: loads, stores, masked
+            // tail loads/stores (masked-off lanes read as fill) and arithmetic.
+            template <typename T> struct v256;
+
+            template <>
+            struct v256<float>
+            {
+                typedef __m256 reg;
+                static constexpr size_t n = 8;
+                static reg load (const float* p) { return _mm256_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm256_storeu_ps (p, v); }
+#if defined(__AVX512VL__)
+                static __mmask8 mask (size_t rem) { return static_cast<__mmask8>((1u << rem) - 1); }
+                static reg load_tail (const float* p, size_t rem, float fill) { return _mm256_mask_loadu_ps (_mm256_set1_ps (fill), mask (rem), p); }
+                static void store_tail (float* p, reg v, size_t rem) { _mm256_mask_storeu_ps (p, mask (rem), v); }
+#else
+                static __m256i mask (size_t rem)
+                {
+                    return _mm256_cmpgt_epi32 (_mm256_set1_epi32 (static_cast<int>(rem)), _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7));
+                }
+                static reg load_tail (const float* p, size_t rem, float fill)
+                {
+                    __m256i m = mask (rem);
+                    return _mm256_blendv_ps (_mm256_set1_ps (fill), _mm256_maskload_ps (p, m), _mm256_castsi256_ps (m));
+                }
+                static void store_tail (float* p, reg v, size_t rem) { _mm256_maskstore_ps (p, mask (rem), v); }
+#endif
+                static reg set1 (float f) { return _mm256_set1_ps (f); }
+                static reg add (reg a, reg b) { return _mm256_add_ps (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_ps (a, b); }
+                static reg div (reg a, reg b) { return _mm256_div_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_ps (a, b); }
+                static reg sqrt (reg a) { return _mm256_sqrt_ps (a); }
+            };
+
+            template <>
+            struct v256<double>
+            {
+                typedef __m256d reg;
+                static constexpr size_t n = 4;
+                static reg load (const double* p) { return _mm256_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm256_storeu_pd (p, v); }
+#if defined(__AVX512VL__)
+                static __mmask8 mask (size_t rem) { return static_cast<__mmask8>((1u << rem) - 1); }
+                static reg load_tail (const double* p, size_t rem, double fill) { return _mm256_mask_loadu_pd (_mm256_set1_pd (fill), mask (rem), p); }
+                static void store_tail (double* p, reg v, size_t rem) { _mm256_mask_storeu_pd (p, mask (rem), v); }
+#else
+                static __m256i mask (size_t rem)
+                {
+                    return _mm256_cmpgt_epi64 (_mm256_set1_epi64x (static_cast<long long>(rem)), _mm256_setr_epi64x (0, 1, 2, 3));
+                }
+                static reg load_tail (const double* p, size_t rem, double fill)
+                {
+                    __m256i m = mask (rem);
+                    return _mm256_blendv_pd (_mm256_set1_pd (fill), _mm256_maskload_pd (p, m), _mm256_castsi256_pd (m));
+                }
+                static void store_tail (double* p, reg v, size_t rem) { _mm256_maskstore_pd (p, mask (rem), v); }
+#endif
+                static reg set1 (double f) { return _mm256_set1_pd (f); }
+                static reg add (reg a, reg b) { return _mm256_add_pd (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_pd (a, b); }
+                static reg div (reg a, reg b) { return _mm256_div_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_pd (a, b); }
+                static reg sqrt (reg a) { return _mm256_sqrt_pd (a); }
+            };
+
+#if defined(__AVX512F__)
+            template <typename T> struct v512;
+
+            template <>
+            struct v512<float>
+            {
+                typedef __m512 reg;
+                static constexpr size_t n = 16;
+                static __mmask16 mask (size_t rem) { return static_cast<__mmask16>((1u << rem) - 1); }
+                static reg load (const float* p) { return _mm512_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm512_storeu_ps (p, v); }
+                static reg load_tail (const float* p, size_t rem, float fill) { return _mm512_mask_loadu_ps (_mm512_set1_ps (fill), mask (rem), p); }
+                static void store_tail (float* p, reg v, size_t rem) { _mm512_mask_storeu_ps (p, mask (rem), v); }
+                static reg set1 (float f) { return _mm512_set1_ps (f); }
+                static reg add (reg a, reg b) { return _mm512_add_ps (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_ps (a, b); }
+                static reg div (reg a, reg b) { return _mm512_div_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_ps (a, b); }
+                static reg sqrt (reg a) { return _mm512_sqrt_ps (a); }
+            };
+
+            template <>
+            struct v512<double>
+            {
+                typedef __m512d reg;
+                static constexpr size_t n = 8;
+                static __mmask8 mask (size_t rem) { return static_cast<__mmask8>((1u << rem) - 1); }
+                static reg load (const double* p) { return _mm512_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm512_storeu_pd (p, v); }
+                static reg load_tail (const double* p, size_t rem, double fill) { return _mm512_mask_loadu_pd (_mm512_set1_pd (fill), mask (rem), p); }
+                static void store_tail (double* p, reg v, size_t rem) { _mm512_mask_storeu_pd (p, mask (rem), v); }
+                static reg set1 (double f) { return _mm512_set1_pd (f); }
+                static reg add (reg a, reg b) { return _mm512_add_pd (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_pd (a, b); }
+                static reg div (reg a, reg b) { return _mm512_div_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_pd (a, b); }
+                static reg sqrt (reg a) { return _mm512_sqrt_pd (a); }
+            };
+#endif
+
+            //! Elements per OpenMP chunk. A multiple of every register width, so only the last chunk has a tail.
+            constexpr size_t chunk = 16384;
+
+            //! fn(c) for c in [0, nc), starting an OpenMP team only if there's more than one chunk
+            template <typename Fn>
+            inline void for_chunks (const long long nc, Fn fn)
+            {
+                if (nc <= 1) {
+                    if (nc == 1) { fn (0); }
+                } else {
+#pragma omp parallel for
+                    for (long long c = 0; c < nc; ++c) { fn (c); }
+                }
+            }
+
+            //! out[i] = op(a[i], b[i]) for i in [0, n). Masked-off tail lanes are loaded as fill.
+            template <typename V, typename T, typename Op>
+            void binary (const T* a, const T* b, T* out, size_t n, T fill, Op op)
+            {
+                const long long nc = static_cast<long long>((n + chunk - 1) / chunk);
+                for_chunks (nc, [&](long long c) {
+                    size_t i = c * chunk;
+                    const size_t hi = std::min (n, i + chunk);
+                    for (; i + V::n <= hi; i += V::n) { V::store (out + i, op (V::load (a + i), V::load (b + i))); }
+                    if (i < hi) {
+                        const size_t rem = hi - i;
+                        V::store_tail (out + i, op (V::load_tail (a + i, rem, fill), V::load_tail (b + i, rem, fill)), rem);
+                    }
+                });
+            }
+
+            //! Fold map(a[i], b[i]) with comb, starting from neutral, which is also the fill for masked-off lanes
+            template <typename V, typename T, typename Map, typename Comb, typename SComb>
+            T reduce (const T* a, const T* b, size_t n, T neutral, Map map, Comb comb, SComb scomb)
+            {
+                typedef typename V::reg reg;
+                const long long nc = static_cast<long long>((n + chunk - 1) / chunk);
+                // One partial per chunk, folded in chunk order, so the result doesn't depend on thread timing
+                std::vector<T> parts (static_cast<size_t>(nc), neutral);
+                for_chunks (nc, [&](long long c) {
+                    size_t i = c * chunk;
+                    const size_t hi = std::min (n, i + chunk);
+                    // Four accumulators to cover the latency of the combining op
+                    reg acc0 = V::set1 (neutral), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+                    for (; i + 4 * V::n <= hi; i += 4 * V::n) {
+                        acc0 = comb (acc0, map (V::load (a + i), V::load (b + i)));
+                        acc1 = comb (acc1, map (V::load (a + i + V::n), V::load (b + i + V::n)));
+                        acc2 = comb (acc2, map (V::load (a + i + 2 * V::n), V::load (b + i + 2 * V::n)));
+                        acc3 = comb (acc3, map (V::load (a + i + 3 * V::n), V::load (b + i + 3 * V::n)));
+                    }
+                    for (; i + V::n <= hi; i += V::n) { acc0 = comb (acc0, map (V::load (a + i), V::load (b + i))); }
+                    if (i < hi) {
+                        const size_t rem = hi - i;
+                        acc1 = comb (acc1, map (V::load_tail (a + i, rem, neutral), V::load_tail (b + i, rem, neutral)));
+                    }
+                    acc0 = comb (comb (acc0, acc1), comb (acc2, acc3));
+                    alignas(64) T lanes[V::n];
+                    V::store (lanes, acc0);
+                    T part = lanes[0];
+                    for (size_t l = 1; l < V::n; ++l) { part = scomb (part, lanes[l]); }
+                    parts[c] = part;
+                });
+                T result = neutral;
+                for (const T& p : parts) { result = scomb (result, p); }
+                return result;
+            }
+
+            inline width initial_width()
+            {
+                const char* e = std::getenv ("CC_SIMD_WIDTH");
+                if (e != nullptr && std::strcmp (e, "256") == 0) { return width::w256; }
+                if (e != nullptr && std::strcmp (e, "512") == 0) { return width::w512; }
+                return width::automatic;
+            }
+            inline width& preferred_width() { static width w = initial_width(); return w; }
+            inline size_t& min_512() { static size_t m = 65536; return m; }
+
+            //! Call fn with a v512<T> or a v256<T> according to w
+            template <typename T, typename Fn>
+            auto with_width (width w, Fn fn)
+            {
+#if defined(__AVX512F__)
+                if (w == width::w512) { return fn (v512<T>{}); }
+#endif
+                return fn (v256<T>{});
+            }
+
+            template <typename T>
+            void check_sizes (const morph::vVector<T>& a, const morph::vVector<T>& b)
+            {
+                if (a.size() != b.size()) { throw std::runtime_error ("avx512: vVectors must be the same size"); }
+            }
+        } // namespace detail
+
+        /*!
+         * True if this build has the 512-bit kernels and the CPU can run them. Only useful as a
+         * choice of kernel: a false here in a -mavx512f build doesn't stop the rest of the
+         * program from using AVX-512 instructions the CPU lacks.
+         */
+        inline bool have_512()
+        {
+#if defined(__AVX512F__)
+            static const bool h = __builtin_cpu_supports ("avx512f");
+            return h;
+#else
+            return false;
+#endif
+        }
+
+        //! Fix the width used by the automatic choice (width::automatic to choose by length again)
+        inline void set_width (width w) { detail::preferred_width() = w; }
+        //! Vectors of at least this many elements use the 512-bit kernels in the automatic choice
+        inline void set_min_512_elements (size_t n) { detail::min_512() = n; }
+        inline size_t min_512_elements() { return detail::min_512(); }
+
+        //! The width that an op on n elements will use
+        inline width choose (size_t n, width w = width::automatic)
+        {
+            if (!have_512()) { return width::w256; }
+            if (w == width::automatic) { w = detail::preferred_width(); }
+            if (w == width::automatic) { w = n >= detail::min_512() ? width::w512 : width::w256; }
+            return w;
+        }
+
+        // Elementwise ops. out must already be the same size as the inputs.
+
+        //! out = a + b
+        template <typename T>
+        void add (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out, width w = width::automatic)
+        {
+            detail::check_sizes (a, out);
+            detail::check_sizes (b, out);
+            detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                detail::binary<V> (a.data(), b.data(), out.data(), a.size(), T{0},
+                                   [](typename V::reg x, typename V::reg y) { return V::add (x, y); });
+            });
+        }
+
+        //! out = a - b
+        template <typename T>
+        void sub (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out, width w = width::automatic)
+        {
+            detail::check_sizes (a, out);
+            detail::check_sizes (b, out);
+            detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                detail::binary<V> (a.data(), b.data(), out.data(), a.size(), T{0},
+                                   [](typename V::reg x, typename V::reg y) { return V::sub (x, y); });
+            });
+        }
+
+        //! out = a * b
+        template <typename T>
+        void mult (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out, width w = width::automatic)
+        {
+            detail::check_sizes (a, out);
+            detail::check_sizes (b, out);
+            detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                detail::binary<V> (a.data(), b.data(), out.data(), a.size(), T{0},
+                                   [](typename V::reg x, typename V::reg y) { return V::mul (x, y); });
+            });
+        }
+
+        //! out = a / b. Masked-off lanes are filled with 1 so the tail doesn't compute 0/0.
+        template <typename T>
+        void div (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out, width w = width::automatic)
+        {
+            detail::check_sizes (a, out);
+            detail::check_sizes (b, out);
+            detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                detail::binary<V> (a.data(), b.data(), out.data(), a.size(), T{1},
+                                   [](typename V::reg x, typename V::reg y) { return V::div (x, y); });
+            });
+        }
+
+        //! out = a * s
+        template <typename T>
+        void scale (const morph::vVector<T>& a, const T s, morph::vVector<T>& out, width w = width::automatic)
+        {
+            detail::check_sizes (a, out);
+            detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                const typename V::reg sv = V::set1 (s);
+                detail::binary<V> (a.data(), a.data(), out.data(), a.size(), T{0},
+                                   [sv](typename V::reg x, typename V::reg) { return V::mul (x, sv); });
+            });
+        }
+
+        //! out = sqrt(a)
+        template <typename T>
+        void sqrt (const morph::vVector<T>& a, morph::vVector<T>& out, width w = width::automatic)
+        {
+            detail::check_sizes (a, out);
+            detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                detail::binary<V> (a.data(), a.data(), out.data(), a.size(), T{0},
+                                   [](typename V::reg x, typename V::reg) { return V::sqrt (x); });
+            });
+        }
+
+        // Reductions
+
+        //! Sum of the elements of a
+        template <typename T>
+        T sum (const morph::vVector<T>& a, width w = width::automatic)
+        {
+            return detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                return detail::reduce<V> (a.data(), a.data(), a.size(), T{0},
+                                          [](typename V::reg x, typename V::reg) { return x; },
+                                          [](typename V::reg x, typename V::reg y) { return V::add (x, y); },
+                                          [](T x, T y) { return x + y; });
+            });
+        }
+
+        //! Product of the elements of a
+        template <typename T>
+        T product (const morph::vVector<T>& a, width w = width::automatic)
+        {
+            return detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                return detail::reduce<V> (a.data(), a.data(), a.size(), T{1},
+                                          [](typename V::reg x, typename V::reg) { return x; },
+                                          [](typename V::reg x, typename V::reg y) { return V::mul (x, y); },
+                                          [](T x, T y) { return x * y; });
+            });
+        }
+
+        //! Largest element of a (lowest() for an empty a)
+        template <typename T>
+        T max (const morph::vVector<T>& a, width w = width::automatic)
+        {
+            return detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                return detail::reduce<V> (a.data(), a.data(), a.size(), std::numeric_limits<T>::lowest(),
+                                          [](typename V::reg x, typename V::reg) { return x; },
+                                          [](typename V::reg x, typename V::reg y) { return V::max (x, y); },
+                                          [](T x, T y) { return x > y ? x : y; });
+            });
+        }
+
+        //! Smallest element of a (max() for an empty a)
+        template <typename T>
+        T min (const morph::vVector<T>& a, width w = width::automatic)
+        {
+            return detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                return detail::reduce<V> (a.data(), a.data(), a.size(), std::numeric_limits<T>::max(),
+                                          [](typename V::reg x, typename V::reg) { return x; },
+                                          [](typename V::reg x, typename V::reg y) { return V::min (x, y); },
+                                          [](T x, T y) { return x < y ? x : y; });
+            });
+        }
+
+        //! Scalar product of a and b
+        template <typename T>
+        T dot (const morph::vVector<T>& a, const morph::vVector<T>& b, width w = width::automatic)
+        {
+            detail::check_sizes (a, b);
+            return detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                return detail::reduce<V> (a.data(), b.data(), a.size(), T{0},
+                                          [](typename V::reg x, typename V::reg y) { return V::mul (x, y); },
+                                          [](typename V::reg x, typename V::reg y) { return V::add (x, y); },
+                                          [](T x, T y) { return x + y; });
+            });
+        }
+
+        //! Sum of the squares of the elements of a
+        template <typename T>
+        T sos (const morph::vVector<T>& a, width w = width::automatic)
+        {
+            return detail::with_width<T> (choose (a.size(), w), [&](auto v) {
+                typedef decltype(v) V;
+                return detail::reduce<V> (a.data(), a.data(), a.size(), T{0},
+                                          [](typename V::reg x, typename V::reg) { return V::mul (x, x); },
+                                          [](typename V::reg x, typename V::reg y) { return V::add (x, y); },
+                                          [](T x, T y) { return x + y; });
+            });
+        }
+
+        /*!
+         * Time mult at both widths over cache resident lengths (beyond those both widths wait
+         * on memory) and set min_512_elements() to the shortest length from which the 512-bit
+         * kernel is faster at every longer length tried. If it isn't faster at the longest,
+         * the automatic choice stops using the 512-bit kernels. Returns the threshold.
+         */
+        inline size_t calibrate()
+        {
+            if (!have_512()) { return std::numeric_limits<size_t>::max(); }
+            using namespace std::chrono;
+            size_t threshold = std::numeric_limits<size_t>::max();
+            for (size_t n = size_t{1} << 18; n >= 64; n >>= 2) {
+                morph::vVector<float> a(n), b(n), out(n);
+                a.randomize();
+                b.randomize();
+                steady_clock::duration best[2] = { steady_clock::duration::max(), steady_clock::duration::max() };
+                const size_t reps = (size_t{1} << 24) / n + 1;
+                for (int trial = 0; trial < 3; ++trial) {
+                    for (int k = 0; k < 2; ++k) {
+                        const width w = k == 0 ? width::w256 : width::w512;
+                        steady_clock::time_point start = steady_clock::now();
+                        for (size_t r = 0; r < reps; ++r) {
+                            mult (a, b, out, w);
+                            __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+                        }
+                        steady_clock::duration d = steady_clock::now() - start;
+                        if (d < best[k]) { best[k] = d; }
+                    }
+                }
+                if (best[1] < best[0]) { threshold = n; } else { break; }
+            }
+            set_min_512_elements (threshold);
+            return threshold;
+        }
+
+    } // namespace avx512
+} // namespace cc
@@ -0,0 +1,142 @@
+/*
+ * Batched elementwise ops over many small, independent vectors. Parallelising a single
+ * 4 element op costs far more than the op (see exercise_smallvecs.cpp), so here the
+ * parallelism is across the batch, with SIMD inside each chunk of the batch.
+ *
+ * A batch of morph::Vector<T, N> is one contiguous array of T, so it is processed as a
+ * flat array and SIMD runs across vector boundaries. A batch of vVectors has a separate
+ * allocation per vector; each chunk of the batch is handed to a thread, which runs a
+ * SIMD loop over each vector in turn.
+ *
+ *   std::vector<morph::Vector<float, 4>> a(100000), b(100000), out(100000);
+ *   cc::thread_pool pool;
+ *   cc::batch::mult (pool, a, b, out);
+ *   cc::batch::apply (pool, a, b, out, [](float x, float y) { return x * y + 1.0f; });
+ *
+ * Executors are those of parallel_backend.h.
+ */
+#pragma once
+
+#include <morph/Vector.h>
+#include <morph/vVector.h>
+#include <vector>
+#include <stdexcept>
+#include "parallel_backend.h"
+
+namespace cc {
+    namespace batch {
+
+        //! Elements per chunk for flat (morph::Vector) batches
+        constexpr size_t flat_grain = 16384;
+        //! vVectors per chunk for vVector batches
+        constexpr size_t vvec_grain = 1024;
+
+        template <typename A, typename B>
+        void check_sizes (const std::vector<A>& a, const std::vector<B>& b)
+        {
+            if (a.size() != b.size()) { throw std::runtime_error ("batch: batches must be the same size"); }
+        }
+
+        //! Check every pair of vVectors up front, as a throw from inside an executor's task can't be caught here
+        template <typename T>
+        void check_sizes (const std::vector<morph::vVector<T>>& a, const std::vector<morph::vVector<T>>& b)
+        {
+            if (a.size() != b.size()) { throw std::runtime_error ("batch: batches must be the same size"); }
+            for (size_t j = 0; j < a.size(); ++j) {
+                if (a[j].size() != b[j].size()) { throw std::runtime_error ("batch: vVectors must be the same size"); }
+            }
+        }
+
+        //! out[j][i] = op(a[j][i], b[j][i]) for every morph::Vector j in the batch
+        template <typename Exec, typename T, size_t N, typename Op>
+        void apply (Exec& exec, const std::vector<morph::Vector<T, N>>& a, const std::vector<morph::Vector<T, N>>& b,
+                    std::vector<morph::Vector<T, N>>& out, Op op)
+        {
+            static_assert (sizeof(morph::Vector<T, N>) == N * sizeof(T), "batch: morph::Vector must be packed to be treated as a flat array");
+            check_sizes (a, out);
+            check_sizes (b, out);
+            const T* ap = a.empty() ? nullptr : a[0].data();
+            const T* bp = b.empty() ? nullptr : b[0].data();
+            T* op_ = out.empty() ? nullptr : out[0].data();
+            exec.parallel_for (a.size() * N, flat_grain, [=](size_t lo, size_t hi) {
+#pragma omp simd
+                for (size_t i = lo; i < hi; ++i) { op_[i] = op (ap[i], bp[i]); }
+            });
+        }
+
+        //! out[j][i] = op(a[j][i]) for every morph::Vector j in the batch
+        template <typename Exec, typename T, size_t N, typename Op>
+        void apply (Exec& exec, const std::vector<morph::Vector<T, N>>& a, std::vector<morph::Vector<T, N>>& out, Op op)
+        {
+            static_assert (sizeof(morph::Vector<T, N>) == N * sizeof(T), "batch: morph::Vector must be packed to be treated as a flat array");
+            check_sizes (a, out);
+            const T* ap = a.empty() ? nullptr : a[0].data();
+            T* op_ = out.empty() ? nullptr : out[0].data();
+            exec.parallel_for (a.size() * N, flat_grain, [=](size_t lo, size_t hi) {
+#pragma omp simd
+                for (size_t i = lo; i < hi; ++i) { op_[i] = op (ap[i]); }
+            });
+        }
+
+        //! out[j][i] = op(a[j][i], b[j][i]) for every vVector j in the batch
+        template <typename Exec, typename T, typename Op>
+        void apply (Exec& exec, const std::vector<morph::vVector<T>>& a, const std::vector<morph::vVector<T>>& b,
+                    std::vector<morph::vVector<T>>& out, Op op)
+        {
+            check_sizes (a, out);
+            check_sizes (b, out);
+            exec.parallel_for (a.size(), vvec_grain, [&](size_t lo, size_t hi) {
+                for (size_t j = lo; j < hi; ++j) {
+                    const T* ap = a[j].data();
+                    const T* bp = b[j].data();
+                    T* op_ = out[j].data();
+                    const size_t n = out[j].size();
+#pragma omp simd
+                    for (size_t i = 0; i < n; ++i) { op_[i] = op (ap[i], bp[i]); }
+                }
+            });
+        }
+
+        //! out[j][i] = op(a[j][i]) for every vVector j in the batch
+        template <typename Exec, typename T, typename Op>
+        void apply (Exec& exec, const std::vector<morph::vVector<T>>& a, std::vector<morph::vVector<T>>& out, Op op)
+        {
+            check_sizes (a, out);
+            exec.parallel_for (a.size(), vvec_grain, [&](size_t lo, size_t hi) {
+                for (size_t j = lo; j < hi; ++j) {
+                    const T* ap = a[j].data();
+                    T* op_ = out[j].data();
+                    const size_t n = out[j].size();
+#pragma omp simd
+                    for (size_t i = 0; i < n; ++i) { op_[i] = op (ap[i]); }
+                }
+            });
+        }
+
+        // Named ops. Batch is std::vector<morph::Vector<T, N>> or std::vector<morph::vVector<T>>.
+
+        //! out = a * s, for each vector in the batch
+        template <typename Exec, typename Batch, typename T>
+        void scale (Exec& exec, const Batch& a, const T s, Batch& out)
+        {
+            apply (exec, a, out, [s](T x) { return x * s; });
+        }
+
+        //! out = a * b (elementwise), for each pair of vectors in the batch
+        template <typename Exec, typename Batch>
+        void mult (Exec& exec, const Batch& a, const Batch& b, Batch& out)
+        {
+            typedef typename Batch::value_type::value_type T;
+            apply (exec, a, b, out, [](T x, T y) { return x * y; });
+        }
+
+        //! out = a / b (elementwise), for each pair of vectors in the batch
+        template <typename Exec, typename Batch>
+        void div (Exec& exec, const Batch& a, const Batch& b, Batch& out)
+        {
+            typedef typename Batch::value_type::value_type T;
+            apply (exec, a, b, out, [](T x, T y) { return x / y; });
+        }
+
+    } // namespace batch
+} // namespace cc
@@ -0,0 +1,141 @@
+/*
+ * Keeping benchmarks honest: barriers that stop the compiler eliding timed work whose
+ * result is never read, or is overwritten by the next rep, and a check of every result
+ * against a reference, so that each reported time comes with evidence that the work was
+ * done and done right.
+ *
+ *   for (int r = 0; r < reps; ++r) {
+ *       out = a * b;
+ *       cc::bench::do_not_optimize (out.data());  // as if out's memory were read here
+ *       cc::bench::clobber_memory();
+ *   }
+ *   cc::bench::result res = cc::bench::check (out.data(), out.size(), [&](size_t i) { return double(a[i]) * b[i]; }, 0);
+ *   std::cout << "Vector mult took " << ms << " ms with vVector (" << res << ")" << std::endl;
+ *   return cc::bench::failures > 0 ? 1 : 0;
+ *
+ *   // Or, for a loop that just needs timing and reporting:
+ *   cc::bench::time_op (reps, "Vector mult", "cc::ints", c.data(), [&]() { cc::ints::mult (a, b, c); });
+ *
+ * check computes the reference in double, rounds it to the result type and measures the
+ * distance in ulps (units in the last place), against a tolerance that says how exact the
+ * op should be: 0 for the correctly rounded + - * / and sqrt, a few for pow, exp and the
+ * like. It also checksums the result's bytes, so that two implementations giving identical
+ * results can be seen to, and a result can be compared between builds and hosts.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <ostream>
+#include <iomanip>
+#include <iostream>
+#include <chrono>
+#include <type_traits>
+
+namespace cc {
+    namespace bench {
+
+        //! Make the compiler assume that value (and memory it points to) is read here
+        template <typename T>
+        inline void do_not_optimize (const T& value) { __asm__ __volatile__ ("" : : "r,m"(value) : "memory"); }
+
+        //! Make the compiler assume that all memory is read and written here
+        inline void clobber_memory() { __asm__ __volatile__ ("" : : : "memory"); }
+
+        /*!
+         * Run fn reps times, with a barrier on out after each so that no rep is dropped for
+         * having its result overwritten by the next, and print "op took N ms with what".
+         * Returns the time taken.
+         */
+        template <typename Fn>
+        std::chrono::steady_clock::duration time_op (int reps, const std::string& op, const std::string& what, const void* out, Fn fn)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int r = 0; r < reps; ++r) {
+                fn();
+                do_not_optimize (out);
+            }
+            const std::chrono::steady_clock::duration d = std::chrono::steady_clock::now() - start;
+            std::cout << op << " took " << std::chrono::duration_cast<std::chrono::milliseconds>(d).count() << " ms with " << what << std::endl;
+            return d;
+        }
+
+        //! FNV-1a hash of the bytes of p[0, n)
+        template <typename T>
+        uint64_t checksum (const T* p, size_t n)
+        {
+            const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+            uint64_t h = 14695981039346656037ull;
+            for (size_t k = 0; k < n * sizeof(T); ++k) { h = (h ^ b[k]) * 1099511628211ull; }
+            return h;
+        }
+
+        /*!
+         * The number of representable Ts between a and b: 0 if they're equal (so +0 and -0
+         * are 0 apart) or both NaN, the maximum if only one is NaN.
+         */
+        template <typename T>
+        uint64_t ulps (T a, T b)
+        {
+            static_assert (std::is_floating_point<T>::value && (sizeof(T) == 4 || sizeof(T) == 8), "ulps: float or double");
+            typedef typename std::conditional<sizeof(T) == 4, int32_t, int64_t>::type I;
+            if (std::isnan (a) || std::isnan (b)) { return std::isnan (a) && std::isnan (b) ? 0 : std::numeric_limits<uint64_t>::max(); }
+            if (a == b) { return 0; }
+            I ia, ib;
+            std::memcpy (&ia, &a, sizeof(T));
+            std::memcpy (&ib, &b, sizeof(T));
+            // Map sign-magnitude onto a number line, where adjacent floats are adjacent integers
+            const int64_t la = ia < 0 ? static_cast<int64_t>(std::numeric_limits<I>::min()) - ia : ia;
+            const int64_t lb = ib < 0 ? static_cast<int64_t>(std::numeric_limits<I>::min()) - ib : ib;
+            return la > lb ? static_cast<uint64_t>(la) - static_cast<uint64_t>(lb) : static_cast<uint64_t>(lb) - static_cast<uint64_t>(la);
+        }
+
+        //! How many results checked so far were out of tolerance. A benchmark's exit status.
+        inline int failures = 0;
+
+        //! The outcome of checking a result against its reference
+        struct result
+        {
+            uint64_t checksum = 0;
+            uint64_t max_ulps = 0;
+            size_t worst = 0;
+            uint64_t tolerance = 0;
+            bool ok = true;
+        };
+
+        inline std::ostream& operator<< (std::ostream& os, const result& r)
+        {
+            os << "checksum " << std::hex << std::setw (16) << std::setfill ('0') << r.checksum << std::dec << std::setfill (' ');
+            if (r.ok) {
+                return os << ", within " << r.max_ulps << " ulp of the reference";
+            }
+            return os << ", WRONG: " << r.max_ulps << " ulp from the reference at element " << r.worst << " (tolerance " << r.tolerance << ")";
+        }
+
+        /*!
+         * Checksum got[0, n) and compare each element with ref(i), a double, rounded to T.
+         * Counts a failure if any is more than tolerance ulps away.
+         */
+        template <typename T, typename Ref>
+        result check (const T* got, size_t n, Ref ref, uint64_t tolerance)
+        {
+            result r;
+            r.checksum = checksum (got, n);
+            r.tolerance = tolerance;
+            for (size_t i = 0; i < n; ++i) {
+                const uint64_t u = ulps (got[i], static_cast<T>(ref (i)));
+                if (u > r.max_ulps) {
+                    r.max_ulps = u;
+                    r.worst = i;
+                }
+            }
+            r.ok = r.max_ulps <= tolerance;
+            if (!r.ok) { ++failures; }
+            return r;
+        }
+
+    } // namespace bench
+} // namespace cc
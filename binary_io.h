@@ -0,0 +1,295 @@
+/*
+ * Compact binary save/load for vVector (and for FloatVec::Array, if chryswoods/floatvec.h
+ * is included before this file).
+ *
+ * The file is a 64 byte header followed by the element data, so the data starts on a 64
+ * byte boundary in the file. Uncompressed data is written straight from the vector's
+ * storage and read straight back into it with no intermediate copy. Optionally, the data
+ * can be byte-shuffled (as in blosc) and deflated with zlib at its fastest level; this is
+ * only available if CC_HAVE_ZLIB is defined.
+ *
+ * Errors (missing file, wrong type, truncated or corrupt file, bad checksum) are reported by throwing
+ * std::runtime_error.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef CC_HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+namespace cc {
+
+    //! The element type codes stored in a binary_header
+    enum class binary_type : uint8_t { unknown, i8, u8, i16, u16, i32, u32, i64, u64, f32, f64 };
+
+    template <typename T> constexpr binary_type binary_type_of()
+    {
+        if constexpr (std::is_same_v<T, float>) { return binary_type::f32; }
+        else if constexpr (std::is_same_v<T, double>) { return binary_type::f64; }
+        else if constexpr (std::is_same_v<T, int8_t>) { return binary_type::i8; }
+        else if constexpr (std::is_same_v<T, uint8_t>) { return binary_type::u8; }
+        else if constexpr (std::is_same_v<T, int16_t>) { return binary_type::i16; }
+        else if constexpr (std::is_same_v<T, uint16_t>) { return binary_type::u16; }
+        else if constexpr (std::is_same_v<T, int32_t>) { return binary_type::i32; }
+        else if constexpr (std::is_same_v<T, uint32_t>) { return binary_type::u32; }
+        else if constexpr (std::is_same_v<T, int64_t>) { return binary_type::i64; }
+        else if constexpr (std::is_same_v<T, uint64_t>) { return binary_type::u64; }
+        else { return binary_type::unknown; }
+    }
+
+    //! Header flags
+    static constexpr uint32_t binary_flag_compressed = 0x1;
+
+    //! The on-disk header. Exactly 64 bytes, so the payload is 64 byte aligned in the file.
+    struct binary_header
+    {
+        char magic[4] = {'C', 'C', 'B', 'V'};
+        uint16_t version = 1;
+        binary_type type = binary_type::unknown;
+        uint8_t elem_size = 0;
+        //! Number of elements
+        uint64_t count = 0;
+        //! Alignment (in bytes, up to 64) of the storage the data was written from
+        uint32_t alignment = 0;
+        uint32_t flags = 0;
+        //! Bytes of payload following the header (less than count * elem_size if compressed)
+        uint64_t payload_bytes = 0;
+        //! Checksum of the uncompressed element data
+        uint64_t checksum = 0;
+        uint8_t reserved[24] = {};
+    };
+    static_assert (sizeof(binary_header) == 64, "binary_header must be 64 bytes");
+
+    /*!
+     * Fletcher-style 64 bit checksum over 32 bit words, with four independent lanes so that
+     * it isn't limited by the latency of a single dependency chain. Trailing bytes that
+     * don't make up a whole word are folded in at the end.
+     */
+    inline uint64_t binary_checksum (const void* data, size_t bytes)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        uint64_t a[4] = {1, 2, 3, 4};
+        uint64_t b[4] = {0, 0, 0, 0};
+        size_t nwords = bytes / 4;
+        size_t i = 0;
+        for (; i + 4 <= nwords; i += 4) {
+            for (int l = 0; l < 4; ++l) {
+                uint32_t w;
+                std::memcpy (&w, p + 4 * (i + l), 4);
+                a[l] += w;
+                b[l] += a[l];
+            }
+        }
+        for (; i < nwords; ++i) {
+            uint32_t w;
+            std::memcpy (&w, p + 4 * i, 4);
+            a[0] += w;
+            b[0] += a[0];
+        }
+        for (size_t j = 4 * nwords; j < bytes; ++j) {
+            a[1] += p[j];
+            b[1] += a[1];
+        }
+        uint64_t sum = 0;
+        for (int l = 0; l < 4; ++l) { sum ^= (b[l] << (l * 16)) ^ (a[l] * 0x9e3779b97f4a7c15ULL); }
+        return sum;
+    }
+
+    namespace detail {
+
+        inline size_t alignment_of (const void* p)
+        {
+            uintptr_t u = reinterpret_cast<uintptr_t>(p);
+            size_t al = 1;
+            while (al < 64 && (u & al) == 0) { al <<= 1; }
+            return al;
+        }
+
+        inline void write_all (int fd, const void* data, size_t bytes)
+        {
+            const char* p = static_cast<const char*>(data);
+            while (bytes > 0) {
+                ssize_t n = ::write (fd, p, bytes);
+                if (n < 0 && errno == EINTR) { continue; }
+                if (n <= 0) { throw std::runtime_error (std::string("binary_io: write failed: ") + std::strerror (errno)); }
+                p += n;
+                bytes -= static_cast<size_t>(n);
+            }
+        }
+
+        inline void read_all (int fd, void* data, size_t bytes)
+        {
+            char* p = static_cast<char*>(data);
+            while (bytes > 0) {
+                ssize_t n = ::read (fd, p, bytes);
+                if (n < 0 && errno == EINTR) { continue; }
+                if (n == 0) { throw std::runtime_error ("binary_io: file is truncated"); }
+                if (n < 0) { throw std::runtime_error (std::string("binary_io: read failed: ") + std::strerror (errno)); }
+                p += n;
+                bytes -= static_cast<size_t>(n);
+            }
+        }
+
+        //! Closes the file descriptor when it goes out of scope (including on throw)
+        struct fd_closer
+        {
+            int fd;
+            ~fd_closer() { if (fd >= 0) { ::close (fd); } }
+        };
+
+        //! Gather byte k of every element together, which makes float data much more compressible
+        inline void shuffle (const uint8_t* in, uint8_t* out, size_t count, size_t elem_size)
+        {
+            for (size_t k = 0; k < elem_size; ++k) {
+                uint8_t* o = out + k * count;
+                for (size_t i = 0; i < count; ++i) { o[i] = in[i * elem_size + k]; }
+            }
+        }
+
+        inline void unshuffle (const uint8_t* in, uint8_t* out, size_t count, size_t elem_size)
+        {
+            for (size_t k = 0; k < elem_size; ++k) {
+                const uint8_t* ip = in + k * count;
+                for (size_t i = 0; i < count; ++i) { out[i * elem_size + k] = ip[i]; }
+            }
+        }
+
+        //! Save count elements of type code t, each elem_size bytes, from data
+        inline void save (const std::string& path, const void* data, size_t count,
+                          binary_type t, size_t elem_size, bool compress)
+        {
+            binary_header h;
+            h.type = t;
+            h.elem_size = static_cast<uint8_t>(elem_size);
+            h.count = count;
+            h.alignment = static_cast<uint32_t>(alignment_of (data));
+            size_t bytes = count * elem_size;
+            h.checksum = binary_checksum (data, bytes);
+
+            std::vector<uint8_t> packed;
+            const void* payload = data;
+            h.payload_bytes = bytes;
+            if (compress) {
+#ifdef CC_HAVE_ZLIB
+                std::vector<uint8_t> shuffled (bytes);
+                shuffle (static_cast<const uint8_t*>(data), shuffled.data(), count, elem_size);
+                uLongf packed_len = compressBound (bytes);
+                packed.resize (packed_len);
+                if (compress2 (packed.data(), &packed_len, shuffled.data(), bytes, Z_BEST_SPEED) != Z_OK) {
+                    throw std::runtime_error ("binary_io: compression failed");
+                }
+                h.flags |= binary_flag_compressed;
+                h.payload_bytes = packed_len;
+                payload = packed.data();
+#else
+                throw std::runtime_error ("binary_io: compression requested, but built without zlib");
+#endif
+            }
+
+            int fd = ::open (path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) { throw std::runtime_error ("binary_io: can't open " + path + " for writing: " + std::strerror (errno)); }
+            fd_closer closer{fd};
+            write_all (fd, &h, sizeof(h));
+            write_all (fd, payload, h.payload_bytes);
+        }
+
+        //! Open path (handing the descriptor to closer), check its header against t/elem_size and return it
+        inline binary_header open_and_check (const std::string& path, fd_closer& closer, binary_type t, size_t elem_size)
+        {
+            int fd = ::open (path.c_str(), O_RDONLY);
+            closer.fd = fd;
+            if (fd < 0) { throw std::runtime_error ("binary_io: can't open " + path + ": " + std::strerror (errno)); }
+            binary_header h;
+            read_all (fd, &h, sizeof(h));
+            if (std::memcmp (h.magic, "CCBV", 4) != 0) { throw std::runtime_error ("binary_io: " + path + " is not a binary vector file"); }
+            if (h.version != 1) { throw std::runtime_error ("binary_io: unsupported file version"); }
+            if (h.type != t || h.elem_size != elem_size) { throw std::runtime_error ("binary_io: element type in file doesn't match"); }
+            // Check the sizes in the header against the file before anything is allocated from them
+            struct stat st;
+            if (::fstat (fd, &st) != 0) { throw std::runtime_error ("binary_io: can't stat " + path + ": " + std::strerror (errno)); }
+            const uint64_t on_disk = static_cast<uint64_t>(st.st_size) - sizeof(h);
+            if (h.payload_bytes != on_disk) { throw std::runtime_error ("binary_io: " + path + " is truncated or corrupt"); }
+            if (h.count > std::numeric_limits<uint64_t>::max() / elem_size) { throw std::runtime_error ("binary_io: " + path + " is corrupt"); }
+            const uint64_t bytes = h.count * elem_size;
+            // deflate can't do better than about 1032:1, so a larger count is a corrupt header
+            const bool fits = (h.flags & binary_flag_compressed) ? bytes / 1032 <= h.payload_bytes : bytes == h.payload_bytes;
+            if (!fits) { throw std::runtime_error ("binary_io: element count in " + path + " doesn't match its size"); }
+            return h;
+        }
+
+        //! Read the payload described by h from fd into data (which has room for h.count elements)
+        inline void load_payload (int fd, const binary_header& h, void* data)
+        {
+            size_t bytes = h.count * h.elem_size;
+            if (h.flags & binary_flag_compressed) {
+#ifdef CC_HAVE_ZLIB
+                std::vector<uint8_t> packed (h.payload_bytes);
+                read_all (fd, packed.data(), packed.size());
+                std::vector<uint8_t> shuffled (bytes);
+                uLongf out_len = bytes;
+                if (uncompress (shuffled.data(), &out_len, packed.data(), packed.size()) != Z_OK || out_len != bytes) {
+                    throw std::runtime_error ("binary_io: decompression failed");
+                }
+                unshuffle (shuffled.data(), static_cast<uint8_t*>(data), h.count, h.elem_size);
+#else
+                throw std::runtime_error ("binary_io: file is compressed, but built without zlib");
+#endif
+            } else {
+                read_all (fd, data, bytes);
+            }
+            if (binary_checksum (data, bytes) != h.checksum) { throw std::runtime_error ("binary_io: checksum mismatch"); }
+        }
+
+    } // namespace detail
+
+    //! Save the vVector v to path. If compress is true, byte-shuffle and deflate the data.
+    template <typename T, typename Al>
+    void save_binary (const std::string& path, const morph::vVector<T, Al>& v, bool compress = false)
+    {
+        static_assert (binary_type_of<T>() != binary_type::unknown, "save_binary: unsupported element type");
+        detail::save (path, v.data(), v.size(), binary_type_of<T>(), sizeof(T), compress);
+    }
+
+    //! Load path into v, which is resized to fit. The data is read directly into v's storage.
+    template <typename T, typename Al>
+    void load_binary (const std::string& path, morph::vVector<T, Al>& v)
+    {
+        static_assert (binary_type_of<T>() != binary_type::unknown, "load_binary: unsupported element type");
+        detail::fd_closer closer{-1};
+        binary_header h = detail::open_and_check (path, closer, binary_type_of<T>(), sizeof(T));
+        v.resize (h.count);
+        detail::load_payload (closer.fd, h, v.data());
+    }
+
+#ifdef FLOATVEC_H
+    //! Save a FloatVec::Array as a flat array of floats (so it can be loaded into a vVector<float>)
+    inline void save_binary (const std::string& path, const FloatVec::Array& v, bool compress = false)
+    {
+        detail::save (path, v.data(), v.size() * FloatVec::size(), binary_type::f32, sizeof(float), compress);
+    }
+
+    //! Load a file of floats into a FloatVec::Array. The element count must be a whole number of FloatVecs.
+    inline void load_binary (const std::string& path, FloatVec::Array& v)
+    {
+        detail::fd_closer closer{-1};
+        binary_header h = detail::open_and_check (path, closer, binary_type::f32, sizeof(float));
+        if (h.count % FloatVec::size() != 0) {
+            throw std::runtime_error ("binary_io: element count is not a multiple of FloatVec::size()");
+        }
+        v.resize (h.count / FloatVec::size());
+        detail::load_payload (closer.fd, h, v.data());
+    }
+#endif
+
+} // namespace cc
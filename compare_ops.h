@@ -0,0 +1,408 @@
+/*
+ * SIMD comparisons of vVectors against a scalar or another vVector, producing packed
+ * bitmasks (one bit per element, 64 to a word) rather than a vVector of 0s and 1s, and
+ * queries (any, all, count, first) that stop at the first 64 element block that settles
+ * the answer. vVector's own operator< and operator> answer "are ALL less/greater?" with
+ * a scalar loop; cc::cmp::all (a, cc::cmp::lt, 3.5) is the SIMD equivalent.
+ *
+ *   cc::bitmask m;
+ *   cc::cmp::compare (a, cc::cmp::gt, 0.5f, m);  // bit i set if a[i] > 0.5
+ *   size_t above = m.count();
+ *   cc::cmp::where (m, a, 0.0f, out);            // out[i] = m[i] ? a[i] : 0
+ *   cc::cmp::where (a, cc::cmp::gt, 0.5f, 0.0f, out); // the same in one pass, no bitmask
+ *   size_t i0 = cc::cmp::first (a, cc::cmp::ge, b); // a.size() if there's none
+ *
+ * Comparisons are the ordered, quiet predicates, so a NaN compares false, except ne,
+ * which is true for a NaN (as with the scalar operators). Build with -mpopcnt (or an
+ * -march that has it) or count() and the bitmask queries call out to libgcc for popcount.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#if !defined(__AVX2__)
+# error "compare_ops.h needs at least -mavx2"
+#endif
+
+namespace cc {
+
+    //! One bit per element, packed 64 to a word. Bits beyond size() are kept zero.
+    struct bitmask
+    {
+        std::vector<uint64_t> words;
+        size_t n = 0;
+
+        //! Size for n_ bits. The contents are left to be overwritten.
+        void resize (size_t n_)
+        {
+            this->n = n_;
+            this->words.resize ((n_ + 63) / 64);
+        }
+        size_t size() const { return this->n; }
+        bool test (size_t i) const { return (this->words[i / 64] >> (i % 64)) & 1u; }
+
+        size_t count() const
+        {
+            size_t c = 0;
+            for (auto w : this->words) { c += __builtin_popcountll (w); }
+            return c;
+        }
+        bool any() const
+        {
+            for (auto w : this->words) { if (w) { return true; } }
+            return false;
+        }
+        bool all() const { return this->count() == this->n; }
+        //! Index of the first set bit, or size() if none is set
+        size_t first() const
+        {
+            for (size_t k = 0; k < this->words.size(); ++k) {
+                if (this->words[k]) { return k * 64 + __builtin_ctzll (this->words[k]); }
+            }
+            return this->n;
+        }
+
+        void operator&= (const bitmask& o)
+        {
+            if (o.n != this->n) { throw std::runtime_error ("bitmask: sizes differ"); }
+            for (size_t k = 0; k < this->words.size(); ++k) { this->words[k] &= o.words[k]; }
+        }
+        void operator|= (const bitmask& o)
+        {
+            if (o.n != this->n) { throw std::runtime_error ("bitmask: sizes differ"); }
+            for (size_t k = 0; k < this->words.size(); ++k) { this->words[k] |= o.words[k]; }
+        }
+        //! Invert every bit, leaving those beyond size() zero
+        void flip()
+        {
+            for (auto& w : this->words) { w = ~w; }
+            if (this->n % 64) { this->words.back() &= (uint64_t{1} << (this->n % 64)) - 1; }
+        }
+    };
+
+    namespace cmp {
+
+        //! The comparison predicates
+        enum pred { lt, le, gt, ge, eq, ne };
+
+        namespace detail {
+
+            // Compare a register of a with a register of b, giving one bit per lane, and
+            // blend two registers by a word of bits. At the widest width compiled for.
+            template <typename T> struct simd;
+#if defined(__AVX512F__)
+            template <>
+            struct simd<float>
+            {
+                typedef __m512 reg;
+                static constexpr size_t n = 16;
+                static reg load (const float* p) { return _mm512_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm512_storeu_ps (p, v); }
+                static reg set1 (float f) { return _mm512_set1_ps (f); }
+                template <int P> static uint64_t cmp (reg a, reg b) { return _mm512_cmp_ps_mask (a, b, P); }
+                //! Lanes of a where bits is set, else lanes of b
+                static reg blend (uint64_t bits, reg a, reg b) { return _mm512_mask_blend_ps (static_cast<__mmask16>(bits), b, a); }
+                //! Lanes of x where a P b, else lanes of y
+                template <int P> static reg select (reg a, reg b, reg x, reg y) { return _mm512_mask_blend_ps (_mm512_cmp_ps_mask (a, b, P), y, x); }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m512d reg;
+                static constexpr size_t n = 8;
+                static reg load (const double* p) { return _mm512_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm512_storeu_pd (p, v); }
+                static reg set1 (double f) { return _mm512_set1_pd (f); }
+                template <int P> static uint64_t cmp (reg a, reg b) { return _mm512_cmp_pd_mask (a, b, P); }
+                static reg blend (uint64_t bits, reg a, reg b) { return _mm512_mask_blend_pd (static_cast<__mmask8>(bits), b, a); }
+                template <int P> static reg select (reg a, reg b, reg x, reg y) { return _mm512_mask_blend_pd (_mm512_cmp_pd_mask (a, b, P), y, x); }
+            };
+#else
+            template <>
+            struct simd<float>
+            {
+                typedef __m256 reg;
+                static constexpr size_t n = 8;
+                static reg load (const float* p) { return _mm256_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm256_storeu_ps (p, v); }
+                static reg set1 (float f) { return _mm256_set1_ps (f); }
+                template <int P> static uint64_t cmp (reg a, reg b) { return static_cast<uint32_t>(_mm256_movemask_ps (_mm256_cmp_ps (a, b, P))); }
+                static reg blend (uint64_t bits, reg a, reg b)
+                {
+                    // Spread the 8 bits over the 8 lanes as all-ones or all-zeros
+                    const __m256i sel = _mm256_setr_epi32 (1, 2, 4, 8, 16, 32, 64, 128);
+                    __m256 m = _mm256_castsi256_ps (_mm256_cmpeq_epi32 (_mm256_and_si256 (_mm256_set1_epi32 (static_cast<int>(bits & 0xff)), sel), sel));
+                    return _mm256_blendv_ps (b, a, m);
+                }
+                template <int P> static reg select (reg a, reg b, reg x, reg y) { return _mm256_blendv_ps (y, x, _mm256_cmp_ps (a, b, P)); }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m256d reg;
+                static constexpr size_t n = 4;
+                static reg load (const double* p) { return _mm256_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm256_storeu_pd (p, v); }
+                static reg set1 (double f) { return _mm256_set1_pd (f); }
+                template <int P> static uint64_t cmp (reg a, reg b) { return static_cast<uint32_t>(_mm256_movemask_pd (_mm256_cmp_pd (a, b, P))); }
+                static reg blend (uint64_t bits, reg a, reg b)
+                {
+                    const __m256i sel = _mm256_setr_epi64x (1, 2, 4, 8);
+                    __m256d m = _mm256_castsi256_pd (_mm256_cmpeq_epi64 (_mm256_and_si256 (_mm256_set1_epi64x (static_cast<long long>(bits & 0xf)), sel), sel));
+                    return _mm256_blendv_pd (b, a, m);
+                }
+                template <int P> static reg select (reg a, reg b, reg x, reg y) { return _mm256_blendv_pd (y, x, _mm256_cmp_pd (a, b, P)); }
+            };
+#endif
+
+            //! The scalar equivalent of the _CMP_ predicate P
+            template <int P, typename T>
+            inline bool scalar_cmp (T a, T b)
+            {
+                if constexpr (P == _CMP_LT_OQ) { return a < b; }
+                else if constexpr (P == _CMP_LE_OQ) { return a <= b; }
+                else if constexpr (P == _CMP_GT_OQ) { return a > b; }
+                else if constexpr (P == _CMP_GE_OQ) { return a >= b; }
+                else if constexpr (P == _CMP_EQ_OQ) { return a == b; }
+                else { return a != b; }
+            }
+
+            //! Call fn with the predicate p as an integral_constant holding its _CMP_ value
+            template <typename Fn>
+            auto with_pred (pred p, Fn fn)
+            {
+                switch (p) {
+                case lt: return fn (std::integral_constant<int, _CMP_LT_OQ>{});
+                case le: return fn (std::integral_constant<int, _CMP_LE_OQ>{});
+                case gt: return fn (std::integral_constant<int, _CMP_GT_OQ>{});
+                case ge: return fn (std::integral_constant<int, _CMP_GE_OQ>{});
+                case eq: return fn (std::integral_constant<int, _CMP_EQ_OQ>{});
+                case ne: return fn (std::integral_constant<int, _CMP_NEQ_UQ>{});
+                default: throw std::runtime_error ("cmp: unknown predicate");
+                }
+            }
+
+            // The right hand side of a comparison: another vVector or a broadcast scalar
+            template <typename T>
+            struct vector_rhs
+            {
+                const T* p;
+                typename simd<T>::reg reg (size_t i) const { return simd<T>::load (this->p + i); }
+                T at (size_t i) const { return this->p[i]; }
+            };
+            template <typename T>
+            struct scalar_rhs
+            {
+                typename simd<T>::reg v;
+                T s;
+                typename simd<T>::reg reg (size_t) const { return this->v; }
+                T at (size_t) const { return this->s; }
+            };
+
+            //! The 64 comparison bits for elements [i, i+64), with zeros beyond n
+            template <int P, typename T, typename R>
+            inline uint64_t word (const T* a, const R& r, size_t i, size_t n)
+            {
+                typedef simd<T> S;
+                uint64_t w = 0;
+                if (i + 64 <= n) {
+                    for (size_t j = 0; j < 64; j += S::n) { w |= S::template cmp<P> (S::load (a + i + j), r.reg (i + j)) << j; }
+                } else {
+                    for (size_t j = 0; i + j < n; ++j) { w |= static_cast<uint64_t>(scalar_cmp<P> (a[i + j], r.at (i + j))) << j; }
+                }
+                return w;
+            }
+
+            //! Fill m with the comparison of a against r
+            template <typename T, typename R>
+            void compare (const morph::vVector<T>& a, pred p, const R& r, bitmask& m)
+            {
+                const size_t n = a.size();
+                m.resize (n);
+                uint64_t* wp = m.words.data();
+                const T* ap = a.data();
+                with_pred (p, [&](auto P) {
+                    const long long nw = static_cast<long long>(m.words.size());
+#pragma omp parallel for
+                    for (long long k = 0; k < nw; ++k) { wp[k] = word<decltype(P)::value> (ap, r, k * 64, n); }
+                });
+            }
+
+            //! Call fn(i, word) for each 64 element block of the comparison in order, until fn returns false
+            template <typename T, typename R, typename Fn>
+            void scan (const morph::vVector<T>& a, pred p, const R& r, Fn fn)
+            {
+                const size_t n = a.size();
+                const T* ap = a.data();
+                with_pred (p, [&](auto P) {
+                    for (size_t i = 0; i < n; i += 64) {
+                        if (!fn (i, word<decltype(P)::value> (ap, r, i, n))) { break; }
+                    }
+                });
+            }
+
+            //! The mask of valid bits in the block starting at i
+            inline uint64_t valid (size_t i, size_t n) { return n - i >= 64 ? ~uint64_t{0} : (uint64_t{1} << (n - i)) - 1; }
+
+            template <typename T, typename R>
+            bool any (const morph::vVector<T>& a, pred p, const R& r)
+            {
+                bool found = false;
+                scan (a, p, r, [&](size_t, uint64_t w) { found = w != 0; return !found; });
+                return found;
+            }
+            template <typename T, typename R>
+            bool all (const morph::vVector<T>& a, pred p, const R& r)
+            {
+                bool ok = true;
+                const size_t n = a.size();
+                scan (a, p, r, [&](size_t i, uint64_t w) { ok = w == valid (i, n); return ok; });
+                return ok;
+            }
+            template <typename T, typename R>
+            size_t count (const morph::vVector<T>& a, pred p, const R& r)
+            {
+                // No early exit, so count a register at a time, in parallel
+                typedef simd<T> S;
+                const size_t n = a.size();
+                const T* ap = a.data();
+                return with_pred (p, [&](auto P) {
+                    constexpr int Pv = decltype(P)::value;
+                    const long long nb = static_cast<long long>(n / S::n);
+                    size_t c = 0;
+#pragma omp parallel for reduction(+:c)
+                    for (long long k = 0; k < nb; ++k) { c += __builtin_popcount (static_cast<unsigned>(S::template cmp<Pv> (S::load (ap + k * S::n), r.reg (k * S::n)))); }
+                    for (size_t i = nb * S::n; i < n; ++i) { c += scalar_cmp<Pv> (ap[i], r.at (i)) ? 1 : 0; }
+                    return c;
+                });
+            }
+            template <typename T, typename R>
+            size_t first (const morph::vVector<T>& a, pred p, const R& r)
+            {
+                size_t f = a.size();
+                scan (a, p, r, [&](size_t i, uint64_t w) {
+                    if (w) { f = i + __builtin_ctzll (w); return false; }
+                    return true;
+                });
+                return f;
+            }
+
+            template <typename T>
+            scalar_rhs<T> rhs (const T s) { return scalar_rhs<T>{ simd<T>::set1 (s), s }; }
+            template <typename T>
+            vector_rhs<T> rhs (const morph::vVector<T>& a, const morph::vVector<T>& b)
+            {
+                if (a.size() != b.size()) { throw std::runtime_error ("cmp: vVectors must be the same size"); }
+                return vector_rhs<T>{ b.data() };
+            }
+
+            //! out[i] = m[i] ? a[i] : r.at(i)
+            template <typename T, typename R>
+            void where (const bitmask& m, const morph::vVector<T>& a, const R& r, morph::vVector<T>& out)
+            {
+                typedef simd<T> S;
+                const size_t n = a.size();
+                if (m.size() != n || out.size() != n) { throw std::runtime_error ("cmp: mask, input and output must be the same size"); }
+                const T* ap = a.data();
+                T* op = out.data();
+                const uint64_t* wp = m.words.data();
+                const long long nw = static_cast<long long>(m.words.size());
+#pragma omp parallel for
+                for (long long k = 0; k < nw; ++k) {
+                    const size_t i = k * 64;
+                    const uint64_t w = wp[k];
+                    if (i + 64 <= n) {
+                        for (size_t j = 0; j < 64; j += S::n) { S::store (op + i + j, S::blend (w >> j, S::load (ap + i + j), r.reg (i + j))); }
+                    } else {
+                        for (size_t j = 0; i + j < n; ++j) { op[i + j] = ((w >> j) & 1u) ? ap[i + j] : r.at (i + j); }
+                    }
+                }
+            }
+
+            //! out[i] = (a[i] p r[i]) ? a[i] : f[i] in one pass, without a bitmask
+            template <typename T, typename R, typename Fill>
+            void select (const morph::vVector<T>& a, pred p, const R& r, const Fill& f, morph::vVector<T>& out)
+            {
+                typedef simd<T> S;
+                const size_t n = a.size();
+                if (out.size() != n) { throw std::runtime_error ("cmp: input and output must be the same size"); }
+                const T* ap = a.data();
+                T* op = out.data();
+                with_pred (p, [&](auto P) {
+                    constexpr int Pv = decltype(P)::value;
+                    const long long nb = static_cast<long long>(n / S::n);
+#pragma omp parallel for
+                    for (long long k = 0; k < nb; ++k) {
+                        const size_t i = k * S::n;
+                        const typename S::reg x = S::load (ap + i);
+                        S::store (op + i, S::template select<Pv> (x, r.reg (i), x, f.reg (i)));
+                    }
+                    for (size_t i = nb * S::n; i < n; ++i) { op[i] = scalar_cmp<Pv> (ap[i], r.at (i)) ? ap[i] : f.at (i); }
+                });
+            }
+        } // namespace detail
+
+        //! m[i] = a[i] p s
+        template <typename T>
+        void compare (const morph::vVector<T>& a, pred p, const T s, bitmask& m) { detail::compare (a, p, detail::rhs (s), m); }
+        //! m[i] = a[i] p b[i]
+        template <typename T>
+        void compare (const morph::vVector<T>& a, pred p, const morph::vVector<T>& b, bitmask& m) { detail::compare (a, p, detail::rhs (a, b), m); }
+
+        //! Is a[i] p s for any i?
+        template <typename T>
+        bool any (const morph::vVector<T>& a, pred p, const T s) { return detail::any (a, p, detail::rhs (s)); }
+        template <typename T>
+        bool any (const morph::vVector<T>& a, pred p, const morph::vVector<T>& b) { return detail::any (a, p, detail::rhs (a, b)); }
+
+        //! Is a[i] p s for all i? (True for an empty a.)
+        template <typename T>
+        bool all (const morph::vVector<T>& a, pred p, const T s) { return detail::all (a, p, detail::rhs (s)); }
+        template <typename T>
+        bool all (const morph::vVector<T>& a, pred p, const morph::vVector<T>& b) { return detail::all (a, p, detail::rhs (a, b)); }
+
+        //! How many i have a[i] p s?
+        template <typename T>
+        size_t count (const morph::vVector<T>& a, pred p, const T s) { return detail::count (a, p, detail::rhs (s)); }
+        template <typename T>
+        size_t count (const morph::vVector<T>& a, pred p, const morph::vVector<T>& b) { return detail::count (a, p, detail::rhs (a, b)); }
+
+        //! The lowest i with a[i] p s, or a.size() if there is none
+        template <typename T>
+        size_t first (const morph::vVector<T>& a, pred p, const T s) { return detail::first (a, p, detail::rhs (s)); }
+        template <typename T>
+        size_t first (const morph::vVector<T>& a, pred p, const morph::vVector<T>& b) { return detail::first (a, p, detail::rhs (a, b)); }
+
+        //! out[i] = m[i] ? a[i] : b[i]
+        template <typename T>
+        void where (const bitmask& m, const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            detail::where (m, a, detail::rhs (a, b), out);
+        }
+        //! out[i] = m[i] ? a[i] : s
+        template <typename T>
+        void where (const bitmask& m, const morph::vVector<T>& a, const T s, morph::vVector<T>& out)
+        {
+            detail::where (m, a, detail::rhs (s), out);
+        }
+
+        //! out[i] = (a[i] p s) ? a[i] : fill, in one pass. cc::cmp::where (a, cc::cmp::gt, 0.5f, 0.0f, out) thresholds a.
+        template <typename T>
+        void where (const morph::vVector<T>& a, pred p, const T s, const T fill, morph::vVector<T>& out)
+        {
+            detail::select (a, p, detail::rhs (s), detail::rhs (fill), out);
+        }
+        //! out[i] = (a[i] p b[i]) ? a[i] : fill[i], in one pass. With p = gt, out is the elementwise max.
+        template <typename T>
+        void where (const morph::vVector<T>& a, pred p, const morph::vVector<T>& b, const morph::vVector<T>& fill, morph::vVector<T>& out)
+        {
+            detail::select (a, p, detail::rhs (a, b), detail::rhs (a, fill), out);
+        }
+
+    } // namespace cmp
+} // namespace cc
@@ -0,0 +1,470 @@
+/*
+ * Complex vectors, in two layouts, with SIMD kernels. Interleaved (array of structs) is
+ * morph::vVector<std::complex<T>>, the layout of std::complex arrays, FFT libraries and
+ * Eigen::ArrayXcf. Split (struct of arrays) is cc::split_complex<T>, a vVector of real
+ * parts and one of imaginary parts, which SIMD code prefers: every lane of a register holds
+ * the same kind of value, so nothing needs shuffling.
+ *
+ *   morph::vVector<std::complex<float>> a(n), b(n), c(n);
+ *   cc::cplx::mult (a, b, c);                  // c = a * b
+ *   cc::split_complex<float> s;
+ *   cc::cplx::to_split (a, s);                 // and cc::cplx::to_interleaved (s, a)
+ *   morph::vVector<float> mag, ph;
+ *   cc::cplx::abs (s, mag);
+ *   cc::cplx::arg (s, ph);                     // in (-pi, pi], like std::arg
+ *
+ * mult, conj, abs, norm and arg take either layout. The products are computed as
+ * (ar br - ai bi, ar bi + ai br), without the NaN and infinity recovery that std::complex's
+ * operator* does (which is what makes GCC call __mulsc3 for it), and abs is sqrt(norm),
+ * without hypot's scaling, so it overflows for parts beyond about 1e19 (float). arg is a
+ * SIMD atan2 accurate to a couple of ulp for finite inputs.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#if !defined(__AVX2__)
+# error "complex_ops.h needs at least -mavx2"
+#endif
+
+namespace cc {
+
+    //! Complex numbers stored as separate vVectors of real and imaginary parts
+    template <typename T>
+    struct split_complex
+    {
+        morph::vVector<T> re;
+        morph::vVector<T> im;
+
+        split_complex() {}
+        split_complex (size_t n) : re(n), im(n) {}
+
+        size_t size() const { return this->re.size(); }
+        void resize (size_t n)
+        {
+            this->re.resize (n);
+            this->im.resize (n);
+        }
+        std::complex<T> operator[] (size_t i) const { return std::complex<T> (this->re[i], this->im[i]); }
+        void set (size_t i, std::complex<T> z)
+        {
+            this->re[i] = z.real();
+            this->im[i] = z.imag();
+        }
+    };
+
+    namespace cplx {
+
+        namespace detail {
+
+            // Complex arithmetic on registers at the widest width compiled for. n is the number
+            // of Ts in a register, so a register of interleaved data holds n / 2 complex numbers.
+            template <typename T> struct simd;
+#if defined(__AVX512F__)
+            template <>
+            struct simd<float>
+            {
+                typedef __m512 reg;
+                static constexpr size_t n = 16;
+                static reg load (const float* p) { return _mm512_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm512_storeu_ps (p, v); }
+                static reg set1 (float f) { return _mm512_set1_ps (f); }
+                static reg add (reg a, reg b) { return _mm512_add_ps (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_ps (a, b); }
+                static reg div (reg a, reg b) { return _mm512_div_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_ps (a, b); }
+                static reg sqrt (reg a) { return _mm512_sqrt_ps (a); }
+                static reg abs (reg a) { return _mm512_abs_ps (a); }
+                static reg flip (reg a, reg signs) { return _mm512_castsi512_ps (_mm512_xor_si512 (_mm512_castps_si512 (a), _mm512_castps_si512 (signs))); }
+                //! x > y ? a : b
+                static reg select_gt (reg x, reg y, reg a, reg b) { return _mm512_mask_blend_ps (_mm512_cmp_ps_mask (x, y, _CMP_GT_OQ), b, a); }
+                //! signbit(s) ? a : b
+                static reg select_neg (reg s, reg a, reg b) { return _mm512_mask_blend_ps (_mm512_test_epi32_mask (_mm512_castps_si512 (s), _mm512_set1_epi32 (0x80000000)), b, a); }
+                //! Products of the complex pairs interleaved in a and b
+                static reg cmul (reg a, reg b)
+                {
+                    const reg a_swap = _mm512_permute_ps (a, 0xb1);
+                    return _mm512_fmaddsub_ps (a, _mm512_moveldup_ps (b), _mm512_mul_ps (a_swap, _mm512_movehdup_ps (b)));
+                }
+                //! Real and imaginary parts of the n complex numbers interleaved in x0, x1
+                static void deinterleave (reg x0, reg x1, reg& re, reg& im)
+                {
+                    re = _mm512_permutex2var_ps (x0, _mm512_setr_epi32 (0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30), x1);
+                    im = _mm512_permutex2var_ps (x0, _mm512_setr_epi32 (1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31), x1);
+                }
+                static void interleave (reg re, reg im, reg& x0, reg& x1)
+                {
+                    x0 = _mm512_permutex2var_ps (re, _mm512_setr_epi32 (0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23), im);
+                    x1 = _mm512_permutex2var_ps (re, _mm512_setr_epi32 (8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31), im);
+                }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m512d reg;
+                static constexpr size_t n = 8;
+                static reg load (const double* p) { return _mm512_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm512_storeu_pd (p, v); }
+                static reg set1 (double f) { return _mm512_set1_pd (f); }
+                static reg add (reg a, reg b) { return _mm512_add_pd (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_pd (a, b); }
+                static reg div (reg a, reg b) { return _mm512_div_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_pd (a, b); }
+                static reg sqrt (reg a) { return _mm512_sqrt_pd (a); }
+                static reg abs (reg a) { return _mm512_abs_pd (a); }
+                static reg flip (reg a, reg signs) { return _mm512_castsi512_pd (_mm512_xor_si512 (_mm512_castpd_si512 (a), _mm512_castpd_si512 (signs))); }
+                static reg select_gt (reg x, reg y, reg a, reg b) { return _mm512_mask_blend_pd (_mm512_cmp_pd_mask (x, y, _CMP_GT_OQ), b, a); }
+                static reg select_neg (reg s, reg a, reg b) { return _mm512_mask_blend_pd (_mm512_test_epi64_mask (_mm512_castpd_si512 (s), _mm512_set1_epi64 (0x8000000000000000LL)), b, a); }
+                static reg cmul (reg a, reg b)
+                {
+                    const reg a_swap = _mm512_permute_pd (a, 0x55);
+                    return _mm512_fmaddsub_pd (a, _mm512_movedup_pd (b), _mm512_mul_pd (a_swap, _mm512_permute_pd (b, 0xff)));
+                }
+                static void deinterleave (reg x0, reg x1, reg& re, reg& im)
+                {
+                    re = _mm512_permutex2var_pd (x0, _mm512_setr_epi64 (0, 2, 4, 6, 8, 10, 12, 14), x1);
+                    im = _mm512_permutex2var_pd (x0, _mm512_setr_epi64 (1, 3, 5, 7, 9, 11, 13, 15), x1);
+                }
+                static void interleave (reg re, reg im, reg& x0, reg& x1)
+                {
+                    x0 = _mm512_permutex2var_pd (re, _mm512_setr_epi64 (0, 8, 1, 9, 2, 10, 3, 11), im);
+                    x1 = _mm512_permutex2var_pd (re, _mm512_setr_epi64 (4, 12, 5, 13, 6, 14, 7, 15), im);
+                }
+            };
+#else
+            template <>
+            struct simd<float>
+            {
+                typedef __m256 reg;
+                static constexpr size_t n = 8;
+                static reg load (const float* p) { return _mm256_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm256_storeu_ps (p, v); }
+                static reg set1 (float f) { return _mm256_set1_ps (f); }
+                static reg add (reg a, reg b) { return _mm256_add_ps (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_ps (a, b); }
+                static reg div (reg a, reg b) { return _mm256_div_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_ps (a, b); }
+                static reg sqrt (reg a) { return _mm256_sqrt_ps (a); }
+                static reg abs (reg a) { return _mm256_andnot_ps (_mm256_set1_ps (-0.0f), a); }
+                static reg flip (reg a, reg signs) { return _mm256_xor_ps (a, signs); }
+                static reg select_gt (reg x, reg y, reg a, reg b) { return _mm256_blendv_ps (b, a, _mm256_cmp_ps (x, y, _CMP_GT_OQ)); }
+                static reg select_neg (reg s, reg a, reg b) { return _mm256_blendv_ps (b, a, s); }
+                static reg cmul (reg a, reg b)
+                {
+                    const reg a_swap = _mm256_permute_ps (a, 0xb1);
+                    return _mm256_addsub_ps (_mm256_mul_ps (a, _mm256_moveldup_ps (b)), _mm256_mul_ps (a_swap, _mm256_movehdup_ps (b)));
+                }
+                static void deinterleave (reg x0, reg x1, reg& re, reg& im)
+                {
+                    // shuffle gives r0 r1 r4 r5 | r2 r3 r6 r7; the 64 bit permute puts them in order
+                    re = _mm256_castpd_ps (_mm256_permute4x64_pd (_mm256_castps_pd (_mm256_shuffle_ps (x0, x1, 0x88)), 0xd8));
+                    im = _mm256_castpd_ps (_mm256_permute4x64_pd (_mm256_castps_pd (_mm256_shuffle_ps (x0, x1, 0xdd)), 0xd8));
+                }
+                static void interleave (reg re, reg im, reg& x0, reg& x1)
+                {
+                    const reg r = _mm256_castpd_ps (_mm256_permute4x64_pd (_mm256_castps_pd (re), 0xd8));
+                    const reg i = _mm256_castpd_ps (_mm256_permute4x64_pd (_mm256_castps_pd (im), 0xd8));
+                    x0 = _mm256_unpacklo_ps (r, i);
+                    x1 = _mm256_unpackhi_ps (r, i);
+                }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m256d reg;
+                static constexpr size_t n = 4;
+                static reg load (const double* p) { return _mm256_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm256_storeu_pd (p, v); }
+                static reg set1 (double f) { return _mm256_set1_pd (f); }
+                static reg add (reg a, reg b) { return _mm256_add_pd (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_pd (a, b); }
+                static reg div (reg a, reg b) { return _mm256_div_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_pd (a, b); }
+                static reg sqrt (reg a) { return _mm256_sqrt_pd (a); }
+                static reg abs (reg a) { return _mm256_andnot_pd (_mm256_set1_pd (-0.0), a); }
+                static reg flip (reg a, reg signs) { return _mm256_xor_pd (a, signs); }
+                static reg select_gt (reg x, reg y, reg a, reg b) { return _mm256_blendv_pd (b, a, _mm256_cmp_pd (x, y, _CMP_GT_OQ)); }
+                static reg select_neg (reg s, reg a, reg b) { return _mm256_blendv_pd (b, a, s); }
+                static reg cmul (reg a, reg b)
+                {
+                    const reg a_swap = _mm256_permute_pd (a, 0x5);
+                    return _mm256_addsub_pd (_mm256_mul_pd (a, _mm256_movedup_pd (b)), _mm256_mul_pd (a_swap, _mm256_permute_pd (b, 0xf)));
+                }
+                static void deinterleave (reg x0, reg x1, reg& re, reg& im)
+                {
+                    re = _mm256_permute4x64_pd (_mm256_unpacklo_pd (x0, x1), 0xd8);
+                    im = _mm256_permute4x64_pd (_mm256_unpackhi_pd (x0, x1), 0xd8);
+                }
+                static void interleave (reg re, reg im, reg& x0, reg& x1)
+                {
+                    const reg r = _mm256_permute4x64_pd (re, 0xd8);
+                    const reg i = _mm256_permute4x64_pd (im, 0xd8);
+                    x0 = _mm256_unpacklo_pd (r, i);
+                    x1 = _mm256_unpackhi_pd (r, i);
+                }
+            };
+#endif
+
+            //! atan(a) for a in [0, 1]: Cephes' atanf and atan, with their reduction about tan(pi/8) and 0.66
+            template <typename S>
+            inline typename S::reg atan01 (typename S::reg a, float)
+            {
+                typedef typename S::reg reg;
+                const reg one = S::set1 (1.0f);
+                const reg big = S::select_gt (a, S::set1 (0.4142135623730950f), one, S::set1 (0.0f));
+                // a > tan(pi/8): atan(a) = pi/4 + atan((a - 1) / (a + 1))
+                const reg x = S::select_gt (a, S::set1 (0.4142135623730950f), S::div (S::sub (a, one), S::add (a, one)), a);
+                const reg z = S::mul (x, x);
+                reg p = S::set1 (8.05374449538e-2f);
+                p = S::sub (S::mul (p, z), S::set1 (1.38776856032e-1f));
+                p = S::add (S::mul (p, z), S::set1 (1.99777106478e-1f));
+                p = S::sub (S::mul (p, z), S::set1 (3.33329491539e-1f));
+                const reg r = S::add (S::mul (S::mul (p, z), x), x);
+                return S::add (r, S::mul (big, S::set1 (0.78539816339744830962f)));
+            }
+            template <typename S>
+            inline typename S::reg atan01 (typename S::reg a, double)
+            {
+                typedef typename S::reg reg;
+                const reg one = S::set1 (1.0);
+                const reg big = S::select_gt (a, S::set1 (0.66), one, S::set1 (0.0));
+                const reg x = S::select_gt (a, S::set1 (0.66), S::div (S::sub (a, one), S::add (a, one)), a);
+                const reg z = S::mul (x, x);
+                reg p = S::set1 (-8.750608600031904122785e-1);
+                p = S::add (S::mul (p, z), S::set1 (-1.615753718733365076637e1));
+                p = S::add (S::mul (p, z), S::set1 (-7.500855792314704667340e1));
+                p = S::add (S::mul (p, z), S::set1 (-1.228866684490136173410e2));
+                p = S::add (S::mul (p, z), S::set1 (-6.485021904942025371773e1));
+                reg q = S::add (z, S::set1 (2.485846490142306297962e1));
+                q = S::add (S::mul (q, z), S::set1 (1.650270098316988542046e2));
+                q = S::add (S::mul (q, z), S::set1 (4.328810604912902668951e2));
+                q = S::add (S::mul (q, z), S::set1 (4.853903996359136964868e2));
+                q = S::add (S::mul (q, z), S::set1 (1.945506571482613964425e2));
+                const reg r = S::add (S::mul (x, S::div (S::mul (z, p), q)), x);
+                // pi/4 in two parts, for the bits double can't hold in one: the low part goes
+                // onto the small r first, so it isn't lost when the high part is added
+                const reg lo = S::add (r, S::mul (big, S::set1 (0.5 * 6.123233995736765886130e-17)));
+                return S::add (lo, S::mul (big, S::set1 (0.78539816339744830962)));
+            }
+
+            //! atan2(im, re), in (-pi, pi]
+            template <typename T>
+            inline typename simd<T>::reg atan2 (typename simd<T>::reg im, typename simd<T>::reg re)
+            {
+                typedef simd<T> S;
+                typedef typename S::reg reg;
+                const reg ax = S::abs (re), ay = S::abs (im);
+                const reg mx = S::max (ax, ay), mn = S::min (ax, ay);
+                // 0 / 0 for the origin: make that atan(0)
+                const reg a = S::select_gt (mx, S::set1 (T{0}), S::div (mn, mx), S::set1 (T{0}));
+                reg r = atan01<S> (a, T{});
+                r = S::select_gt (ay, ax, S::sub (S::set1 (static_cast<T>(M_PI_2)), r), r);
+                r = S::select_neg (re, S::sub (S::set1 (static_cast<T>(M_PI)), r), r);
+                return S::select_neg (im, S::flip (r, S::set1 (T{-0.0})), r);
+            }
+
+            //! Elements per OpenMP chunk, a multiple of every register width
+            constexpr size_t chunk = 16384;
+
+            /*!
+             * vec(i) for each step-sized group starting in [0, n), scal(i) for the remainder,
+             * in chunks shared out over OpenMP when there's more than one
+             */
+            template <size_t Step, typename V, typename Sc>
+            void run (size_t n, V vec, Sc scal)
+            {
+                const long long nc = static_cast<long long>((n + chunk - 1) / chunk);
+                auto body = [&](long long c) {
+                    size_t i = c * chunk;
+                    const size_t hi = std::min (n, i + chunk);
+                    for (; i + Step <= hi; i += Step) { vec (i); }
+                    for (; i < hi; ++i) { scal (i); }
+                };
+                if (nc <= 1) {
+                    if (nc == 1) { body (0); }
+                } else {
+#pragma omp parallel for
+                    for (long long c = 0; c < nc; ++c) { body (c); }
+                }
+            }
+
+            template <typename T>
+            const T* parts (const morph::vVector<std::complex<T>>& a) { return reinterpret_cast<const T*>(a.data()); }
+            template <typename T>
+            T* parts (morph::vVector<std::complex<T>>& a) { return reinterpret_cast<T*>(a.data()); }
+
+            //! out[i] = f(re[i], im[i]) for a real valued f of each element of an interleaved vector
+            template <typename T, typename F, typename SF>
+            void to_real (const morph::vVector<std::complex<T>>& a, morph::vVector<T>& out, F f, SF sf)
+            {
+                typedef simd<T> S;
+                if (out.size() != a.size()) { out.resize (a.size()); }
+                const T* ap = parts (a);
+                T* op = out.data();
+                run<S::n> (a.size(), [&](size_t i) {
+                    typename S::reg re, im;
+                    S::deinterleave (S::load (ap + 2 * i), S::load (ap + 2 * i + S::n), re, im);
+                    S::store (op + i, f (re, im));
+                }, [&](size_t i) { op[i] = sf (ap[2 * i], ap[2 * i + 1]); });
+            }
+            template <typename T, typename F, typename SF>
+            void to_real (const split_complex<T>& a, morph::vVector<T>& out, F f, SF sf)
+            {
+                typedef simd<T> S;
+                if (out.size() != a.size()) { out.resize (a.size()); }
+                const T* re = a.re.data();
+                const T* im = a.im.data();
+                T* op = out.data();
+                run<S::n> (a.size(), [&](size_t i) { S::store (op + i, f (S::load (re + i), S::load (im + i))); },
+                           [&](size_t i) { op[i] = sf (re[i], im[i]); });
+            }
+
+            template <typename A, typename B>
+            void check_sizes (const A& a, const B& b)
+            {
+                if (a.size() != b.size()) { throw std::runtime_error ("cplx: vectors must be the same size"); }
+            }
+        } // namespace detail
+
+        //! Copy the interleaved a into the split out
+        template <typename T>
+        void to_split (const morph::vVector<std::complex<T>>& a, split_complex<T>& out)
+        {
+            typedef detail::simd<T> S;
+            out.resize (a.size());
+            const T* ap = detail::parts (a);
+            T* re = out.re.data();
+            T* im = out.im.data();
+            detail::run<S::n> (a.size(), [&](size_t i) {
+                typename S::reg r, m;
+                S::deinterleave (S::load (ap + 2 * i), S::load (ap + 2 * i + S::n), r, m);
+                S::store (re + i, r);
+                S::store (im + i, m);
+            }, [&](size_t i) { re[i] = ap[2 * i]; im[i] = ap[2 * i + 1]; });
+        }
+
+        //! Copy the split a into the interleaved out
+        template <typename T>
+        void to_interleaved (const split_complex<T>& a, morph::vVector<std::complex<T>>& out)
+        {
+            typedef detail::simd<T> S;
+            if (out.size() != a.size()) { out.resize (a.size()); }
+            const T* re = a.re.data();
+            const T* im = a.im.data();
+            T* op = detail::parts (out);
+            detail::run<S::n> (a.size(), [&](size_t i) {
+                typename S::reg x0, x1;
+                S::interleave (S::load (re + i), S::load (im + i), x0, x1);
+                S::store (op + 2 * i, x0);
+                S::store (op + 2 * i + S::n, x1);
+            }, [&](size_t i) { op[2 * i] = re[i]; op[2 * i + 1] = im[i]; });
+        }
+
+        //! out = a * b
+        template <typename T>
+        void mult (const morph::vVector<std::complex<T>>& a, const morph::vVector<std::complex<T>>& b, morph::vVector<std::complex<T>>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::check_sizes (a, b);
+            if (out.size() != a.size()) { out.resize (a.size()); }
+            const T* ap = detail::parts (a);
+            const T* bp = detail::parts (b);
+            T* op = detail::parts (out);
+            // A register holds n / 2 complex numbers
+            detail::run<S::n / 2> (a.size(), [&](size_t i) { S::store (op + 2 * i, S::cmul (S::load (ap + 2 * i), S::load (bp + 2 * i))); },
+                                   [&](size_t i) {
+                                       const T ar = ap[2 * i], ai = ap[2 * i + 1], br = bp[2 * i], bi = bp[2 * i + 1];
+                                       op[2 * i] = ar * br - ai * bi;
+                                       op[2 * i + 1] = ar * bi + ai * br;
+                                   });
+        }
+        template <typename T>
+        void mult (const split_complex<T>& a, const split_complex<T>& b, split_complex<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::check_sizes (a, b);
+            out.resize (a.size());
+            const T* ar = a.re.data(); const T* ai = a.im.data();
+            const T* br = b.re.data(); const T* bi = b.im.data();
+            T* or_ = out.re.data(); T* oi = out.im.data();
+            detail::run<S::n> (a.size(), [&](size_t i) {
+                const typename S::reg xr = S::load (ar + i), xi = S::load (ai + i), yr = S::load (br + i), yi = S::load (bi + i);
+                S::store (or_ + i, S::sub (S::mul (xr, yr), S::mul (xi, yi)));
+                S::store (oi + i, S::add (S::mul (xr, yi), S::mul (xi, yr)));
+            }, [&](size_t i) {
+                const T xr = ar[i], xi = ai[i];
+                or_[i] = xr * br[i] - xi * bi[i];
+                oi[i] = xr * bi[i] + xi * br[i];
+            });
+        }
+
+        //! out = the complex conjugate of a
+        template <typename T>
+        void conj (const morph::vVector<std::complex<T>>& a, morph::vVector<std::complex<T>>& out)
+        {
+            typedef detail::simd<T> S;
+            if (out.size() != a.size()) { out.resize (a.size()); }
+            const T* ap = detail::parts (a);
+            T* op = detail::parts (out);
+            // Flip the sign bit of every imaginary part (the odd lanes)
+            alignas(64) T pattern[S::n];
+            for (size_t j = 0; j < S::n; ++j) { pattern[j] = j % 2 ? T{-0.0} : T{0}; }
+            const typename S::reg signs = S::load (pattern);
+            detail::run<S::n / 2> (a.size(), [&](size_t i) { S::store (op + 2 * i, S::flip (S::load (ap + 2 * i), signs)); },
+                                   [&](size_t i) { op[2 * i] = ap[2 * i]; op[2 * i + 1] = -ap[2 * i + 1]; });
+        }
+        template <typename T>
+        void conj (const split_complex<T>& a, split_complex<T>& out)
+        {
+            typedef detail::simd<T> S;
+            out.resize (a.size());
+            const T* ai = a.im.data();
+            T* oi = out.im.data();
+            if (&out != &a) { std::copy (a.re.begin(), a.re.end(), out.re.begin()); }
+            const typename S::reg signs = S::set1 (T{-0.0});
+            detail::run<S::n> (a.size(), [&](size_t i) { S::store (oi + i, S::flip (S::load (ai + i), signs)); },
+                               [&](size_t i) { oi[i] = -ai[i]; });
+        }
+
+        //! out[i] = |a[i]|^2
+        template <typename A, typename T>
+        void norm (const A& a, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::to_real (a, out, [](typename S::reg re, typename S::reg im) { return S::add (S::mul (re, re), S::mul (im, im)); },
+                             [](T re, T im) { return re * re + im * im; });
+        }
+
+        //! out[i] = |a[i]|
+        template <typename A, typename T>
+        void abs (const A& a, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::to_real (a, out, [](typename S::reg re, typename S::reg im) { return S::sqrt (S::add (S::mul (re, re), S::mul (im, im))); },
+                             [](T re, T im) { return std::sqrt (re * re + im * im); });
+        }
+
+        //! out[i] = the phase of a[i], in (-pi, pi]
+        template <typename A, typename T>
+        void arg (const A& a, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::to_real (a, out, [](typename S::reg re, typename S::reg im) { return detail::atan2<T> (im, re); },
+                             [](T re, T im) { return std::atan2 (im, re); });
+        }
+
+    } // namespace cplx
+} // namespace cc
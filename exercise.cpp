@@ -3,6 +3,13 @@
 #include <morph/Random.h>
 #include <morph/vVector.h>
 #include <chrono>
+#include "perf_counters.h"
+#include "bench_check.h"
+// The workshop headers compare signed with unsigned; they're not ours to change
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#include "chryswoods/floatvec.h"
+#pragma GCC diagnostic pop
 
 using namespace std::chrono;
 using std::chrono::steady_clock;
@@ -11,11 +18,21 @@ using std::chrono::steady_clock;
 typedef float F;
 typedef Eigen::Array<F, Eigen::Dynamic, 1> EigenVec;
 
+// Elements processed by each timed loop, for the per element hardware counter figures
+const double n_elements = 500.0 * 1000000.0;
+
+// Each result is checked against a double precision reference: + * and / must be
+// correctly rounded; pow implementations may be a few ulp out
+const uint64_t pow_ulps = 4;
+
 int main()
 {
+    // Open the counters before OpenMP starts its threads, so that they're inherited
+    cc::perf_counters pc;
     morph::RandUniform<float> rng;
     steady_clock::time_point start = steady_clock::now();
     steady_clock::duration sincestart;
+    cc::bench::result res;
 
     // Multiplication. Eigen
     EigenVec ev(1000000);
@@ -23,12 +40,18 @@ int main()
     EigenVec ev2(1000000);
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         ev2 = ev * i;
+        cc::bench::do_not_optimize (ev2.data());
+        cc::bench::clobber_memory();
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
-    std::cout << "Scalar mult took " << duration_cast<milliseconds>(sincestart).count() << " ms with Eigen" << std::endl;
+    res = cc::bench::check (ev2.data(), ev2.size(), [&](size_t j) { return double(ev[j]) * F{499}; }, 0);
+    std::cout << "Scalar mult took " << duration_cast<milliseconds>(sincestart).count() << " ms with Eigen (" << res << ")" << std::endl;
+    pc.report ("Scalar mult (Eigen)", n_elements);
 
     // Multiplication. vVector
     morph::vVector<F> v(1000000);
@@ -36,72 +59,166 @@ int main()
     morph::vVector<F> v2(1000000);
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         //v *= i; // super fast. 500 million mults in 8 ms = 62.5 gflops (with omp parallel)
         //v2 = v * i; // Same speed as Eigen (but with omp parallel). 65 ms.
         v.mult (i, v2); // With OpenMP parallel on an i9, this whips Eigen (20ms to 66 ms).
+        cc::bench::do_not_optimize (v2.data());
+        cc::bench::clobber_memory();
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
-    std::cout << "Scalar mult took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector" << std::endl;
+    res = cc::bench::check (v2.data(), v2.size(), [&](size_t j) { return double(v[j]) * F{499}; }, 0);
+    std::cout << "Scalar mult took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector (" << res << ")" << std::endl;
+    pc.report ("Scalar mult (vVector)", n_elements);
 
     // Vec Multiplication. Eigen
     EigenVec ev3(1000000);
     for (auto& vv : ev3) { vv = rng.get(); }
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         ev2 = ev * ev3;
+        cc::bench::do_not_optimize (ev2.data());
+        cc::bench::clobber_memory();
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
-    std::cout << "Vector mult took " << duration_cast<milliseconds>(sincestart).count() << " ms with Eigen" << std::endl;
+    res = cc::bench::check (ev2.data(), ev2.size(), [&](size_t j) { return double(ev[j]) * ev3[j]; }, 0);
+    std::cout << "Vector mult took " << duration_cast<milliseconds>(sincestart).count() << " ms with Eigen (" << res << ")" << std::endl;
+    pc.report ("Vector mult (Eigen)", n_elements);
 
     // Vec Multiplication. vVector
     morph::vVector<F> v3(1000000);
     v3.randomize();
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         v2 = v * v3;
+        cc::bench::do_not_optimize (v2.data());
+        cc::bench::clobber_memory();
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
-    std::cout << "Vector mult took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector" << std::endl;
+    res = cc::bench::check (v2.data(), v2.size(), [&](size_t j) { return double(v[j]) * v3[j]; }, 0);
+    std::cout << "Vector mult took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector (" << res << ")" << std::endl;
+    pc.report ("Vector mult (vVector)", n_elements);
 
     // Vec Division. Eigen
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         ev2 = ev / ev3;
+        cc::bench::do_not_optimize (ev2.data());
+        cc::bench::clobber_memory();
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
-    std::cout << "Vector div took " << duration_cast<milliseconds>(sincestart).count() << " ms with Eigen" << std::endl;
+    res = cc::bench::check (ev2.data(), ev2.size(), [&](size_t j) { return double(ev[j]) / ev3[j]; }, 0);
+    std::cout << "Vector div took " << duration_cast<milliseconds>(sincestart).count() << " ms with Eigen (" << res << ")" << std::endl;
+    pc.report ("Vector div (Eigen)", n_elements);
 
     // Vec Division. vVector
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         v2 = v / v3;
+        cc::bench::do_not_optimize (v2.data());
+        cc::bench::clobber_memory();
+    }
+    pc.stop();
+    sincestart = steady_clock::now() - start;
+
+    res = cc::bench::check (v2.data(), v2.size(), [&](size_t j) { return double(v[j]) / v3[j]; }, 0);
+    std::cout << "Vector div took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector (" << res << ")" << std::endl;
+    pc.report ("Vector div (vVector)", n_elements);
+
+    // Vec Addition. Eigen, vVector and FloatVec. Into its own Eigen result, as ev2 (the
+    // last division's result) is the input to the Eigen pow below.
+    EigenVec ev_sum(1000000);
+    start = steady_clock::now();
+    pc.start();
+    for (F i = F{0}; i < F{500}; i += F{1}) {
+        ev_sum = ev + ev3;
+        cc::bench::do_not_optimize (ev_sum.data());
+        cc::bench::clobber_memory();
+    }
+    pc.stop();
+    sincestart = steady_clock::now() - start;
+
+    res = cc::bench::check (ev_sum.data(), ev_sum.size(), [&](size_t j) { return double(ev[j]) + ev3[j]; }, 0);
+    std::cout << "Vector add took " << duration_cast<milliseconds>(sincestart).count() << " ms with Eigen (" << res << ")" << std::endl;
+    pc.report ("Vector add (Eigen)", n_elements);
+
+    start = steady_clock::now();
+    pc.start();
+    for (F i = F{0}; i < F{500}; i += F{1}) {
+        v2 = v + v3;
+        cc::bench::do_not_optimize (v2.data());
+        cc::bench::clobber_memory();
+    }
+    pc.stop();
+    sincestart = steady_clock::now() - start;
+
+    res = cc::bench::check (v2.data(), v2.size(), [&](size_t j) { return double(v[j]) + v3[j]; }, 0);
+    std::cout << "Vector add took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector (" << res << ")" << std::endl;
+    pc.report ("Vector add (vVector)", n_elements);
+
+    workshop::Array<float> wa (v.begin(), v.end());
+    workshop::Array<float> wb (v3.begin(), v3.end());
+    FloatVec::Array fa = FloatVec::fromArray (wa);
+    FloatVec::Array fb = FloatVec::fromArray (wb);
+    FloatVec::Array fc (fa.size());
+    start = steady_clock::now();
+    pc.start();
+    for (F i = F{0}; i < F{500}; i += F{1}) {
+        for (size_t j = 0; j < fa.size(); ++j) { fc[j] = fa[j] + fb[j]; }
+        cc::bench::do_not_optimize (fc.data());
+        cc::bench::clobber_memory();
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
-    std::cout << "Vector div took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector" << std::endl;
+    // FloatVec pads to whole vectors, so check the first v.size() floats of the result
+    workshop::Array<float> wc = FloatVec::toArray (fc);
+    res = cc::bench::check (wc.data(), v.size(), [&](size_t j) { return double(v[j]) + v3[j]; }, 0);
+    std::cout << "Vector add took " << duration_cast<milliseconds>(sincestart).count() << " ms with FloatVec (" << res << ")" << std::endl;
+    pc.report ("Vector add (FloatVec)", n_elements);
 
     // Pow
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         ev = ev2.pow(F{1}/i); // 2640 ms
+        cc::bench::do_not_optimize (ev.data());
+        cc::bench::clobber_memory();
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
-    std::cout << "Raise to scalar power took " << duration_cast<milliseconds>(sincestart).count() << " ms with Eigen" << std::endl;
+    res = cc::bench::check (ev.data(), ev.size(), [&](size_t j) { return std::pow (double(ev2[j]), double(F{1}/F{499})); }, pow_ulps);
+    std::cout << "Raise to scalar power took " << duration_cast<milliseconds>(sincestart).count() << " ms with Eigen (" << res << ")" << std::endl;
+    pc.report ("Raise to scalar power (Eigen)", n_elements);
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         //v.pow_inplace (F{1}/i); // 949 ms no OMP, 120 ms with.
         v2 = v.pow (F{1}/i); // 2617 ms. 320 ms with.
+        cc::bench::do_not_optimize (v2.data());
+        cc::bench::clobber_memory();
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
-    std::cout << "Raise to scalar power took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector" << std::endl;
+    res = cc::bench::check (v2.data(), v2.size(), [&](size_t j) { return std::pow (double(v[j]), double(F{1}/F{499})); }, pow_ulps);
+    std::cout << "Raise to scalar power took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector (" << res << ")" << std::endl;
+    pc.report ("Raise to scalar power (vVector)", n_elements);
 
-    return 0;
+    return cc::bench::failures > 0 ? 1 : 0;
 }
@@ -2,12 +2,16 @@
 #include <Eigen/Dense>
 #include <morph/Random.h>
 #include <chrono>
+#include "bench_check.h"
 
 using namespace std::chrono;
 using std::chrono::steady_clock;
 
 typedef Eigen::Array<float, Eigen::Dynamic, 1> EigenVec;
 
+// A single 8192 element op is too quick to time on its own
+const int reps = 100000;
+
 int main()
 {
     morph::RandUniform<float> rng;
@@ -20,10 +24,15 @@ int main()
     EigenVec v2(8192);
 
     steady_clock::time_point start = steady_clock::now();
-    v2 = v * 2.0f;
+    for (int r = 0; r < reps; ++r) {
+        v2 = v * 2.0f;
+        cc::bench::do_not_optimize (v2.data());
+        cc::bench::clobber_memory();
+    }
     steady_clock::duration sincestart = steady_clock::now() - start;
 
-    std::cout << "Operation took " << duration_cast<nanoseconds>(sincestart).count() << " ns" << std::endl;
+    cc::bench::result res = cc::bench::check (v2.data(), v2.size(), [&](size_t j) { return double(v[j]) * 2.0; }, 0);
+    std::cout << "Operation took " << duration_cast<nanoseconds>(sincestart).count() / reps << " ns (" << res << ")" << std::endl;
 
-    return 0;
+    return cc::bench::failures > 0 ? 1 : 0;
 }
@@ -0,0 +1,164 @@
+/*
+ * The cc::avx512 kernels at 256 and 512 bits against vVector's own ops, over lengths from
+ * cache resident to DRAM sized, none a multiple of the register width. Run it on each
+ * host to decide which width to use there; the last line is what calibrate() picks. Every
+ * result at each width is checked: mult and div exactly, sum and dot against a double
+ * reference, and exactly on 0/1 data, whose sums are exact in any order, so that a tail
+ * element dropped or counted twice can't hide in the rounding.
+ */
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <morph/vVector.h>
+#include "avx512_ops.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+// About this many elements are processed for each measurement
+const size_t work = 400000000;
+
+void report (const std::string& op, const std::string& what, size_t n, steady_clock::duration d, size_t reps)
+{
+    double ns_per_elem = duration_cast<nanoseconds>(d).count() / static_cast<double>(n * reps);
+    std::cout << "  " << op << " took " << duration_cast<milliseconds>(d).count() << " ms ("
+              << ns_per_elem << " ns/element) with " << what << std::endl;
+}
+
+/*
+ * A reduction got, against ref in double: within tol of it relative to mag, the sum of the
+ * magnitudes of the terms. With each of L lanes summing n/L terms in F, tol = (n/L + 1) eps
+ * bounds the rounding however the data falls.
+ */
+void check_reduction (const std::string& what, F got, double ref, double mag, double tol)
+{
+    const double err = std::abs (got - ref);
+    if (err <= tol * mag) {
+        std::cout << "    " << what << " is within " << err / mag << " of the double sum (tolerance " << tol << ")" << std::endl;
+    } else {
+        ++cc::bench::failures;
+        std::cout << "    " << what << " is WRONG: " << got << " where the double sum is " << ref << std::endl;
+    }
+}
+
+void check_exact (const std::string& what, F got, double ref)
+{
+    if (static_cast<double>(got) == ref) {
+        std::cout << "    " << what << " on 0/1 data is exact" << std::endl;
+    } else {
+        ++cc::bench::failures;
+        std::cout << "    " << what << " on 0/1 data is WRONG: " << got << " where it should be " << ref << std::endl;
+    }
+}
+
+void run (size_t n)
+{
+    morph::vVector<F> a(n), b(n), out(n);
+    a.randomize();
+    b.randomize();
+    b += 0.5f;
+    const size_t reps = work / n > 0 ? work / n : 1;
+    std::cout << "Length " << n << " (" << reps << " reps):" << std::endl;
+
+    const cc::avx512::width widths[2] = { cc::avx512::width::w256, cc::avx512::width::w512 };
+    const std::string names[2] = { "cc::avx512 at 256 bits", "cc::avx512 at 512 bits" };
+    const int nw = cc::avx512::have_512() ? 2 : 1;
+
+    steady_clock::time_point start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        out = a * b;
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("Vector mult", "vVector::operator*", n, steady_clock::now() - start, reps);
+    for (int k = 0; k < nw; ++k) {
+        start = steady_clock::now();
+        for (size_t r = 0; r < reps; ++r) {
+            cc::avx512::mult (a, b, out, widths[k]);
+            __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+        }
+        report ("Vector mult", names[k], n, steady_clock::now() - start, reps);
+        std::cout << "    " << cc::bench::check (out.data(), n, [&](size_t i) { return double(a[i]) * b[i]; }, 0) << std::endl;
+    }
+
+    start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        out = a / b;
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("Vector div", "vVector::operator/", n, steady_clock::now() - start, reps);
+    for (int k = 0; k < nw; ++k) {
+        start = steady_clock::now();
+        for (size_t r = 0; r < reps; ++r) {
+            cc::avx512::div (a, b, out, widths[k]);
+            __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+        }
+        report ("Vector div", names[k], n, steady_clock::now() - start, reps);
+        std::cout << "    " << cc::bench::check (out.data(), n, [&](size_t i) { return double(a[i]) / b[i]; }, 0) << std::endl;
+    }
+
+    // The references, and the 0/1 data: a pattern, with the last (tail) elements set
+    double sum_ref = 0.0, dot_ref = 0.0, dot_mag = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        sum_ref += a[i];
+        dot_ref += static_cast<double>(a[i]) * b[i];
+        dot_mag += std::abs (static_cast<double>(a[i]) * b[i]);
+    }
+    morph::vVector<F> a01(n), b01(n);
+    for (size_t i = 0; i < n; ++i) {
+        a01[i] = ((i * 2654435761u) >> 7) & 1 ? F{1} : F{0};
+        b01[i] = (i % 3) == 0 || i + 20 > n ? F{1} : F{0};
+    }
+    double sum01 = 0.0, dot01 = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        sum01 += b01[i];
+        dot01 += a01[i] * b01[i];
+    }
+    const double tol = (n / 8.0 + 1.0) * std::numeric_limits<F>::epsilon();
+
+    F s = 0;
+    start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) { s += a.sum(); }
+    report ("Sum", "vVector::sum", n, steady_clock::now() - start, reps);
+    std::cout << "    (" << s / reps << ")" << std::endl;
+    for (int k = 0; k < nw; ++k) {
+        s = 0;
+        start = steady_clock::now();
+        for (size_t r = 0; r < reps; ++r) { s += cc::avx512::sum (a, widths[k]); }
+        report ("Sum", names[k], n, steady_clock::now() - start, reps);
+        std::cout << "    (" << s / reps << ")" << std::endl;
+        check_reduction ("sum", cc::avx512::sum (a, widths[k]), sum_ref, sum_ref, tol);
+        check_exact ("sum", cc::avx512::sum (b01, widths[k]), sum01);
+    }
+
+    s = 0;
+    start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) { s += a.dot (b); }
+    report ("Dot product", "vVector::dot", n, steady_clock::now() - start, reps);
+    std::cout << "    (" << s / reps << ")" << std::endl;
+    for (int k = 0; k < nw; ++k) {
+        s = 0;
+        start = steady_clock::now();
+        for (size_t r = 0; r < reps; ++r) { s += cc::avx512::dot (a, b, widths[k]); }
+        report ("Dot product", names[k], n, steady_clock::now() - start, reps);
+        std::cout << "    (" << s / reps << ")" << std::endl;
+        check_reduction ("dot", cc::avx512::dot (a, b, widths[k]), dot_ref, dot_mag, tol);
+        check_exact ("dot", cc::avx512::dot (a01, b01, widths[k]), dot01);
+    }
+}
+
+int main()
+{
+    if (!cc::avx512::have_512()) { std::cout << "No AVX-512 in this build or on this CPU; 256-bit kernels only" << std::endl; }
+    run (1001);
+    run (100003);
+    run (10000019);
+    std::cout << "calibrate() chose min_512_elements = " << cc::avx512::calibrate() << std::endl;
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * exercise_smallvecs.cpp shows that parallelising one 4 element op is a loss. Here there
+ * are 100000 independent 4 element ops, and we compare looping over individual calls
+ * (vVector::mult with its internal OpenMP, and morph::Vector's operator*) against
+ * cc::batch, which parallelises across the batch. Every element of every batched result
+ * is checked to be exactly what the per-vector op gives.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <morph/Vector.h>
+#include <morph/vVector.h>
+#include "batch_ops.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+// How long are the vectors and how many are there?
+const size_t veclen = 4;
+const size_t batchsize = 100000;
+const int reps = 100;
+
+// Check out[j][i] == want(j, i) for every vector j and element i
+template <typename Batch, typename Want>
+void check_batch (const std::string& what, const Batch& out, Want want)
+{
+    size_t wrong = 0;
+    for (size_t j = 0; j < batchsize; ++j) {
+        for (size_t i = 0; i < veclen; ++i) {
+            // Both NaN (0/0, should b hold a zero) counts as the same
+            const F g = out[j][i], w = want (j, i);
+            wrong += !(g == w || (g != g && w != w));
+        }
+    }
+    if (wrong > 0) { ++cc::bench::failures; }
+    std::cout << "  " << what << (wrong == 0 ? " matches the per-vector op" : " is WRONG at " + std::to_string (wrong) + " elements") << std::endl;
+}
+
+template <typename Exec, typename Batch>
+void run_batch (const std::string& what, Exec& exec, const Batch& a, const Batch& b, Batch& out)
+{
+    steady_clock::time_point start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::batch::scale (exec, a, static_cast<F>(r), out); }
+    steady_clock::duration d = steady_clock::now() - start;
+    std::cout << "Scalar mult took " << duration_cast<microseconds>(d).count() << " us with " << what << std::endl;
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::batch::mult (exec, a, b, out); }
+    d = steady_clock::now() - start;
+    std::cout << "Vector mult took " << duration_cast<microseconds>(d).count() << " us with " << what << std::endl;
+
+    // Each op once more, checked element by element
+    cc::batch::scale (exec, a, F{3}, out);
+    check_batch ("cc::batch::scale", out, [&](size_t j, size_t i) { return a[j][i] * F{3}; });
+    cc::batch::mult (exec, a, b, out);
+    check_batch ("cc::batch::mult", out, [&](size_t j, size_t i) { return a[j][i] * b[j][i]; });
+    cc::batch::div (exec, a, b, out);
+    check_batch ("cc::batch::div", out, [&](size_t j, size_t i) { return a[j][i] / b[j][i]; });
+    cc::batch::apply (exec, a, b, out, [](F x, F y) { return x - y; });
+    check_batch ("cc::batch::apply", out, [&](size_t j, size_t i) { return a[j][i] - b[j][i]; });
+}
+
+int main()
+{
+    cc::thread_pool pool;
+#ifdef _OPENMP
+    cc::openmp_executor omp;
+#endif
+
+    // The batch as vVectors
+    std::vector<morph::vVector<F>> va(batchsize, morph::vVector<F>(veclen));
+    std::vector<morph::vVector<F>> vb(batchsize, morph::vVector<F>(veclen));
+    std::vector<morph::vVector<F>> vout(batchsize, morph::vVector<F>(veclen));
+    for (auto& v : va) { v.randomize(); }
+    for (auto& v : vb) { v.randomize(); }
+
+    // The same batch as morph::Vectors
+    std::vector<morph::Vector<F, veclen>> ma(batchsize), mb(batchsize), mout(batchsize);
+    for (size_t j = 0; j < batchsize; ++j) {
+        for (size_t i = 0; i < veclen; ++i) { ma[j][i] = va[j][i]; mb[j][i] = vb[j][i]; }
+    }
+
+    steady_clock::time_point start;
+    steady_clock::duration d;
+
+    // One call per vVector
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        for (size_t j = 0; j < batchsize; ++j) { va[j].mult (static_cast<F>(r), vout[j]); }
+    }
+    d = steady_clock::now() - start;
+    std::cout << "Scalar mult took " << duration_cast<microseconds>(d).count() << " us looping over vVector::mult" << std::endl;
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        for (size_t j = 0; j < batchsize; ++j) { vout[j] = va[j] * vb[j]; }
+    }
+    d = steady_clock::now() - start;
+    std::cout << "Vector mult took " << duration_cast<microseconds>(d).count() << " us looping over vVector::operator*" << std::endl;
+
+    // One call per morph::Vector
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        for (size_t j = 0; j < batchsize; ++j) { mout[j] = ma[j] * static_cast<F>(r); }
+    }
+    d = steady_clock::now() - start;
+    std::cout << "Scalar mult took " << duration_cast<microseconds>(d).count() << " us looping over morph::Vector::operator*" << std::endl;
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        for (size_t j = 0; j < batchsize; ++j) { mout[j] = ma[j] * mb[j]; }
+    }
+    d = steady_clock::now() - start;
+    std::cout << "Vector mult took " << duration_cast<microseconds>(d).count() << " us looping over morph::Vector::operator*" << std::endl;
+
+    // Batched
+    run_batch ("cc::batch on vVectors (thread_pool)", pool, va, vb, vout);
+    run_batch ("cc::batch on morph::Vectors (thread_pool)", pool, ma, mb, mout);
+#ifdef _OPENMP
+    run_batch ("cc::batch on vVectors (OpenMP)", omp, va, vb, vout);
+    run_batch ("cc::batch on morph::Vectors (OpenMP)", omp, ma, mb, mout);
+#endif
+
+    return cc::bench::failures > 0 ? 1 : 0;
+}
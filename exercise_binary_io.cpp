@@ -0,0 +1,153 @@
+/*
+ * Compare the speed of saving/loading a big vVector as text (with operator<<) and with
+ * cc::save_binary/cc::load_binary, with and without compression. Also round-trips a
+ * FloatVec::Array.
+ *
+ * Usage: exercise_binary_io [directory]  (default /tmp)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <unistd.h>
+#include <morph/vVector.h>
+// The workshop headers compare signed with unsigned; they're not ours to change
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#include "chryswoods/floatvec.h"
+#pragma GCC diagnostic pop
+#include "binary_io.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+// How long is the vector? 16M floats = 64 MB
+const size_t veclen = 16 * 1024 * 1024;
+
+void report (const std::string& what, steady_clock::duration d, const std::string& path)
+{
+    std::ifstream f (path, std::ios::binary | std::ios::ate);
+    double mb = f.tellg() / (1024.0 * 1024.0);
+    double ms = duration_cast<microseconds>(d).count() / 1000.0;
+    std::cout << what << " took " << duration_cast<milliseconds>(d).count() << " ms; file is "
+              << mb << " MB; " << (veclen * sizeof(F) / (1024.0 * 1024.0)) / (ms / 1000.0) << " MB/s of vector data" << std::endl;
+}
+
+int main (int argc, char** argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "/tmp";
+    std::string txtpath = dir + "/calculatorcompare_io.txt";
+    std::string binpath = dir + "/calculatorcompare_io.bin";
+    std::string zpath = dir + "/calculatorcompare_io.binz";
+
+    morph::vVector<F> v(veclen);
+    v.randomize();
+    // Quantise a little so the data isn't entirely incompressible, as real state often isn't
+    for (auto& vv : v) { vv = static_cast<F>(static_cast<int>(vv * 4096.0f)) / 4096.0f; }
+
+    steady_clock::time_point start;
+    steady_clock::duration sincestart;
+    int mismatches = 0;
+
+    try {
+        // Text out
+        start = steady_clock::now();
+        {
+            std::ofstream f (txtpath);
+            f << v;
+        }
+        sincestart = steady_clock::now() - start;
+        report ("Text write", sincestart, txtpath);
+
+        // Text in. operator<< writes (a,b,c,...)
+        morph::vVector<F> vt;
+        vt.reserve (veclen);
+        start = steady_clock::now();
+        {
+            std::ifstream f (txtpath);
+            char c;
+            F val;
+            f >> c; // '('
+            while (f >> val) {
+                vt.push_back (val);
+                f >> c; // ',' or ')'
+            }
+        }
+        sincestart = steady_clock::now() - start;
+        report ("Text read", sincestart, txtpath);
+
+        // Binary out
+        start = steady_clock::now();
+        cc::save_binary (binpath, v);
+        sincestart = steady_clock::now() - start;
+        report ("Binary write", sincestart, binpath);
+
+        // Binary in
+        morph::vVector<F> vb;
+        start = steady_clock::now();
+        cc::load_binary (binpath, vb);
+        sincestart = steady_clock::now() - start;
+        report ("Binary read", sincestart, binpath);
+        std::cout << "Binary round trip is " << (vb == v ? "exact" : "NOT EXACT") << std::endl;
+        mismatches += vb == v ? 0 : 1;
+
+        // A truncated file must be rejected before its header's count is trusted
+        if (::truncate (binpath.c_str(), 64 + 1024) != 0) { throw std::runtime_error ("can't truncate " + binpath); }
+        bool rejected = false;
+        try {
+            cc::load_binary (binpath, vb);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        std::cout << "Truncated file is " << (rejected ? "rejected" : "NOT REJECTED") << std::endl;
+        mismatches += rejected ? 0 : 1;
+
+#ifdef CC_HAVE_ZLIB
+        start = steady_clock::now();
+        cc::save_binary (zpath, v, true);
+        sincestart = steady_clock::now() - start;
+        report ("Compressed binary write", sincestart, zpath);
+
+        morph::vVector<F> vz;
+        start = steady_clock::now();
+        cc::load_binary (zpath, vz);
+        sincestart = steady_clock::now() - start;
+        report ("Compressed binary read", sincestart, zpath);
+        std::cout << "Compressed round trip is " << (vz == v ? "exact" : "NOT EXACT") << std::endl;
+        mismatches += vz == v ? 0 : 1;
+        std::remove (zpath.c_str());
+#endif
+
+        // FloatVec::Array, written from and read back into its aligned storage
+        workshop::Array<float> wa (v.begin(), v.end());
+        FloatVec::Array fva = FloatVec::fromArray (wa);
+        start = steady_clock::now();
+        cc::save_binary (binpath, fva);
+        sincestart = steady_clock::now() - start;
+        report ("FloatVec::Array binary write", sincestart, binpath);
+
+        FloatVec::Array fvb;
+        start = steady_clock::now();
+        cc::load_binary (binpath, fvb);
+        sincestart = steady_clock::now() - start;
+        report ("FloatVec::Array binary read", sincestart, binpath);
+        const bool fv_exact = FloatVec::toArray (fvb) == wa;
+        std::cout << "FloatVec::Array round trip is " << (fv_exact ? "exact" : "NOT EXACT") << std::endl;
+        mismatches += fv_exact ? 0 : 1;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::remove (txtpath.c_str());
+    std::remove (binpath.c_str());
+
+    return mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Predicates and thresholding over a large vVector: the scalar loops that testvVector.cpp's
+ * "ALL elements" comparisons and hand-written thresholding code use, against the bitmask
+ * comparisons and early-exit queries of compare_ops.h, first against a scalar and then
+ * elementwise against a second vVector. Every cc::cmp answer is checked against the
+ * scalar version it's timed against.
+ */
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <chrono>
+#include <morph/vVector.h>
+#include "compare_ops.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+const size_t n_elements = 10000000;
+const int reps = 50;
+
+void report (const std::string& op, const std::string& what, steady_clock::duration d, size_t result)
+{
+    std::cout << op << " took " << duration_cast<milliseconds>(d).count() << " ms with " << what
+              << " (" << result << ")" << std::endl;
+}
+
+// got should equal want, the answer of the scalar version
+void check (const std::string& what, size_t got, size_t want)
+{
+    if (got == want) {
+        std::cout << "  " << what << " matches the scalar loop" << std::endl;
+    } else {
+        ++cc::bench::failures;
+        std::cout << "  " << what << " is WRONG: " << got << " where the scalar loop gives " << want << std::endl;
+    }
+}
+
+// Every element of got should equal want's
+void check (const std::string& what, const morph::vVector<F>& got, const morph::vVector<F>& want)
+{
+    std::cout << "  " << what << ": " << cc::bench::check (got.data(), got.size(), [&](size_t i) { return double(want[i]); }, 0) << std::endl;
+}
+
+int main()
+{
+    morph::vVector<F> a(n_elements), out(n_elements);
+    a.randomize(); // in [0, 1)
+    // One element above 1, three quarters of the way through, for "any" and "first"
+    const size_t hit = 3 * n_elements / 4;
+    a[hit] = F{2};
+    cc::bitmask m;
+    size_t result = 0, want = 0;
+
+    steady_clock::time_point start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += (a < F{3}) ? 1 : 0; }
+    report ("All less than", "vVector::operator<", steady_clock::now() - start, result);
+    want = result;
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += cc::cmp::all (a, cc::cmp::lt, F{3}) ? 1 : 0; }
+    report ("All less than", "cc::cmp::all", steady_clock::now() - start, result);
+    check ("cc::cmp::all", result, want);
+    check ("cc::cmp::all, false", cc::cmp::all (a, cc::cmp::lt, F{1}), std::all_of (a.begin(), a.end(), [](F x) { return x < F{1}; }));
+    check ("cc::cmp::any", cc::cmp::any (a, cc::cmp::gt, F{1}), std::any_of (a.begin(), a.end(), [](F x) { return x > F{1}; }));
+    check ("cc::cmp::any, false", cc::cmp::any (a, cc::cmp::gt, F{3}), std::any_of (a.begin(), a.end(), [](F x) { return x > F{3}; }));
+
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += std::find_if (a.begin(), a.end(), [](F x) { return x > F{1}; }) - a.begin(); }
+    report ("First greater than", "std::find_if", steady_clock::now() - start, result / reps);
+    want = result;
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += cc::cmp::first (a, cc::cmp::gt, F{1}); }
+    report ("First greater than", "cc::cmp::first", steady_clock::now() - start, result / reps);
+    check ("cc::cmp::first", result, want);
+    check ("cc::cmp::first, none", cc::cmp::first (a, cc::cmp::gt, F{3}), a.size());
+
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        // The barrier stops the compiler interchanging this loop with count_if's and counting over reps
+        __asm__ __volatile__ ("" : : "r"(a.data()) : "memory");
+        result += std::count_if (a.begin(), a.end(), [](F x) { return x > F{0.5}; });
+    }
+    report ("Count greater than", "std::count_if", steady_clock::now() - start, result / reps);
+    want = result;
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += cc::cmp::count (a, cc::cmp::gt, F{0.5}); }
+    report ("Count greater than", "cc::cmp::count", steady_clock::now() - start, result / reps);
+    check ("cc::cmp::count", result, want);
+
+    // Threshold: zero everything at or below 0.5
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        for (size_t i = 0; i < n_elements; ++i) {
+            if (a[i] > F{0.5}) { out[i] = a[i]; } else { out[i] = F{0}; }
+        }
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("Threshold", "a scalar loop", steady_clock::now() - start, static_cast<size_t>(out.sum()));
+    const morph::vVector<F> thresholded = out;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        cc::cmp::compare (a, cc::cmp::gt, F{0.5}, m);
+        cc::cmp::where (m, a, F{0}, out);
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("Threshold", "cc::cmp::compare and cc::cmp::where", steady_clock::now() - start, static_cast<size_t>(out.sum()));
+    check ("cc::cmp::compare and cc::cmp::where", out, thresholded);
+    check ("cc::bitmask::count", m.count(), static_cast<size_t>(std::count_if (a.begin(), a.end(), [](F x) { return x > F{0.5}; })));
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        cc::cmp::where (a, cc::cmp::gt, F{0.5}, F{0}, out);
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("Threshold", "cc::cmp::where (fused)", steady_clock::now() - start, static_cast<size_t>(out.sum()));
+    check ("cc::cmp::where (fused)", out, thresholded);
+
+    // Against a second vVector: b is above a everywhere but at hit, and c is independent of a
+    morph::vVector<F> b(n_elements), c(n_elements);
+    c.randomize();
+    for (size_t i = 0; i < n_elements; ++i) { b[i] = a[i] + F{0.25}; }
+    b[hit] = F{0};
+    auto less = [](F x, F y) { return x < y; };
+    auto greater = [](F x, F y) { return x > y; };
+
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += std::equal (a.begin(), a.begin() + hit, b.begin(), less) ? 1 : 0; }
+    report ("All less than a vVector", "std::equal", steady_clock::now() - start, result);
+    want = result;
+    const morph::vVector<F> a_head (a.begin(), a.begin() + hit), b_head (b.begin(), b.begin() + hit);
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += cc::cmp::all (a_head, cc::cmp::lt, b_head) ? 1 : 0; }
+    report ("All less than a vVector", "cc::cmp::all", steady_clock::now() - start, result);
+    check ("cc::cmp::all, vVector", result, want);
+    check ("cc::cmp::all, vVector, false", cc::cmp::all (a, cc::cmp::lt, b), std::equal (a.begin(), a.end(), b.begin(), less));
+    check ("cc::cmp::any, vVector", cc::cmp::any (a, cc::cmp::gt, b), !std::equal (a.begin(), a.end(), b.begin(), std::not_fn (greater)));
+    check ("cc::cmp::any, vVector, false", cc::cmp::any (a_head, cc::cmp::ge, b_head),
+           !std::equal (a_head.begin(), a_head.end(), b_head.begin(), less));
+
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += std::mismatch (a.begin(), a.end(), b.begin(), std::not_fn (greater)).first - a.begin(); }
+    report ("First greater than a vVector", "std::mismatch", steady_clock::now() - start, result / reps);
+    want = result;
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += cc::cmp::first (a, cc::cmp::gt, b); }
+    report ("First greater than a vVector", "cc::cmp::first", steady_clock::now() - start, result / reps);
+    check ("cc::cmp::first, vVector", result, want);
+
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        __asm__ __volatile__ ("" : : "r"(a.data()) : "memory");
+        result += std::inner_product (a.begin(), a.end(), c.begin(), size_t{0}, std::plus<size_t>(), greater);
+    }
+    report ("Count greater than a vVector", "std::inner_product", steady_clock::now() - start, result / reps);
+    want = result;
+    result = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { result += cc::cmp::count (a, cc::cmp::gt, c); }
+    report ("Count greater than a vVector", "cc::cmp::count", steady_clock::now() - start, result / reps);
+    check ("cc::cmp::count, vVector", result, want);
+
+    // Elementwise max, as a select of a over c
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        std::transform (a.begin(), a.end(), c.begin(), out.begin(), [](F x, F y) { return x > y ? x : y; });
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("Elementwise max", "std::transform", steady_clock::now() - start, static_cast<size_t>(out.sum()));
+    const morph::vVector<F> maxed = out;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        cc::cmp::compare (a, cc::cmp::gt, c, m);
+        cc::cmp::where (m, a, c, out);
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("Elementwise max", "cc::cmp::compare and cc::cmp::where", steady_clock::now() - start, static_cast<size_t>(out.sum()));
+    check ("cc::cmp::compare and cc::cmp::where, vVector", out, maxed);
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        cc::cmp::where (a, cc::cmp::gt, c, c, out);
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("Elementwise max", "cc::cmp::where (fused)", steady_clock::now() - start, static_cast<size_t>(out.sum()));
+    check ("cc::cmp::where (fused), vVector", out, maxed);
+
+    return cc::bench::failures > 0 ? 1 : 0;
+}
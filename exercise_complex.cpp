@@ -0,0 +1,132 @@
+/*
+ * Complex vectors: std::complex loops over a vVector<std::complex<float>> (what our signal
+ * processing stage does now), Eigen::ArrayXcf, and cc::cplx on the interleaved and split
+ * layouts, for multiply, conjugate, magnitude and phase, plus the cost of converting
+ * between the two layouts. Each cc::cplx kernel, on each layout, is then checked against
+ * std::complex<double>.
+ */
+
+#include <iostream>
+#include <string>
+#include <complex>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <morph/vVector.h>
+#include "complex_ops.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+typedef std::complex<F> C;
+typedef Eigen::Array<C, Eigen::Dynamic, 1> EigenCVec;
+
+const size_t n_elements = 1000000;
+const int reps = 100;
+
+typedef std::complex<double> D;
+const double eps = std::numeric_limits<F>::epsilon();
+
+// |got - ref| / |ref|, or 0 if both are 0
+double rel_err (D got, D ref) { return got == ref ? 0.0 : std::abs (got - ref) / std::abs (ref); }
+
+// Check that err(i), a kernel's error at element i, is at most tol for every element
+template <typename Err>
+void check (const std::string& what, Err err, double tol)
+{
+    double worst = 0.0;
+    size_t worst_i = 0;
+    for (size_t i = 0; i < n_elements; ++i) {
+        const double e = err (i);
+        if (!(e <= worst)) {
+            worst = e;
+            worst_i = i;
+        }
+    }
+    if (worst <= tol) {
+        std::cout << what << " is within " << worst << " of std::complex<double>" << std::endl;
+    } else {
+        ++cc::bench::failures;
+        std::cout << what << " is WRONG: " << worst << " from std::complex<double> at element " << worst_i << " (tolerance " << tol << ")" << std::endl;
+    }
+}
+
+int main()
+{
+    morph::vVector<F> re(n_elements), im(n_elements);
+    re.randomize (F{-1}, F{1});
+    im.randomize (F{-2}, F{2});
+    morph::vVector<C> a(n_elements), b(n_elements), c(n_elements);
+    for (size_t i = 0; i < n_elements; ++i) {
+        a[i] = C(re[i], im[(i * 31) % n_elements]);
+        b[i] = C(im[(i * 7) % n_elements], re[(i * 13) % n_elements]);
+    }
+    EigenCVec ea = Eigen::Map<EigenCVec> (a.data(), n_elements), eb = Eigen::Map<EigenCVec> (b.data(), n_elements), ec(n_elements);
+    Eigen::ArrayXf er(n_elements);
+    cc::split_complex<F> sa, sb, sc;
+    cc::cplx::to_split (a, sa);
+    cc::cplx::to_split (b, sb);
+    morph::vVector<F> r(n_elements);
+
+    cc::bench::time_op (reps, "Complex mult", "std::complex", c.data(), [&]() { for (size_t i = 0; i < n_elements; ++i) { c[i] = a[i] * b[i]; } });
+    cc::bench::time_op (reps, "Complex mult", "Eigen", ec.data(), [&]() { ec = ea * eb; });
+    cc::bench::time_op (reps, "Complex mult", "cc::cplx interleaved", c.data(), [&]() { cc::cplx::mult (a, b, c); });
+    cc::bench::time_op (reps, "Complex mult", "cc::cplx split", sc.re.data(), [&]() { cc::cplx::mult (sa, sb, sc); });
+
+    cc::bench::time_op (reps, "Conjugate", "std::complex", c.data(), [&]() { for (size_t i = 0; i < n_elements; ++i) { c[i] = std::conj (a[i]); } });
+    cc::bench::time_op (reps, "Conjugate", "Eigen", ec.data(), [&]() { ec = ea.conjugate(); });
+    cc::bench::time_op (reps, "Conjugate", "cc::cplx interleaved", c.data(), [&]() { cc::cplx::conj (a, c); });
+    cc::bench::time_op (reps, "Conjugate", "cc::cplx split", sc.im.data(), [&]() { cc::cplx::conj (sa, sc); });
+
+    cc::bench::time_op (reps, "Magnitude", "std::abs", r.data(), [&]() { for (size_t i = 0; i < n_elements; ++i) { r[i] = std::abs (a[i]); } });
+    cc::bench::time_op (reps, "Magnitude", "Eigen", er.data(), [&]() { er = ea.abs(); });
+    cc::bench::time_op (reps, "Magnitude", "cc::cplx interleaved", r.data(), [&]() { cc::cplx::abs (a, r); });
+    cc::bench::time_op (reps, "Magnitude", "cc::cplx split", r.data(), [&]() { cc::cplx::abs (sa, r); });
+
+    cc::bench::time_op (reps, "Phase", "std::arg", r.data(), [&]() { for (size_t i = 0; i < n_elements; ++i) { r[i] = std::arg (a[i]); } });
+    cc::bench::time_op (reps, "Phase", "Eigen", er.data(), [&]() { er = ea.arg(); });
+    cc::bench::time_op (reps, "Phase", "cc::cplx interleaved", r.data(), [&]() { cc::cplx::arg (a, r); });
+    cc::bench::time_op (reps, "Phase", "cc::cplx split", r.data(), [&]() { cc::cplx::arg (sa, r); });
+
+    cc::bench::time_op (reps, "Layout conversion", "a loop, interleaved to split", sc.re.data(), [&]() {
+        for (size_t i = 0; i < n_elements; ++i) { sc.re[i] = a[i].real(); sc.im[i] = a[i].imag(); }
+    });
+    cc::bench::time_op (reps, "Layout conversion", "cc::cplx, interleaved to split", sc.re.data(), [&]() { cc::cplx::to_split (a, sc); });
+    cc::bench::time_op (reps, "Layout conversion", "cc::cplx, split to interleaved", c.data(), [&]() { cc::cplx::to_interleaved (sa, c); });
+
+    // Every kernel on both layouts, against a double reference. mult, norm and abs are
+    // relative errors, arg an absolute one; conj and the layout conversions must be exact.
+    auto ad = [&](size_t i) { return D(a[i]); };
+    auto bd = [&](size_t i) { return D(b[i]); };
+    cc::cplx::mult (a, b, c);
+    check ("cc::cplx::mult, interleaved", [&](size_t i) { return rel_err (D(c[i]), ad (i) * bd (i)); }, 4 * eps);
+    cc::cplx::mult (sa, sb, sc);
+    check ("cc::cplx::mult, split", [&](size_t i) { return rel_err (D(sc[i]), ad (i) * bd (i)); }, 4 * eps);
+    cc::cplx::conj (a, c);
+    check ("cc::cplx::conj, interleaved", [&](size_t i) { return rel_err (D(c[i]), std::conj (ad (i))); }, 0.0);
+    cc::cplx::conj (sa, sc);
+    check ("cc::cplx::conj, split", [&](size_t i) { return rel_err (D(sc[i]), std::conj (ad (i))); }, 0.0);
+    cc::cplx::norm (a, r);
+    check ("cc::cplx::norm, interleaved", [&](size_t i) { return rel_err (r[i], std::norm (ad (i))); }, 2 * eps);
+    cc::cplx::norm (sa, r);
+    check ("cc::cplx::norm, split", [&](size_t i) { return rel_err (r[i], std::norm (ad (i))); }, 2 * eps);
+    cc::cplx::abs (a, r);
+    check ("cc::cplx::abs, interleaved", [&](size_t i) { return rel_err (r[i], std::abs (ad (i))); }, 2 * eps);
+    cc::cplx::abs (sa, r);
+    check ("cc::cplx::abs, split", [&](size_t i) { return rel_err (r[i], std::abs (ad (i))); }, 2 * eps);
+    cc::cplx::arg (a, r);
+    check ("cc::cplx::arg, interleaved", [&](size_t i) { return std::abs (r[i] - std::arg (ad (i))); }, 4 * eps);
+    cc::cplx::arg (sa, r);
+    check ("cc::cplx::arg, split", [&](size_t i) { return std::abs (r[i] - std::arg (ad (i))); }, 4 * eps);
+    cc::cplx::to_split (a, sc);
+    check ("cc::cplx::to_split", [&](size_t i) { return rel_err (D(sc[i]), ad (i)); }, 0.0);
+    cc::cplx::to_interleaved (sa, c);
+    check ("cc::cplx::to_interleaved", [&](size_t i) { return rel_err (D(c[i]), ad (i)); }, 0.0);
+
+    return cc::bench::failures > 0 ? 1 : 0;
+}
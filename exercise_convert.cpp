@@ -0,0 +1,61 @@
+/*
+ * Time float <-> double conversion of a big vVector: vVector::as_double()/as_float(),
+ * which return a new vVector, against cc::as_double()/cc::as_float(), which convert with
+ * SIMD into a destination vVector that is re-used for every iteration.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <morph/vVector.h>
+#include "precision_convert.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How long are the vectors? Mixed precision solvers convert tens of millions of elements.
+const size_t veclen = 20000000;
+// How many conversions?
+const int reps = 50;
+
+int main()
+{
+    morph::vVector<float> f(veclen);
+    f.randomize();
+    morph::vVector<double> d(veclen);
+    d.randomize();
+
+    steady_clock::time_point start;
+    steady_clock::duration sincestart;
+
+    // float -> double
+    morph::vVector<double> dd;
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { dd = f.as_double(); }
+    sincestart = steady_clock::now() - start;
+    std::cout << "as_double took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector::as_double()" << std::endl;
+
+    morph::vVector<double> dd2(veclen);
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { cc::as_double (f, dd2); }
+    sincestart = steady_clock::now() - start;
+    std::cout << "as_double took " << duration_cast<milliseconds>(sincestart).count() << " ms with cc::as_double()" << std::endl;
+
+    // double -> float
+    morph::vVector<float> ff;
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { ff = d.as_float(); }
+    sincestart = steady_clock::now() - start;
+    std::cout << "as_float took " << duration_cast<milliseconds>(sincestart).count() << " ms with vVector::as_float()" << std::endl;
+
+    morph::vVector<float> ff2(veclen);
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { cc::as_float (d, ff2); }
+    sincestart = steady_clock::now() - start;
+    std::cout << "as_float took " << duration_cast<milliseconds>(sincestart).count() << " ms with cc::as_float()" << std::endl;
+
+    // Both routes must give identical results
+    bool same = (dd == dd2) && (ff == ff2);
+    std::cout << "Results " << (same ? "match" : "DO NOT MATCH") << std::endl;
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/*
+ * Compile-time length kernels (cc::fixed) against runtime length loops, at lengths from
+ * morph::Vector sizes up to the 8192 of exerciseEigen.cpp and the 8*INTR_BLOCKS of
+ * avx2_vVector.cpp. For each length: vVector's own op, a generic loop with the length
+ * only known at run time, the runtime-dispatched cc::fixed op and a direct call to the
+ * compile-time specialisation. After the timings, every output of cc::fixed's scale, mult
+ * and div (dispatched, in place and direct) is checked exactly against a[i] * s, a[i] * b[i]
+ * and a[i] / b[i], and the exit status is nonzero if any element differs.
+ */
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#define USE_ALIGNED_ALLOCATOR 1
+#include <morph/vVector.h>
+#include "fixed_kernels.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+// About this many elements are processed for each measurement
+const size_t work = 200000000;
+
+// The generic loop, kept out of line so that the compiler can't see n at the call site
+template <typename T>
+__attribute__((noinline)) void generic_mult (const T* a, const T* b, T* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) { out[i] = a[i] * b[i]; }
+}
+
+void report (const std::string& what, size_t n, steady_clock::duration d, size_t reps)
+{
+    double ns_per_elem = duration_cast<nanoseconds>(d).count() / static_cast<double>(n * reps);
+    std::cout << "  Vector mult took " << duration_cast<milliseconds>(d).count() << " ms ("
+              << ns_per_elem << " ns/element) with " << what << std::endl;
+}
+
+void verify (const std::string& what, const cc::bench::result& r)
+{
+    std::cout << "  " << what << ": " << r << std::endl;
+}
+
+template <size_t N>
+void run()
+{
+    morph::vVector<F> a(N), b(N), out(N);
+    a.randomize();
+    b.randomize();
+    const size_t reps = work / N;
+    std::cout << "Length " << N << " (" << reps << " reps):" << std::endl;
+
+    steady_clock::time_point start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        out = a * b;
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("vVector::operator*", N, steady_clock::now() - start, reps);
+
+    start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        generic_mult (a.data(), b.data(), out.data(), a.size());
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("runtime length loop", N, steady_clock::now() - start, reps);
+
+    start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        cc::fixed::mult (a, b, out);
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("cc::fixed::mult (dispatched)", N, steady_clock::now() - start, reps);
+
+    start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        cc::fixed::mult<N> (a.data(), b.data(), out.data());
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("cc::fixed::mult<N>", N, steady_clock::now() - start, reps);
+
+    // Every kernel must give exactly the single rounding of the double product or quotient
+    const F s = F{3.7};
+    auto prod = [&](size_t i) { return double(a[i]) * b[i]; };
+    auto quot = [&](size_t i) { return double(a[i]) / b[i]; };
+    auto scaled = [&](size_t i) { return double(a[i]) * s; };
+
+    out.zero();
+    cc::fixed::mult (a, b, out);
+    verify ("cc::fixed::mult (dispatched)", cc::bench::check (out.data(), N, prod, 0));
+    out.zero();
+    cc::fixed::mult<N> (a.data(), b.data(), out.data());
+    verify ("cc::fixed::mult<N>", cc::bench::check (out.data(), N, prod, 0));
+    out.zero();
+    cc::fixed::div (a, b, out);
+    verify ("cc::fixed::div (dispatched)", cc::bench::check (out.data(), N, quot, 0));
+    out.zero();
+    cc::fixed::div<N> (a.data(), b.data(), out.data());
+    verify ("cc::fixed::div<N>", cc::bench::check (out.data(), N, quot, 0));
+    out.zero();
+    cc::fixed::scale (a, s, out);
+    verify ("cc::fixed::scale (dispatched)", cc::bench::check (out.data(), N, scaled, 0));
+    out.zero();
+    cc::fixed::scale<N> (a.data(), s, out.data());
+    verify ("cc::fixed::scale<N>", cc::bench::check (out.data(), N, scaled, 0));
+
+    // In place calls must take the generic loop and still give the same answers
+    morph::vVector<F> a0 = a;
+    cc::fixed::mult (a, b, a);
+    verify ("cc::fixed::mult (in place)", cc::bench::check (a.data(), N, [&](size_t i) { return double(a0[i]) * b[i]; }, 0));
+    a = a0;
+    cc::fixed::scale (a, s, a);
+    verify ("cc::fixed::scale (in place)", cc::bench::check (a.data(), N, [&](size_t i) { return double(a0[i]) * s; }, 0));
+}
+
+int main()
+{
+    run<8>();
+    run<64>();
+    run<1024>();
+    run<8192>();
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Indexed access: gathers and scatter-adds through index vectors, as our mesh code reads
+ * and accumulates its fields, with scalar operator[] loops against cc::indexed. The same
+ * kernels run on random and sorted index sets, then on a 2-D grid mesh (each node reading
+ * its four neighbours) numbered row by row, numbered at random, and renumbered from the
+ * random numbering by Hilbert curve and by first touch, to show what the ordering is worth.
+ * Every gather, scatter, scatter-add and renumbering is checked against a scalar loop.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <morph/vVector.h>
+#include "indexed_ops.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+typedef morph::vVector<uint32_t> Idx;
+
+const int reps = 10;
+
+// Check that out holds one of the values scattered to each index in idx, and its initial value elsewhere
+void check_scatter (const std::string& what, const morph::vVector<F>& out, const morph::vVector<F>& init,
+                    const morph::vVector<F>& vals, const Idx& idx)
+{
+    // 0: not scattered to, 1: scattered to but no match yet, 2: holds one of the values scattered to it
+    std::vector<unsigned char> state (out.size(), 0);
+    for (size_t k = 0; k < idx.size(); ++k) {
+        unsigned char& st = state[idx[k]];
+        if (st == 0) { st = 1; }
+        if (out[idx[k]] == vals[k]) { st = 2; }
+    }
+    size_t wrong = 0;
+    for (size_t j = 0; j < out.size(); ++j) {
+        if (state[j] == 1 || (state[j] == 0 && out[j] != init[j])) { ++wrong; }
+    }
+    if (wrong > 0) { ++cc::bench::failures; }
+    std::cout << "  " << what << (wrong == 0 ? " matches the scalar loop" : " is WRONG at " + std::to_string (wrong) + " elements") << std::endl;
+}
+
+// Check acc against the scalar loop's sums in double. Adds in a different order can differ by
+// an ulp of the running total for each add, so the tolerance scales with the number of adds
+// and the sum of the magnitudes added.
+void check_scatter_add (const std::string& what, const morph::vVector<F>& acc, const morph::vVector<F>& vals, const Idx& idx)
+{
+    std::vector<double> ref (acc.size(), 0.0), mag (acc.size(), 0.0);
+    std::vector<size_t> count (acc.size(), 0);
+    for (size_t k = 0; k < idx.size(); ++k) {
+        ref[idx[k]] += vals[k];
+        mag[idx[k]] += std::abs (vals[k]);
+        ++count[idx[k]];
+    }
+    double worst = 0.0;
+    for (size_t j = 0; j < acc.size(); ++j) {
+        const double tol = static_cast<double>(count[j]) * std::numeric_limits<F>::epsilon() * mag[j];
+        const double err = std::abs (acc[j] - ref[j]);
+        if (err > 0.0) { worst = std::max (worst, tol > 0.0 ? err / tol : std::numeric_limits<double>::infinity()); }
+    }
+    if (worst > 1.0) { ++cc::bench::failures; }
+    std::cout << "  " << what << (worst <= 1.0 ? " is within " : " is WRONG: ") << worst << " of its tolerance from the scalar loop" << std::endl;
+}
+
+void run_gathers (const std::string& pattern, const morph::vVector<F>& src, const Idx& idx)
+{
+    morph::vVector<F> out(idx.size()), acc(src.size());
+    morph::vVector<F> vals(idx.size());
+    vals.randomize();
+    cc::bench::time_op (reps, "Gather (" + pattern + ")", "operator[]", out.data(), [&]() {
+        for (size_t k = 0; k < idx.size(); ++k) { out[k] = src[idx[k]]; }
+    });
+    cc::bench::time_op (reps, "Gather (" + pattern + ")", "cc::indexed", out.data(), [&]() { cc::indexed::gather (src, idx, out); });
+    cc::bench::time_op (reps, "Scatter-add (" + pattern + ")", "operator[]", acc.data(), [&]() {
+        for (size_t k = 0; k < idx.size(); ++k) { acc[idx[k]] += vals[k]; }
+    });
+    cc::bench::time_op (reps, "Scatter-add (" + pattern + ")", "cc::indexed", acc.data(), [&]() { cc::indexed::scatter_add (vals, idx, acc); });
+#if defined(__AVX512CD__)
+    cc::indexed::vector_scatter_add = true;
+    cc::bench::time_op (reps, "Scatter-add (" + pattern + ")", "cc::indexed and vpconflict", acc.data(), [&]() { cc::indexed::scatter_add (vals, idx, acc); });
+    cc::indexed::vector_scatter_add = false;
+#endif
+
+    cc::indexed::gather (src, idx, out);
+    std::cout << "  cc::indexed::gather: " << cc::bench::check (out.data(), out.size(), [&](size_t k) { return double(src[idx[k]]); }, 0) << std::endl;
+
+    morph::vVector<F> scattered = src;
+    cc::indexed::scatter (vals, idx, scattered);
+    check_scatter ("cc::indexed::scatter", scattered, src, vals, idx);
+
+    acc.zero();
+    cc::indexed::scatter_add (vals, idx, acc);
+    check_scatter_add ("cc::indexed::scatter_add", acc, vals, idx);
+#if defined(__AVX512CD__)
+    cc::indexed::vector_scatter_add = true;
+    acc.zero();
+    cc::indexed::scatter_add (vals, idx, acc);
+    check_scatter_add ("cc::indexed::scatter_add with vpconflict", acc, vals, idx);
+    cc::indexed::vector_scatter_add = false;
+#endif
+}
+
+// Each node of an nx by ny grid reads its four neighbours (clamped at the edges). label[j]
+// is the number of the node at grid position j, and the coordinates follow the numbering.
+void mesh (size_t nx, size_t ny, const Idx& label, Idx& nb, morph::vVector<F>& x, morph::vVector<F>& y)
+{
+    const size_t n = nx * ny;
+    nb.resize (4 * n);
+    x.resize (n);
+    y.resize (n);
+    for (size_t j = 0; j < n; ++j) {
+        const size_t gx = j % nx, gy = j / nx;
+        const size_t node = label[j];
+        x[node] = static_cast<F>(gx);
+        y[node] = static_cast<F>(gy);
+        nb[4 * node] = label[gy * nx + (gx > 0 ? gx - 1 : gx)];
+        nb[4 * node + 1] = label[gy * nx + (gx + 1 < nx ? gx + 1 : gx)];
+        nb[4 * node + 2] = label[(gy > 0 ? gy - 1 : gy) * nx + gx];
+        nb[4 * node + 3] = label[(gy + 1 < ny ? gy + 1 : gy) * nx + gx];
+    }
+}
+
+// Renumber the mesh by the permutation p (new node i is old node p[i], q its inverse): the
+// neighbour numbers change, and each node's row of four moves with the node
+void renumber_mesh (const Idx& nb, const Idx& p, const Idx& q, Idx& out)
+{
+    Idx moved(nb.size());
+    for (size_t i = 0; i < p.size(); ++i) {
+        for (size_t c = 0; c < 4; ++c) { moved[4 * i + c] = nb[4 * p[i] + c]; }
+    }
+    cc::indexed::renumber (moved, q);
+    out.swap (moved);
+}
+
+// Check that p is a permutation with inverse q, and that the renumbered mesh nb2 with the
+// permuted field f2 reads the same neighbour values, node for node, as nb does from f
+void check_renumbering (const std::string& what, const Idx& nb, const morph::vVector<F>& f,
+                        const Idx& p, const Idx& q, const Idx& nb2, const morph::vVector<F>& f2)
+{
+    size_t wrong = 0;
+    std::vector<unsigned char> seen (p.size(), 0);
+    for (size_t i = 0; i < p.size(); ++i) {
+        if (p[i] >= p.size() || seen[p[i]] || q[p[i]] != i) { ++wrong; continue; }
+        seen[p[i]] = 1;
+        for (size_t c = 0; c < 4; ++c) {
+            if (f2[i] != f[p[i]] || f2[nb2[4 * i + c]] != f[nb[4 * p[i] + c]]) { ++wrong; }
+        }
+    }
+    if (wrong > 0) { ++cc::bench::failures; }
+    std::cout << what << (wrong == 0 ? " matches the scalar loop" : " is WRONG at " + std::to_string (wrong) + " nodes") << std::endl;
+}
+
+int main()
+{
+    const size_t n = size_t{1} << 24;
+    morph::vVector<F> src(n);
+    src.randomize();
+    std::mt19937 rng(42);
+
+    // Random indices, then the same indices sorted
+    Idx idx(n);
+    for (auto& k : idx) { k = static_cast<uint32_t>(rng() % n); }
+    cc::indexed::check (idx, n);
+    run_gathers ("random", src, idx);
+    std::sort (idx.begin(), idx.end());
+    run_gathers ("sorted", src, idx);
+
+    // A few far apart targets, each repeated many times within every register
+    for (auto& k : idx) { k = static_cast<uint32_t>((rng() % 8) * (n / 8)); }
+    run_gathers ("8 targets, repeated", src, idx);
+
+    // A grid mesh, numbered four ways
+    const size_t nx = 2048, ny = 2048, nn = nx * ny;
+    Idx label(nn);
+    for (size_t j = 0; j < nn; ++j) { label[j] = static_cast<uint32_t>(j); }
+    Idx nb;
+    morph::vVector<F> x, y, field(nn);
+    field.randomize();
+    mesh (nx, ny, label, nb, x, y);
+    run_gathers ("mesh, numbered by rows", field, nb);
+
+    std::shuffle (label.begin(), label.end(), rng);
+    mesh (nx, ny, label, nb, x, y);
+    run_gathers ("mesh, numbered at random", field, nb);
+
+    Idx p, q;
+    morph::vVector<F> field2;
+    steady_clock::time_point start = steady_clock::now();
+    cc::indexed::hilbert_order (x, y, p);
+    cc::indexed::inverse (p, q);
+    Idx nb_h;
+    renumber_mesh (nb, p, q, nb_h);
+    cc::indexed::permute (field, p, field2);
+    std::cout << "Hilbert renumbering took " << duration_cast<milliseconds>(steady_clock::now() - start).count() << " ms" << std::endl;
+    check_renumbering ("Hilbert renumbering", nb, field, p, q, nb_h, field2);
+    run_gathers ("mesh, Hilbert order", field2, nb_h);
+
+    start = steady_clock::now();
+    cc::indexed::first_touch_order (nb, nn, p);
+    cc::indexed::inverse (p, q);
+    Idx nb_f;
+    renumber_mesh (nb, p, q, nb_f);
+    cc::indexed::permute (field, p, field2);
+    std::cout << "First touch renumbering took " << duration_cast<milliseconds>(steady_clock::now() - start).count() << " ms" << std::endl;
+    check_renumbering ("First touch renumbering", nb, field, p, q, nb_f, field2);
+    run_gathers ("mesh, first touch order", field2, nb_f);
+
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * The exercise.cpp ops (scalar mult, vector mult, vector div, pow) run with fp32, fp16 and
+ * bf16 storage. Computation is always in fp32; only the storage precision changes. For
+ * each storage type, report the time, the effective memory bandwidth and the accuracy
+ * lost relative to a double precision reference.
+ *
+ * The maximum relative error must stay within what the storage format allows: one
+ * rounding of the result to the format's unit roundoff u (2^-24 for fp32, 2^-11 for fp16,
+ * 2^-8 for bf16), plus u for each input that was itself rounded to the format on the way
+ * in, plus a little for the fp32 arithmetic. The exit status is nonzero if any op's error
+ * exceeds its bound.
+ *
+ * Build exercise_halfprec for the AVX2/F16C kernels and exercise_halfprec512 for the
+ * AVX-512 ones.
+ */
+
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <morph/vVector.h>
+#include "half_storage.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How long are the vectors?
+const size_t veclen = 1000000;
+// How many repeats of each op?
+const int reps = 500;
+
+// How many ops exceeded their error bound
+int failures = 0;
+
+// Unit roundoff (half an ulp at 1) of each storage format: 2^-(significand bits)
+template <typename H> constexpr double unit_roundoff();
+template <> constexpr double unit_roundoff<float>() { return 0x1p-24; }
+template <> constexpr double unit_roundoff<cc::f16>() { return 0x1p-11; }
+template <> constexpr double unit_roundoff<cc::bf16>() { return 0x1p-8; }
+
+/*
+ * Max and mean relative error of r (widened to float) against the double precision
+ * reference, which must be within (n_rounded_inputs + 1) rounding errors in H, plus some
+ * ulps of fp32 for the computation (std::pow's, and rounding to fp32 before H).
+ */
+template <typename H>
+void report_error (const morph::vVector<H>& r, const morph::vVector<double>& ref, int n_rounded_inputs)
+{
+    morph::vVector<float> rf;
+    cc::lowp::convert (r, rf);
+    double maxerr = 0.0;
+    double sumerr = 0.0;
+    for (size_t i = 0; i < ref.size(); ++i) {
+        double e = std::abs ((static_cast<double>(rf[i]) - ref[i]) / ref[i]);
+        if (!(e <= maxerr)) { maxerr = e; } // so that a NaN result shows, and fails
+        sumerr += e;
+    }
+    // k roundings of at most u each, compounded (k^2 u^2 covers the second order terms)
+    const double u = unit_roundoff<H>();
+    const double k = n_rounded_inputs + 1;
+    const double bound = k * u + k * k * u * u + 8 * unit_roundoff<float>();
+    std::cout << "; rel. error max " << maxerr << " mean " << sumerr / ref.size() << " (bound " << bound << ")";
+    if (!(maxerr <= bound)) {
+        ++failures;
+        std::cout << " WRONG: error exceeds the bound";
+    }
+    std::cout << std::endl;
+}
+
+void report_time (const std::string& what, const std::string& storage, steady_clock::duration d, size_t bytes_per_rep)
+{
+    double secs = duration_cast<microseconds>(d).count() / 1e6;
+    std::cout << what << " took " << duration_cast<milliseconds>(d).count() << " ms with " << storage
+              << " storage (" << (static_cast<double>(bytes_per_rep) * reps / 1e9 / secs) << " GB/s)";
+}
+
+template <typename H>
+void run (const std::string& storage, const morph::vVector<float>& af, const morph::vVector<float>& bf)
+{
+    morph::vVector<H> a, b;
+    cc::lowp::convert (af, a);
+    cc::lowp::convert (bf, b);
+    morph::vVector<H> out(veclen);
+    morph::vVector<double> ref(veclen);
+    const size_t sz = sizeof(H) * veclen;
+
+    steady_clock::time_point start;
+    steady_clock::duration sincestart;
+
+    // Scalar mult
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { cc::lowp::scale (a, static_cast<float>(i), out); }
+    sincestart = steady_clock::now() - start;
+    report_time ("Scalar mult", storage, sincestart, 2 * sz);
+    for (size_t j = 0; j < veclen; ++j) { ref[j] = static_cast<double>(af[j]) * (reps - 1); }
+    report_error (out, ref, 1);
+
+    // Vector mult
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { cc::lowp::mult (a, b, out); }
+    sincestart = steady_clock::now() - start;
+    report_time ("Vector mult", storage, sincestart, 3 * sz);
+    for (size_t j = 0; j < veclen; ++j) { ref[j] = static_cast<double>(af[j]) * bf[j]; }
+    report_error (out, ref, 2);
+
+    // Vector div
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { cc::lowp::div (a, b, out); }
+    sincestart = steady_clock::now() - start;
+    report_time ("Vector div", storage, sincestart, 3 * sz);
+    for (size_t j = 0; j < veclen; ++j) { ref[j] = static_cast<double>(af[j]) / bf[j]; }
+    report_error (out, ref, 2);
+
+    // Pow
+    start = steady_clock::now();
+    for (int i = 1; i <= reps; ++i) { cc::lowp::pow (a, 1.0f / i, out); }
+    sincestart = steady_clock::now() - start;
+    report_time ("Raise to scalar power", storage, sincestart, 2 * sz);
+    for (size_t j = 0; j < veclen; ++j) { ref[j] = std::pow (static_cast<double>(af[j]), 1.0 / reps); }
+    // An input's rounding error shrinks by the exponent, 1/reps, so doesn't count
+    report_error (out, ref, 0);
+}
+
+int main()
+{
+#if defined(__AVX512BF16__)
+    // Fail clearly on a host without bf16, rather than with SIGILL part way through
+    if (!__builtin_cpu_supports ("avx512bf16")) {
+        std::cerr << "This build uses AVX512-BF16, which this CPU lacks; run exercise_halfprec512 instead" << std::endl;
+        return 1;
+    }
+#endif
+    // Values in [1,2) so that div and pow are well conditioned
+    morph::vVector<float> af(veclen);
+    morph::vVector<float> bf(veclen);
+    af.randomize (1.0f, 2.0f);
+    bf.randomize (1.0f, 2.0f);
+
+    std::cout << "Kernel width: " << cc::lowp::traits<float>::width << " (fp32), "
+              << cc::lowp::traits<cc::f16>::width << " (fp16), "
+              << cc::lowp::traits<cc::bf16>::width << " (bf16) lanes" << std::endl;
+
+    run<float> ("fp32", af, bf);
+    run<cc::f16> ("fp16", af, bf);
+    run<cc::bf16> ("bf16", af, bf);
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Histograms of a large vVector every 'step', as our analysis code bins simulation output:
+ * the scalar ++counts[bin] loop against cc::hist, for fixed width bins and for arbitrary
+ * edges, over uniform data (from randomize(), as in exercise.cpp) and skewed data (most
+ * elements in the first few bins, which is where the scalar loop stalls).
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <morph/vVector.h>
+#include "histogram.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+const size_t n_elements = 10000000;
+const int reps = 10;
+
+void report (const std::string& op, const std::string& what, steady_clock::duration d, const cc::hist::histogram& h)
+{
+    std::cout << op << " took " << duration_cast<milliseconds>(d).count() / reps << " ms with " << what
+              << " (per step: under " << h.under / reps << ", over " << h.over / reps << ", first bin " << h.counts[0] / reps << ")" << std::endl;
+}
+
+// What we do now
+void scalar_fixed (const morph::vVector<F>& a, F lo, F hi, size_t nbins, cc::hist::histogram& h)
+{
+    if (h.counts.empty()) { h.counts.assign (nbins, 0); }
+    const F scale = static_cast<F>(nbins) / (hi - lo);
+    for (F x : a) {
+        if (!(x >= lo)) { ++h.under; }
+        else if (x > hi) { ++h.over; }
+        else { ++h.counts[std::min (static_cast<size_t>((x - lo) * scale), nbins - 1)]; }
+    }
+}
+void scalar_edges (const morph::vVector<F>& a, const std::vector<F>& e, cc::hist::histogram& h)
+{
+    if (h.counts.empty()) { h.counts.assign (e.size() - 1, 0); }
+    for (F x : a) {
+        if (!(x >= e.front())) { ++h.under; }
+        else if (x > e.back()) { ++h.over; }
+        else { ++h.counts[std::min (static_cast<size_t>(std::upper_bound (e.begin(), e.end(), x) - e.begin()) - 1, e.size() - 2)]; }
+    }
+}
+
+void run (const std::string& data, const morph::vVector<F>& a, size_t nbins)
+{
+    const std::string bins = std::to_string (nbins) + " bins, " + data;
+    // Edges that get finer towards 0, as for a log-ish axis
+    std::vector<F> e (nbins + 1);
+    for (size_t k = 0; k <= nbins; ++k) { e[k] = static_cast<F>(std::pow (static_cast<double>(k) / nbins, 2.0)); }
+
+    cc::hist::histogram hs, hv, es, ev;
+    steady_clock::time_point start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { scalar_fixed (a, F{0}, F{1}, nbins, hs); }
+    report ("Fixed width histogram", "scalar loop, " + bins, steady_clock::now() - start, hs);
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::hist::fixed (a, F{0}, F{1}, nbins, hv); }
+    report ("Fixed width histogram", "cc::hist::fixed, " + bins, steady_clock::now() - start, hv);
+    if (hs.counts != hv.counts || hs.under != hv.under || hs.over != hv.over) {
+        std::cout << "  MISMATCH" << std::endl;
+        ++cc::bench::failures;
+    }
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { scalar_edges (a, e, es); }
+    report ("Edges histogram", "scalar upper_bound, " + bins, steady_clock::now() - start, es);
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::hist::edges (a, e, ev); }
+    report ("Edges histogram", "cc::hist::edges, " + bins, steady_clock::now() - start, ev);
+    if (es.counts != ev.counts || es.under != ev.under || es.over != ev.over) {
+        std::cout << "  MISMATCH" << std::endl;
+        ++cc::bench::failures;
+    }
+}
+
+int main()
+{
+    morph::vVector<F> uniform(n_elements), skewed(n_elements);
+    uniform.randomize();
+    // x^8 piles the values up near 0: 70% of them are in the first of 16 bins
+    for (size_t i = 0; i < n_elements; ++i) { skewed[i] = std::pow (uniform[i], F{8}); }
+
+    for (size_t nbins : { 16, 1000 }) {
+        run ("uniform", uniform, nbins);
+        run ("skewed", skewed, nbins);
+    }
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Integer vVectors, as our quantised pipeline uses them: vVector's own operators and
+ * plain loops (what the pipeline does now) against cc::ints, for add, multiply, saturating
+ * add, elementwise and whole-vector max, sum and dot product, in a section per width from
+ * int8 to int64. The sums and dot products in the element type wrap long before the end of
+ * the vector, so each section also prints what they return next to the widened results.
+ * Every cc::ints result is then checked exactly against a scalar loop in 128 bits.
+ */
+
+#include <iostream>
+#include <string>
+#include <random>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <morph/vVector.h>
+#include "int_ops.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+const size_t n_elements = 1000000;
+const int reps = 100;
+
+// Uniform over all of T's range (vVector::randomize's distributions don't take char types)
+template <typename T>
+void fill (morph::vVector<T>& v, unsigned int seed)
+{
+    std::mt19937_64 g(seed);
+    std::uniform_int_distribution<long long> d(std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+    for (auto& x : v) { x = static_cast<T>(d (g)); }
+}
+
+// Set pairs at both ends of a and b (so both in whole registers and in a scalar tail) to
+// the extremes, where saturation and wrapping go wrong if they're going to
+template <typename T>
+void edges (morph::vVector<T>& a, morph::vVector<T>& b)
+{
+    const T lo = std::numeric_limits<T>::min(), hi = std::numeric_limits<T>::max();
+    const T ea[] = { hi, lo, lo, hi, T{-1}, T{0} };
+    const T eb[] = { hi, lo, hi, lo, lo, lo };
+    for (size_t k = 0; k < 6; ++k) {
+        a[k] = a[n_elements - 1 - k] = ea[k];
+        b[k] = b[n_elements - 1 - k] = eb[k];
+    }
+}
+
+// Check got[i] == want(i) for every element
+template <typename T, typename Want>
+void check (const std::string& what, const morph::vVector<T>& got, Want want)
+{
+    size_t wrong = 0, first = 0;
+    for (size_t i = 0; i < n_elements; ++i) {
+        if (got[i] != want (i)) {
+            if (wrong++ == 0) { first = i; }
+        }
+    }
+    if (wrong == 0) {
+        std::cout << "  " << what << " matches the scalar loop" << std::endl;
+    } else {
+        ++cc::bench::failures;
+        std::cout << "  " << what << " is WRONG at " << wrong << " elements, first at " << first << ": "
+                  << static_cast<long long>(got[first]) << " where " << static_cast<long long>(want (first)) << " was expected" << std::endl;
+    }
+}
+
+// Check a single result exactly. __int128 has no operator<<, so it's printed as a double.
+template <typename R>
+void check (const std::string& what, R got, __int128 want)
+{
+    if (static_cast<__int128>(got) == want) {
+        std::cout << "  " << what << " matches the scalar loop" << std::endl;
+    } else {
+        ++cc::bench::failures;
+        std::cout << "  " << what << " is WRONG: " << static_cast<double>(got) << " where " << static_cast<double>(want) << " was expected" << std::endl;
+    }
+}
+
+template <typename T>
+void section (const std::string& name)
+{
+    std::cout << "-- " << name << " --" << std::endl;
+    morph::vVector<T> a(n_elements), b(n_elements), c(n_elements);
+    fill (a, 1);
+    fill (b, 2);
+    edges (a, b);
+
+    cc::bench::time_op (reps, "Vector add", "vVector", c.data(), [&]() { c = a + b; });
+    cc::bench::time_op (reps, "Vector add", "cc::ints", c.data(), [&]() { cc::ints::add (a, b, c); });
+    cc::bench::time_op (reps, "Vector mult", "vVector", c.data(), [&]() { c = a * b; });
+    cc::bench::time_op (reps, "Vector mult", "cc::ints", c.data(), [&]() { cc::ints::mult (a, b, c); });
+
+    // Saturating add, as the pipeline clamps it now: widen, add and clamp
+    const long long lo = std::numeric_limits<T>::min(), hi = std::numeric_limits<T>::max();
+    cc::bench::time_op (reps, "Saturating add", "a clamping loop", c.data(), [&]() {
+        for (size_t i = 0; i < n_elements; ++i) {
+            if constexpr (sizeof(T) < 8) {
+                c[i] = static_cast<T>(std::clamp (static_cast<long long>(a[i]) + b[i], lo, hi));
+            } else {
+                T s;
+                c[i] = __builtin_add_overflow (a[i], b[i], &s) ? (a[i] < 0 ? static_cast<T>(lo) : static_cast<T>(hi)) : s;
+            }
+        }
+    });
+    cc::bench::time_op (reps, "Saturating add", "cc::ints", c.data(), [&]() { cc::ints::adds (a, b, c); });
+
+    cc::bench::time_op (reps, "Elementwise max", "a loop", c.data(), [&]() {
+        for (size_t i = 0; i < n_elements; ++i) { c[i] = std::max (a[i], b[i]); }
+    });
+    cc::bench::time_op (reps, "Elementwise max", "cc::ints", c.data(), [&]() { cc::ints::max (a, b, c); });
+
+    T m = T{0};
+    cc::bench::time_op (reps, "Vector max", "vVector", &m, [&]() { m = a.max(); });
+    cc::bench::time_op (reps, "Vector max", "cc::ints", &m, [&]() { m = cc::ints::max (a); });
+
+    T s_own = T{0};
+    typename cc::ints::wide<T>::sum_type s_wide = 0;
+    cc::bench::time_op (reps, "Sum", "vVector", &s_own, [&]() { s_own = a.sum(); });
+    cc::bench::time_op (reps, "Sum", "cc::ints", &s_wide, [&]() { s_wide = cc::ints::sum (a); });
+
+    // A full range int64 dot product overflows even __int128 (see int_ops.h), so for int64
+    // take it over elements cut to 52 bits: a million products of those sum to under 2^125
+    morph::vVector<T> da = a, db = b;
+    if constexpr (sizeof(T) == 8) {
+        for (size_t i = 0; i < n_elements; ++i) { da[i] >>= 11; db[i] >>= 11; }
+    }
+    T d_own = T{0};
+    typename cc::ints::wide<T>::dot_type d_wide = 0;
+    cc::bench::time_op (reps, "Dot product", "vVector", &d_own, [&]() { d_own = da.dot (db); });
+    cc::bench::time_op (reps, "Dot product", "cc::ints", &d_wide, [&]() { d_wide = cc::ints::dot (da, db); });
+
+    // __int128 has no operator<<; these are only for comparison by eye
+    std::cout << "  sum is " << static_cast<long long>(s_own) << " from vVector, "
+              << static_cast<double>(s_wide) << " from cc::ints; dot product is "
+              << static_cast<long long>(d_own) << " from vVector, " << static_cast<double>(d_wide) << " from cc::ints" << std::endl;
+
+    // Wrapping results are the low bits of the exact ones; everything else is exact in 128 bits
+    auto wrapped = [](unsigned __int128 x) { return static_cast<T>(static_cast<uint64_t>(x)); };
+    auto clamped = [&](__int128 x) { return static_cast<T>(std::min<__int128> (std::max<__int128> (x, lo), hi)); };
+    auto x = [&](size_t i) { return static_cast<__int128>(a[i]); };
+    auto y = [&](size_t i) { return static_cast<__int128>(b[i]); };
+    cc::ints::add (a, b, c);
+    check ("add", c, [&](size_t i) { return wrapped (x (i) + y (i)); });
+    cc::ints::sub (a, b, c);
+    check ("sub", c, [&](size_t i) { return wrapped (x (i) - y (i)); });
+    cc::ints::mult (a, b, c);
+    check ("mult", c, [&](size_t i) { return wrapped (static_cast<unsigned __int128>(x (i)) * static_cast<unsigned __int128>(y (i))); });
+    cc::ints::adds (a, b, c);
+    check ("adds", c, [&](size_t i) { return clamped (x (i) + y (i)); });
+    cc::ints::subs (a, b, c);
+    check ("subs", c, [&](size_t i) { return clamped (x (i) - y (i)); });
+    cc::ints::min (a, b, c);
+    check ("elementwise min", c, [&](size_t i) { return std::min (a[i], b[i]); });
+    cc::ints::max (a, b, c);
+    check ("elementwise max", c, [&](size_t i) { return std::max (a[i], b[i]); });
+    check ("vector min", cc::ints::min (a), *std::min_element (a.begin(), a.end()));
+    check ("vector max", cc::ints::max (a), *std::max_element (a.begin(), a.end()));
+
+    __int128 s_ref = 0;
+    for (size_t i = 0; i < n_elements; ++i) { s_ref += x (i); }
+    check ("sum", cc::ints::sum (a), s_ref);
+
+    __int128 d_ref = 0;
+    for (size_t i = 0; i < n_elements; ++i) { d_ref += static_cast<__int128>(da[i]) * db[i]; }
+    check ("dot product", d_wide, d_ref);
+}
+
+int main()
+{
+    section<int8_t> ("int8");
+    section<int16_t> ("int16");
+    section<int32_t> ("int32");
+    section<int64_t> ("int64");
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Tail handling against padding. At lengths that aren't a multiple of the SIMD width, a
+ * kernel on an ordinary vVector needs unaligned loads (or a peel loop) and a scalar tail;
+ * on a cc::padded_vVector it runs over the padded length with aligned loads only.
+ *
+ * Built three times: exercise_padded (AVX2, 8 floats per register), exercise_padded512
+ * (AVX-512, 16 floats per register) and exercise_padded_scalar (no AVX, so the kernels'
+ * one element at a time fallback). Every kernel's result is checked in each.
+ */
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <immintrin.h>
+#include <morph/vVector.h>
+#include "padded_vvector.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+// About this many elements are processed for each measurement
+const size_t work = 400000000;
+
+// out = a * b with unaligned vector loads and a scalar tail, as a kernel on an unpadded vVector has to be written
+__attribute__((noinline)) void tail_mult (const F* a, const F* b, F* out, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) { _mm512_storeu_ps (out + i, _mm512_mul_ps (_mm512_loadu_ps (a + i), _mm512_loadu_ps (b + i))); }
+#elif defined(__AVX__)
+    for (; i + 8 <= n; i += 8) { _mm256_storeu_ps (out + i, _mm256_mul_ps (_mm256_loadu_ps (a + i), _mm256_loadu_ps (b + i))); }
+#endif
+    for (; i < n; ++i) { out[i] = a[i] * b[i]; }
+}
+
+void report (const std::string& what, size_t n, steady_clock::duration d, size_t reps)
+{
+    double ns_per_elem = duration_cast<nanoseconds>(d).count() / static_cast<double>(n * reps);
+    std::cout << "  Vector mult took " << duration_cast<milliseconds>(d).count() << " ms ("
+              << ns_per_elem << " ns/element) with " << what << std::endl;
+}
+
+// got should equal want exactly, and its padding should still be zero
+void check (const std::string& what, const cc::padded_vVector<F>& got, const morph::vVector<F>& want)
+{
+    cc::bench::result res = cc::bench::check (got.data(), got.size(), [&](size_t i) { return double(want[i]); }, 0);
+    bool padding_zero = true;
+    for (size_t i = got.size(); i < cc::padded::padded_size (got); ++i) { padding_zero = padding_zero && got.data()[i] == F{0}; }
+    if (!padding_zero) { ++cc::bench::failures; }
+    std::cout << "  " << what << ": " << res << (padding_zero ? "" : ", PADDING NOT ZEROED") << std::endl;
+}
+
+void run (size_t n)
+{
+    morph::vVector<F> a(n), b(n), out(n);
+    a.randomize();
+    b.randomize();
+    cc::padded_vVector<F> pa(n), pb(n), pout(n);
+    for (size_t i = 0; i < n; ++i) { pa[i] = a[i]; pb[i] = b[i]; }
+
+    const size_t reps = work / n > 0 ? work / n : 1;
+    std::cout << "Length " << n << " (padded to " << cc::padded::padded_size (pa) << ", " << reps << " reps):" << std::endl;
+
+    steady_clock::time_point start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        out = a * b;
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("vVector::operator*", n, steady_clock::now() - start, reps);
+
+    start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        tail_mult (a.data(), b.data(), out.data(), n);
+        __asm__ __volatile__ ("" : : "r"(out.data()) : "memory");
+    }
+    report ("unaligned loads and scalar tail", n, steady_clock::now() - start, reps);
+
+    start = steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        cc::padded::mult (pa, pb, pout);
+        __asm__ __volatile__ ("" : : "r"(pout.data()) : "memory");
+    }
+    report ("cc::padded::mult", n, steady_clock::now() - start, reps);
+
+    check ("cc::padded::mult", pout, a * b);
+    cc::padded::scale (pa, F{3}, pout);
+    check ("cc::padded::scale", pout, a * F{3});
+    cc::padded::div (pa, pb, pout);
+    check ("cc::padded::div", pout, a / b);
+}
+
+int main()
+{
+#if defined(__AVX512F__)
+    std::cout << "AVX-512, 16 floats per register" << std::endl;
+#elif defined(__AVX__)
+    std::cout << "AVX2, 8 floats per register" << std::endl;
+#else
+    std::cout << "No AVX, one float at a time" << std::endl;
+#endif
+    run (13);
+    run (100);
+    run (1027);
+    run (8197);
+    run (1000003);
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Cumulative sum, product, max and min over a large vVector: a serial loop, std::inclusive_scan
+ * (serially and, for the sum, where the standard library has a parallel backend, with the
+ * par and par_unseq execution policies) and cc::scan. Every result is checked against the
+ * serial loop's.
+ */
+
+#include <iostream>
+#include <string>
+#include <numeric>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#ifdef CC_HAVE_TBB
+# include <execution>
+#endif
+#include <morph/vVector.h>
+#include "prefix_scan.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+const size_t n_elements = 10000000;
+const int reps = 20;
+
+/*
+ * Time fn, then compare every element of out with ref, the serial loop's result. max and
+ * min must match exactly; sum and product are reassociated by the parallel scans, so may
+ * differ by rel_tol relative to the running value.
+ */
+template <typename Fn>
+void time_scan (const std::string& op, const std::string& what, const morph::vVector<F>& out,
+                const morph::vVector<F>& ref, double rel_tol, Fn fn)
+{
+    steady_clock::time_point start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        fn();
+        cc::bench::do_not_optimize (out.data());
+        cc::bench::clobber_memory();
+    }
+    steady_clock::duration d = steady_clock::now() - start;
+    double worst = 0.0;
+    size_t worst_i = 0;
+    for (size_t i = 0; i < out.size(); ++i) {
+        const double diff = std::abs (double(out[i]) - double(ref[i]));
+        const double rel = diff == 0.0 ? 0.0 : diff / std::abs (double(ref[i]));
+        if (!(rel <= worst)) {
+            worst = rel;
+            worst_i = i;
+        }
+    }
+    const bool ok = worst <= rel_tol;
+    if (!ok) { ++cc::bench::failures; }
+    std::cout << op << " took " << duration_cast<milliseconds>(d).count() << " ms with " << what << " (";
+    if (ok) {
+        std::cout << "max rel. difference " << worst << " from the serial loop)" << std::endl;
+    } else {
+        std::cout << "WRONG: rel. difference " << worst << " from the serial loop at element " << worst_i << ")" << std::endl;
+    }
+}
+
+/*
+ * std_par says whether to time the parallel std::inclusive_scans too. GCC 12's TBB backend
+ * starts each block from F{} (with or without an init value), which is only the identity
+ * for +: product and min come out as 0, and max is right only because this data is >= 0.
+ */
+template <typename Op, typename CcScan>
+void run (const std::string& op, const morph::vVector<F>& a, morph::vVector<F>& out, Op binop, double rel_tol, bool std_par, CcScan ccscan)
+{
+    auto serial = [&](morph::vVector<F>& o) {
+        F c = a[0];
+        o[0] = c;
+        for (size_t i = 1; i < a.size(); ++i) { c = binop (c, a[i]); o[i] = c; }
+    };
+    morph::vVector<F> ref(a.size());
+    serial (ref);
+
+    time_scan (op, "a serial loop", out, ref, 0.0, [&]() { serial (out); });
+    time_scan (op, "std::inclusive_scan", out, ref, 0.0, [&]() { std::inclusive_scan (a.begin(), a.end(), out.begin(), binop); });
+#ifdef CC_HAVE_TBB
+    if (std_par) {
+        time_scan (op, "std::inclusive_scan (par)", out, ref, rel_tol, [&]() {
+            std::inclusive_scan (std::execution::par, a.begin(), a.end(), out.begin(), binop);
+        });
+        time_scan (op, "std::inclusive_scan (par_unseq)", out, ref, rel_tol, [&]() {
+            std::inclusive_scan (std::execution::par_unseq, a.begin(), a.end(), out.begin(), binop);
+        });
+    }
+#endif
+    time_scan (op, "cc::scan", out, ref, rel_tol, [&]() { ccscan (a, out); });
+}
+
+int main()
+{
+    morph::vVector<F> a(n_elements), out(n_elements);
+    a.randomize();
+    // Factors close to 1 so that the cumulative product stays finite
+    morph::vVector<F> near1 = a;
+    for (auto& x : near1) { x = F{1} + (x - F{0.5}) * F{2e-3}; }
+
+    // A float running sum of 10M elements drifts from any other association by this much
+    const double sum_tol = 1e-3;
+    run ("Cumulative sum", a, out, std::plus<F>(), sum_tol, true, [](const morph::vVector<F>& in, morph::vVector<F>& o) { cc::scan::cumsum (in, o); });
+    run ("Cumulative product", near1, out, std::multiplies<F>(), sum_tol, false, [](const morph::vVector<F>& in, morph::vVector<F>& o) { cc::scan::cumprod (in, o); });
+    run ("Running max", a, out, [](F x, F y) { return std::max (x, y); }, 0.0, false, [](const morph::vVector<F>& in, morph::vVector<F>& o) { cc::scan::cummax (in, o); });
+    run ("Running min", a, out, [](F x, F y) { return std::min (x, y); }, 0.0, false, [](const morph::vVector<F>& in, morph::vVector<F>& o) { cc::scan::cummin (in, o); });
+
+    return cc::bench::failures > 0 ? 1 : 0;
+}
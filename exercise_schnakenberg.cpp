@@ -0,0 +1,279 @@
+/*
+ * The whole solver step rather than isolated ops: a Schnakenberg reaction-diffusion model
+ *
+ *   du/dt = Du lap(u) + k (a - u + u^2 v)
+ *   dv/dt = Dv lap(v) + k (b - u^2 v)
+ *
+ * on a periodic nx by ny grid, forward Euler, written three times with identical
+ * numerics (the same operations in the same order, so the fields agree bit for bit):
+ *
+ *   vVector          - as our models are written: vVector expressions, with temporaries
+ *   vVector in place - the same with compound assignments into buffers kept across steps
+ *   Eigen            - Eigen arrays, the Laplacian as block expressions over a haloed array
+ *
+ * The vVector versions take their Laplacian from cc::stencil. Reported for each grid size
+ * and OpenMP thread count: steps per second, heap allocations per step and the time per
+ * step in each phase (Laplacian, reaction terms, Euler update). Eigen's elementwise array
+ * expressions don't use OpenMP, so only its haloed copies and our stencil see the threads.
+ * After each run, u and v from the three versions are checked to be bit-identical.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include <chrono>
+#include <Eigen/Dense>
+#include <morph/vVector.h>
+#include "stencil.h"
+#include "bench_check.h"
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+typedef Eigen::Array<F, Eigen::Dynamic, Eigen::Dynamic> EigenGrid;
+
+// Count every heap allocation. With glibc, malloc itself is replaced (forwarding to glibc's
+// own), which catches Eigen's aligned_malloc as well as operator new; elsewhere only
+// operator new is counted.
+static std::atomic<size_t> n_allocs{0};
+#ifdef __GLIBC__
+extern "C" {
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void __libc_free (void*);
+    void* malloc (size_t sz) { ++n_allocs; return __libc_malloc (sz); }
+    void* calloc (size_t n, size_t sz) { ++n_allocs; return __libc_calloc (n, sz); }
+    void* realloc (void* p, size_t sz) { ++n_allocs; return __libc_realloc (p, sz); }
+    void* memalign (size_t al, size_t sz) { ++n_allocs; return __libc_memalign (al, sz); }
+    void* aligned_alloc (size_t al, size_t sz) { ++n_allocs; return __libc_memalign (al, sz); }
+    int posix_memalign (void** p, size_t al, size_t sz)
+    {
+        ++n_allocs;
+        *p = __libc_memalign (al, sz);
+        return *p ? 0 : ENOMEM;
+    }
+    void free (void* p) { __libc_free (p); }
+}
+#else
+void* operator new (size_t sz)
+{
+    ++n_allocs;
+    if (void* p = std::malloc (sz ? sz : 1)) { return p; }
+    throw std::bad_alloc();
+}
+void operator delete (void* p) noexcept { std::free (p); }
+void operator delete (void* p, size_t) noexcept { std::free (p); }
+#endif
+
+struct params
+{
+    F a = F{0.1};
+    F b = F{0.9};
+    F Du = F{1};
+    F Dv = F{40};
+    F k = F{1};
+    F dt = F{0.002};
+    F h = F{1};
+};
+
+// Time per phase, summed over steps
+struct phases
+{
+    steady_clock::duration lap = steady_clock::duration::zero();
+    steady_clock::duration react = steady_clock::duration::zero();
+    steady_clock::duration update = steady_clock::duration::zero();
+};
+
+// Fields and work buffers for the vVector versions
+struct vfields
+{
+    morph::vVector<F> u, v, lap_u, lap_v, uuv, du, dv;
+    vfields (size_t n) : u(n), v(n), lap_u(n), lap_v(n), uuv(n), du(n), dv(n) {}
+};
+
+void step_vvector (vfields& f, size_t nx, size_t ny, const params& p, phases& t)
+{
+    steady_clock::time_point t0 = steady_clock::now();
+    cc::stencil::laplacian (f.u, nx, ny, f.lap_u, F{1} / (p.h * p.h), cc::stencil::periodic);
+    cc::stencil::laplacian (f.v, nx, ny, f.lap_v, F{1} / (p.h * p.h), cc::stencil::periodic);
+    steady_clock::time_point t1 = steady_clock::now();
+    morph::vVector<F> uuv = f.u * f.u * f.v;
+    morph::vVector<F> du = f.lap_u * p.Du + (-f.u + p.a + uuv) * p.k;
+    morph::vVector<F> dv = f.lap_v * p.Dv + (-uuv + p.b) * p.k;
+    steady_clock::time_point t2 = steady_clock::now();
+    f.u += du * p.dt;
+    f.v += dv * p.dt;
+    steady_clock::time_point t3 = steady_clock::now();
+    t.lap += t1 - t0;
+    t.react += t2 - t1;
+    t.update += t3 - t2;
+}
+
+void step_vvector_inplace (vfields& f, size_t nx, size_t ny, const params& p, phases& t)
+{
+    steady_clock::time_point t0 = steady_clock::now();
+    cc::stencil::laplacian (f.u, nx, ny, f.lap_u, F{1} / (p.h * p.h), cc::stencil::periodic);
+    cc::stencil::laplacian (f.v, nx, ny, f.lap_v, F{1} / (p.h * p.h), cc::stencil::periodic);
+    steady_clock::time_point t1 = steady_clock::now();
+    // The same operations in the same order as step_vvector (x + y == y + x and -u == u * -1 exactly)
+    f.uuv = f.u;
+    f.uuv *= f.u;
+    f.uuv *= f.v;
+    f.du = f.u;
+    f.du *= F{-1};
+    f.du += p.a;
+    f.du += f.uuv;
+    f.du *= p.k;
+    f.lap_u *= p.Du;
+    f.du += f.lap_u;
+    f.dv = f.uuv;
+    f.dv *= F{-1};
+    f.dv += p.b;
+    f.dv *= p.k;
+    f.lap_v *= p.Dv;
+    f.dv += f.lap_v;
+    steady_clock::time_point t2 = steady_clock::now();
+    f.du *= p.dt;
+    f.u += f.du;
+    f.dv *= p.dt;
+    f.v += f.dv;
+    steady_clock::time_point t3 = steady_clock::now();
+    t.lap += t1 - t0;
+    t.react += t2 - t1;
+    t.update += t3 - t2;
+}
+
+struct efields
+{
+    EigenGrid u, v, halo, lap_u, lap_v;
+    efields (size_t nx, size_t ny) : u(nx, ny), v(nx, ny), halo(nx + 2, ny + 2), lap_u(nx, ny), lap_v(nx, ny) {}
+};
+
+// The 5 point Laplacian with periodic boundaries, summing the taps in cc::stencil's order
+void eigen_laplacian (const EigenGrid& f, EigenGrid& halo, EigenGrid& out, F scale)
+{
+    const Eigen::Index nx = f.rows(), ny = f.cols();
+    halo.block (1, 1, nx, ny) = f;
+    halo.block (0, 1, 1, ny) = f.row (nx - 1);
+    halo.block (nx + 1, 1, 1, ny) = f.row (0);
+    halo.col (0) = halo.col (ny);
+    halo.col (ny + 1) = halo.col (1);
+    const F c = static_cast<F>(-4.0 * scale);
+    out = scale * halo.block (1, 0, nx, ny) + scale * halo.block (0, 1, nx, ny) + c * halo.block (1, 1, nx, ny)
+        + scale * halo.block (2, 1, nx, ny) + scale * halo.block (1, 2, nx, ny);
+}
+
+void step_eigen (efields& f, const params& p, phases& t)
+{
+    steady_clock::time_point t0 = steady_clock::now();
+    eigen_laplacian (f.u, f.halo, f.lap_u, F{1} / (p.h * p.h));
+    eigen_laplacian (f.v, f.halo, f.lap_v, F{1} / (p.h * p.h));
+    steady_clock::time_point t1 = steady_clock::now();
+    EigenGrid uuv = f.u * f.u * f.v;
+    EigenGrid du = f.lap_u * p.Du + (-f.u + p.a + uuv) * p.k;
+    EigenGrid dv = f.lap_v * p.Dv + (-uuv + p.b) * p.k;
+    steady_clock::time_point t2 = steady_clock::now();
+    f.u += du * p.dt;
+    f.v += dv * p.dt;
+    steady_clock::time_point t3 = steady_clock::now();
+    t.lap += t1 - t0;
+    t.react += t2 - t1;
+    t.update += t3 - t2;
+}
+
+void report (const std::string& what, const std::string& grid, int threads, int steps, steady_clock::duration d, size_t allocs, const phases& t)
+{
+    const double us = duration_cast<nanoseconds>(d).count() / 1000.0 / steps;
+    auto per = [steps](steady_clock::duration x) { return duration_cast<microseconds>(x).count() / steps; };
+    std::cout << "Schnakenberg step took " << static_cast<long long>(us) << " us with " << what << ", " << grid << ", "
+              << threads << (threads == 1 ? " thread" : " threads") << " (" << static_cast<long long>(1e6 / us) << " steps/s, "
+              << static_cast<double>(allocs) / steps << " allocs/step; laplacian " << per (t.lap) << " us, reaction "
+              << per (t.react) << " us, update " << per (t.update) << " us)" << std::endl;
+}
+
+void run (size_t nx, size_t ny, int threads, int steps)
+{
+#ifdef _OPENMP
+    omp_set_num_threads (threads);
+#endif
+    const params p;
+    const size_t n = nx * ny;
+    const std::string grid = std::to_string (nx) + "x" + std::to_string (ny);
+
+    // Perturbations about the homogeneous steady state
+    morph::vVector<F> noise(n);
+    noise.randomize();
+    vfields f1(n), f2(n);
+    efields e(nx, ny);
+    const F u0 = p.a + p.b, v0 = p.b / ((p.a + p.b) * (p.a + p.b));
+    for (size_t i = 0; i < n; ++i) {
+        f1.u[i] = u0 + F{0.01} * (noise[i] - F{0.5});
+        f1.v[i] = v0 + F{0.01} * (noise[(i * 7) % n] - F{0.5});
+        e.u.data()[i] = f1.u[i];
+        e.v.data()[i] = f1.v[i];
+    }
+    f2.u = f1.u;
+    f2.v = f1.v;
+
+    phases t;
+    size_t a0 = n_allocs;
+    steady_clock::time_point start = steady_clock::now();
+    for (int s = 0; s < steps; ++s) { step_vvector (f1, nx, ny, p, t); }
+    report ("vVector", grid, threads, steps, steady_clock::now() - start, n_allocs - a0, t);
+
+    t = phases();
+    a0 = n_allocs;
+    start = steady_clock::now();
+    for (int s = 0; s < steps; ++s) { step_vvector_inplace (f2, nx, ny, p, t); }
+    report ("vVector in place", grid, threads, steps, steady_clock::now() - start, n_allocs - a0, t);
+
+    t = phases();
+    a0 = n_allocs;
+    start = steady_clock::now();
+    for (int s = 0; s < steps; ++s) { step_eigen (e, p, t); }
+    report ("Eigen", grid, threads, steps, steady_clock::now() - start, n_allocs - a0, t);
+
+    // The numerics are identical, so any difference at all (NaNs included) is a bug
+    F d12 = F{0}, d1e = F{0};
+    size_t n_diff = 0;
+    for (size_t i = 0; i < n; ++i) {
+        d12 = std::max ({ d12, std::abs (f1.u[i] - f2.u[i]), std::abs (f1.v[i] - f2.v[i]) });
+        d1e = std::max ({ d1e, std::abs (f1.u[i] - e.u.data()[i]), std::abs (f1.v[i] - e.v.data()[i]) });
+        if (f1.u[i] != f2.u[i] || f1.v[i] != f2.v[i] || f1.u[i] != e.u.data()[i] || f1.v[i] != e.v.data()[i]) { ++n_diff; }
+    }
+    if (n_diff > 0) { ++cc::bench::failures; }
+    std::cout << "  after " << steps << " steps u and v differ by at most " << d12 << " (vVector in place) and "
+              << d1e << " (Eigen) from vVector" << (n_diff > 0 ? ", WRONG at " + std::to_string (n_diff) + " cells" : "") << std::endl;
+}
+
+int main()
+{
+#ifdef _OPENMP
+    const int max_threads = omp_get_max_threads();
+#else
+    const int max_threads = 1;
+#endif
+    std::vector<int> thread_counts;
+    for (int th = 1; th < max_threads; th *= 2) { thread_counts.push_back (th); }
+    thread_counts.push_back (max_threads);
+
+    // Steps scaled so each grid does about the same work
+    for (size_t nx : { 128, 512, 2048 }) {
+        const int steps = static_cast<int>(std::max (size_t{10}, (size_t{1} << 26) / (nx * nx)));
+        for (int th : thread_counts) { run (nx, nx, th, steps); }
+    }
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Scaling vVector work past one process: the same elementwise multiply and dot product
+ * run by teams of 1 to N worker processes sharing the vectors in a POSIX shared memory
+ * segment (cc::shm), and by 1 to N OpenMP threads in one process on ordinary vVectors.
+ * N is the number of cores, or the first argument. Every process team runs first, since
+ * forking a process that has already started OpenMP threads isn't safe. A worker that
+ * fails shows up as a barrier timeout in the others; the run is reported as failed and
+ * the bench goes on to the next.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <algorithm>
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <morph/vVector.h>
+#include "shm_vvector.h"
+#include "bench_check.h"
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+const size_t n_elements = size_t{1} << 24;
+const int reps = 50;
+
+// Seconds a process waits at a barrier for the rest of its team; much longer than any rep takes
+const double barrier_timeout = 10.0;
+
+F a_at (size_t i) { return static_cast<F>(i % 1000) / F{1000}; }
+F b_at (size_t i) { return static_cast<F>((i * 7) % 1000) / F{500}; }
+
+// What the runs should get: a * b, rounded to F, and its dot product with a
+double mult_at (size_t i) { return a_at (i) * b_at (i); }
+double expected_dot()
+{
+    double s = 0.0;
+    for (size_t i = 0; i < n_elements; ++i) { s += static_cast<double>(a_at (i)) * static_cast<F>(mult_at (i)); }
+    return s;
+}
+
+// Reductions add in a different order with each team size, so allow for rounding
+std::string check_dot (double got, double expect)
+{
+    if (std::abs (got - expect) <= 1e-9 * std::abs (expect)) { return "dot " + std::to_string (got); }
+    ++cc::bench::failures;
+    return "dot " + std::to_string (got) + ", WRONG: expected " + std::to_string (expect);
+}
+
+void report (steady_clock::duration d_mult, steady_clock::duration d_dot, const std::string& with,
+             const cc::bench::result& res, const std::string& dot_res)
+{
+    std::cout << "Vector mult took " << duration_cast<milliseconds>(d_mult).count() << " ms with " << with << " (" << res << ")" << std::endl;
+    std::cout << "Dot product took " << duration_cast<milliseconds>(d_dot).count() << " ms with " << with << " (" << dot_res << ")" << std::endl;
+}
+
+struct timings
+{
+    steady_clock::duration mult;
+    steady_clock::duration dot;
+    double dot_value = 0.0;
+    cc::bench::result mult_res;
+};
+
+// A team member's share of the run. Every rank goes through the same barriers; rank 0 times and checks.
+timings work (cc::shm::team& t)
+{
+    timings out;
+    cc::shm::shared_vector<F> a = t.alloc<F> (n_elements), b = t.alloc<F> (n_elements), c = t.alloc<F> (n_elements);
+    // Each process fills its own part, so its pages are first touched where it runs
+    cc::shm::for_part<F> (t, n_elements, [&](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) {
+            a[i] = a_at (i);
+            b[i] = b_at (i);
+        }
+    });
+
+    steady_clock::time_point start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::shm::mult (t, a, b, c); }
+    out.mult = steady_clock::now() - start;
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { out.dot_value = cc::shm::dot (t, a, c); }
+    out.dot = steady_clock::now() - start;
+
+    // mult ended on a barrier, so c is complete
+    if (t.rank() == 0) { out.mult_res = cc::bench::check (c.data(), c.size(), mult_at, 0); }
+    return out;
+}
+
+// A team of nprocs processes: this one as rank 0, the rest forked from it
+void run_processes (int nprocs, double expect)
+{
+    const std::string name = "/cc_exercise_shm_" + std::to_string (getpid());
+    cc::shm::team t = cc::shm::team::create (name, nprocs, 3 * (n_elements * sizeof(F) + cc::shm::align));
+    std::vector<pid_t> kids;
+    for (int rank = 1; rank < nprocs; ++rank) {
+        const pid_t pid = fork();
+        if (pid < 0) { throw std::runtime_error ("exercise_shm: fork failed"); }
+        if (pid == 0) {
+            // A worker: attach by name, as a separately started process would, and leave
+            // without running the parent's destructors (which would unlink the segment)
+            int status = 0;
+            try {
+                cc::shm::team mine = cc::shm::team::attach (name, rank);
+                work (mine);
+            } catch (const std::exception& e) {
+                std::cerr << "worker " << rank << ": " << e.what() << std::endl;
+                status = 1;
+            }
+            _exit (status);
+        }
+        kids.push_back (pid);
+    }
+    std::string failed;
+    timings tm;
+    try {
+        tm = work (t);
+    } catch (const std::exception& e) {
+        failed = e.what();
+        // The workers still alive would only time out at the next barrier too
+        for (pid_t pid : kids) { kill (pid, SIGKILL); }
+    }
+    for (pid_t pid : kids) {
+        int status = 0;
+        waitpid (pid, &status, 0);
+        if (failed.empty() && (!WIFEXITED (status) || WEXITSTATUS (status) != 0)) { failed = "a worker failed"; }
+    }
+    if (!failed.empty()) {
+        ++cc::bench::failures;
+        std::cout << "Team of " << nprocs << " processes FAILED: " << failed << std::endl;
+        return;
+    }
+    report (tm.mult, tm.dot, std::to_string (nprocs) + (nprocs == 1 ? " process" : " processes"),
+            tm.mult_res, check_dot (tm.dot_value, expect));
+}
+
+void run_threads (int nthreads, double expect)
+{
+#ifdef _OPENMP
+    omp_set_num_threads (nthreads);
+#endif
+    const long long n = static_cast<long long>(n_elements);
+    morph::vVector<F> a(n_elements), b(n_elements), c(n_elements);
+#pragma omp parallel for schedule(static)
+    for (long long i = 0; i < n; ++i) {
+        a[i] = a_at (i);
+        b[i] = b_at (i);
+    }
+
+    steady_clock::time_point start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+#pragma omp parallel for schedule(static)
+        for (long long i = 0; i < n; ++i) { c[i] = a[i] * b[i]; }
+        cc::bench::do_not_optimize (c.data());
+        cc::bench::clobber_memory();
+    }
+    steady_clock::duration d_mult = steady_clock::now() - start;
+
+    double dot = 0.0;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        double s = 0.0;
+#pragma omp parallel for schedule(static) reduction(+:s)
+        for (long long i = 0; i < n; ++i) { s += static_cast<double>(a[i]) * c[i]; }
+        dot = s;
+        cc::bench::do_not_optimize (dot);
+    }
+    steady_clock::duration d_dot = steady_clock::now() - start;
+
+    report (d_mult, d_dot, std::to_string (nthreads) + (nthreads == 1 ? " OpenMP thread" : " OpenMP threads"),
+            cc::bench::check (c.data(), c.size(), mult_at, 0), check_dot (dot, expect));
+}
+
+int main (int argc, char** argv)
+{
+    const int max_n = std::max (1, argc > 1 ? std::atoi (argv[1]) : static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<int> counts;
+    for (int k = 1; k < max_n; k *= 2) { counts.push_back (k); }
+    counts.push_back (max_n);
+
+    cc::shm::barrier_timeout = barrier_timeout;
+    const double expect = expected_dot();
+    for (int k : counts) { run_processes (k, expect); }
+    for (int k : counts) { run_threads (k, expect); }
+
+    return cc::bench::failures > 0 ? 1 : 0;
+}
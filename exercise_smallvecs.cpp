@@ -8,6 +8,7 @@
 #include <morph/Random.h>
 #include <morph/vVector.h>
 #include <chrono>
+#include "perf_counters.h"
 
 using namespace std::chrono;
 using std::chrono::steady_clock;
@@ -19,8 +20,13 @@ typedef Eigen::Array<F, Eigen::Dynamic, 1> EigenVec;
 // How long are the vectors?
 const size_t veclen = 4;
 
+// Elements processed by each timed loop, for the per element hardware counter figures
+const double n_elements = 500.0 * veclen;
+
 int main()
 {
+    // Open the counters before OpenMP starts its threads, so that they're inherited
+    cc::perf_counters pc;
     morph::RandUniform<float> rng;
     steady_clock::time_point start = steady_clock::now();
     steady_clock::duration sincestart;
@@ -31,12 +37,15 @@ int main()
     EigenVec ev2(veclen);
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         ev2 = ev * i;
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
     std::cout << "Scalar mult took " << duration_cast<nanoseconds>(sincestart).count() << " ns with Eigen" << std::endl;
+    pc.report ("Scalar mult (Eigen)", n_elements);
 
     // Multiplication. vVector
     morph::vVector<F> v(veclen);
@@ -44,72 +53,93 @@ int main()
     morph::vVector<F> v2(veclen);
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         //v *= i; // super fast. 500 million mults in 8 ns = 62.5 gflops (with omp parallel)
         //v2 = v * i; // Same speed as Eigen (but with omp parallel). 65 ns.
         v.mult (i, v2); // With OpenMP parallel on an i9, this whips Eigen (20ns to 66 ns).
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
     std::cout << "Scalar mult took " << duration_cast<nanoseconds>(sincestart).count() << " ns with vVector" << std::endl;
+    pc.report ("Scalar mult (vVector)", n_elements);
 
     // Vec Multiplication. Eigen
     EigenVec ev3(veclen);
     for (auto& vv : ev3) { vv = rng.get(); }
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         ev2 = ev * ev3;
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
     std::cout << "Vector mult took " << duration_cast<nanoseconds>(sincestart).count() << " ns with Eigen" << std::endl;
+    pc.report ("Vector mult (Eigen)", n_elements);
 
     // Vec Multiplication. vVector
     morph::vVector<F> v3(veclen);
     v3.randomize();
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         v2 = v * v3;
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
     std::cout << "Vector mult took " << duration_cast<nanoseconds>(sincestart).count() << " ns with vVector" << std::endl;
+    pc.report ("Vector mult (vVector)", n_elements);
 
     // Vec Division. Eigen
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         ev2 = ev / ev3;
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
     std::cout << "Vector div took " << duration_cast<nanoseconds>(sincestart).count() << " ns with Eigen" << std::endl;
+    pc.report ("Vector div (Eigen)", n_elements);
 
     // Vec Division. vVector
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         v2 = v / v3;
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
 
     std::cout << "Vector div took " << duration_cast<nanoseconds>(sincestart).count() << " ns with vVector" << std::endl;
+    pc.report ("Vector div (vVector)", n_elements);
 
     // Pow
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         ev = ev2.pow(F{1}/i); // 2640 ns
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
     std::cout << "Raise to scalar power took " << duration_cast<nanoseconds>(sincestart).count() << " ns with Eigen" << std::endl;
+    pc.report ("Raise to scalar power (Eigen)", n_elements);
 
     start = steady_clock::now();
+    pc.start();
     for (F i = F{0}; i < F{500}; i += F{1}) {
         //v.pow_inplace (F{1}/i); // 949 ns no OMP, 120 ns with.
         v2 = v.pow (F{1}/i); // 2617 ns. 320 ns with.
     }
+    pc.stop();
     sincestart = steady_clock::now() - start;
     std::cout << "Raise to scalar power took " << duration_cast<nanoseconds>(sincestart).count() << " ns with vVector" << std::endl;
+    pc.report ("Raise to scalar power (vVector)", n_elements);
 
     return 0;
 }
@@ -0,0 +1,170 @@
+/*
+ * Order statistics over a large vVector. What we do now (copy into a std::vector and
+ * std::sort, with the parallel execution policy where the standard library has one)
+ * against cc::order's sort, argsort, nth_element and quantiles. Each cc::order result is
+ * then checked against the std:: algorithms on a copy of the same data.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <chrono>
+#ifdef CC_HAVE_TBB
+# include <execution>
+#endif
+#include <cmath>
+#include <morph/vVector.h>
+#include "sort_ops.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+const size_t n_elements = 10000000;
+const int reps = 5;
+
+template <typename Fn>
+void time_op (const std::string& op, const std::string& what, Fn fn)
+{
+    steady_clock::duration total = steady_clock::duration::zero();
+    double check = 0.0;
+    for (int r = 0; r < reps; ++r) { check += fn (total); }
+    std::cout << op << " took " << duration_cast<milliseconds>(total).count() / reps << " ms with " << what
+              << " (" << check / reps << ")" << std::endl;
+}
+
+// The q quantile of sorted values, interpolating linearly between order statistics
+template <typename V>
+F interpolated (const V& sorted, double q)
+{
+    const double r = q * (sorted.size() - 1);
+    const size_t lo = static_cast<size_t>(std::floor (r));
+    const size_t hi = static_cast<size_t>(std::ceil (r));
+    return static_cast<F>(sorted[lo] + (r - lo) * (sorted[hi] - sorted[lo]));
+}
+
+void report_check (const std::string& what, const std::string& ref, size_t wrong)
+{
+    if (wrong > 0) { ++cc::bench::failures; }
+    std::cout << what << (wrong == 0 ? " matches " : " is WRONG at " + std::to_string (wrong) + " elements against ") << ref << std::endl;
+}
+
+int main()
+{
+    morph::vVector<F> a(n_elements);
+    a.randomize();
+    const std::vector<double> qs = { 0.5, 0.9, 0.99 };
+
+    // Each op works on a fresh copy of a; only the op itself is timed
+    time_op ("Sort", "std::sort", [&](steady_clock::duration& d) {
+        std::vector<F> v (a.begin(), a.end());
+        steady_clock::time_point start = steady_clock::now();
+        std::sort (v.begin(), v.end());
+        d += steady_clock::now() - start;
+        return static_cast<double>(v[v.size() / 2]);
+    });
+#ifdef CC_HAVE_TBB
+    time_op ("Sort", "std::sort (par)", [&](steady_clock::duration& d) {
+        std::vector<F> v (a.begin(), a.end());
+        steady_clock::time_point start = steady_clock::now();
+        std::sort (std::execution::par, v.begin(), v.end());
+        d += steady_clock::now() - start;
+        return static_cast<double>(v[v.size() / 2]);
+    });
+#endif
+    time_op ("Sort", "cc::order::sort", [&](steady_clock::duration& d) {
+        morph::vVector<F> v = a;
+        steady_clock::time_point start = steady_clock::now();
+        cc::order::sort (v);
+        d += steady_clock::now() - start;
+        return static_cast<double>(v[v.size() / 2]);
+    });
+
+    time_op ("Argsort", "std::stable_sort of indices", [&](steady_clock::duration& d) {
+        steady_clock::time_point start = steady_clock::now();
+        std::vector<size_t> idx (a.size());
+        std::iota (idx.begin(), idx.end(), size_t{0});
+        std::stable_sort (idx.begin(), idx.end(), [&a](size_t i, size_t j) { return a[i] < a[j]; });
+        d += steady_clock::now() - start;
+        return static_cast<double>(idx[idx.size() / 2]);
+    });
+    time_op ("Argsort", "cc::order::argsort", [&](steady_clock::duration& d) {
+        morph::vVector<size_t> idx;
+        steady_clock::time_point start = steady_clock::now();
+        cc::order::argsort (a, idx);
+        d += steady_clock::now() - start;
+        return static_cast<double>(idx[idx.size() / 2]);
+    });
+
+    time_op ("Median", "std::nth_element", [&](steady_clock::duration& d) {
+        std::vector<F> v (a.begin(), a.end());
+        steady_clock::time_point start = steady_clock::now();
+        std::nth_element (v.begin(), v.begin() + v.size() / 2, v.end());
+        d += steady_clock::now() - start;
+        return static_cast<double>(v[v.size() / 2]);
+    });
+    time_op ("Median", "cc::order::nth_element", [&](steady_clock::duration& d) {
+        morph::vVector<F> v = a;
+        steady_clock::time_point start = steady_clock::now();
+        F m = cc::order::nth_element (v, v.size() / 2);
+        d += steady_clock::now() - start;
+        return static_cast<double>(m);
+    });
+
+    // p50, p90 and p99, as our analysis code does it now and with cc::order::quantiles (which copies a itself)
+    time_op ("Quantiles", "copy and std::sort", [&](steady_clock::duration& d) {
+        steady_clock::time_point start = steady_clock::now();
+        std::vector<F> v (a.begin(), a.end());
+        std::sort (v.begin(), v.end());
+        double s = 0.0;
+        for (double q : qs) { s += interpolated (v, q); }
+        d += steady_clock::now() - start;
+        return s;
+    });
+    time_op ("Quantiles", "cc::order::quantiles", [&](steady_clock::duration& d) {
+        steady_clock::time_point start = steady_clock::now();
+        std::vector<F> q = cc::order::quantiles (a, qs);
+        d += steady_clock::now() - start;
+        return static_cast<double>(q[0] + q[1] + q[2]);
+    });
+
+    // The references: a sorted with std::sort, and its indices with std::stable_sort
+    std::vector<F> sorted (a.begin(), a.end());
+    std::sort (sorted.begin(), sorted.end());
+    std::vector<size_t> order (a.size());
+    std::iota (order.begin(), order.end(), size_t{0});
+    std::stable_sort (order.begin(), order.end(), [&a](size_t i, size_t j) { return a[i] < a[j]; });
+
+    morph::vVector<F> v = a;
+    cc::order::sort (v);
+    size_t wrong = std::is_sorted (v.begin(), v.end()) ? 0 : 1;
+    for (size_t i = 0; i < v.size(); ++i) { wrong += v[i] != sorted[i]; }
+    report_check ("cc::order::sort", "std::sort", wrong);
+
+    morph::vVector<size_t> idx;
+    cc::order::argsort (a, idx);
+    wrong = idx.size() == order.size() ? 0 : 1;
+    for (size_t i = 0; wrong == 0 && i < idx.size(); ++i) { wrong += idx[i] != order[i]; }
+    report_check ("cc::order::argsort", "std::stable_sort of indices", wrong);
+
+    wrong = 0;
+    for (size_t k : { size_t{0}, a.size() / 3, a.size() / 2, a.size() - 1 }) {
+        v = a;
+        const F m = cc::order::nth_element (v, k);
+        wrong += m != sorted[k] || v[k] != sorted[k];
+        for (size_t i = 0; i < v.size(); ++i) { wrong += i < k ? v[i] > m : (i > k && v[i] < m); }
+    }
+    report_check ("cc::order::nth_element", "std::sort", wrong);
+
+    const std::vector<F> q = cc::order::quantiles (a, qs);
+    wrong = 0;
+    for (size_t i = 0; i < qs.size(); ++i) { wrong += q[i] != interpolated (sorted, qs[i]); }
+    report_check ("cc::order::quantiles", "std::sort and interpolation", wrong);
+
+    return cc::bench::failures > 0 ? 1 : 0;
+}
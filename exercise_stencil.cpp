@@ -0,0 +1,234 @@
+/*
+ * Stencils over vVector-held fields, as in the reaction-diffusion models we run: a plain
+ * nested loop, an Eigen formulation (block expressions over a haloed array) and
+ * cc::stencil, for the 5 and 9 point Laplacians and a radius 2 Moore neighbourhood on a
+ * square grid, the Laplacian on a grid too wide for its rows to stay in cache (with and
+ * without tiling), and rolling window means and maxima along a long 1-D field. Every cell of
+ * every result, boundaries included, is checked against a scalar loop in double.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <Eigen/Dense>
+#include <morph/vVector.h>
+#include "stencil.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+const int reps = 20;
+
+void report (const std::string& op, const std::string& what, steady_clock::duration d, F check)
+{
+    std::cout << op << " took " << duration_cast<microseconds>(d).count() / reps << " us with " << what
+              << " (" << check << ")" << std::endl;
+}
+
+// The nested loop we'd write now, with zero flux (clamped) boundaries
+void loop_laplacian (const morph::vVector<F>& u, size_t nx, size_t ny, morph::vVector<F>& out)
+{
+    for (size_t y = 0; y < ny; ++y) {
+        const size_t ym = y == 0 ? 0 : y - 1, yp = y == ny - 1 ? y : y + 1;
+        for (size_t x = 0; x < nx; ++x) {
+            const size_t xm = x == 0 ? 0 : x - 1, xp = x == nx - 1 ? x : x + 1;
+            out[y * nx + x] = u[y * nx + xm] + u[y * nx + xp] + u[ym * nx + x] + u[yp * nx + x] - F{4} * u[y * nx + x];
+        }
+    }
+}
+
+// The stencil s over u in double, one cell at a time, and for each cell the sum of the
+// magnitudes of its terms (a float result can be off by rounding in proportion to that)
+void reference (const cc::stencil::stencil& s, const morph::vVector<F>& u, size_t nx, size_t ny, cc::stencil::boundary b,
+                std::vector<double>& ref, std::vector<double>& mag)
+{
+    auto wrap = [b](long i, long n) { return b == cc::stencil::periodic ? ((i % n) + n) % n : std::clamp (i, 0L, n - 1); };
+    ref.assign (nx * ny, 0.0);
+    mag.assign (nx * ny, 0.0);
+    for (long y = 0; y < static_cast<long>(ny); ++y) {
+        for (long x = 0; x < static_cast<long>(nx); ++x) {
+            double r = 0.0, m = 0.0;
+            for (const auto& t : s.taps) {
+                const double term = t.w * u[wrap (y + t.dy, ny) * nx + wrap (x + t.dx, nx)];
+                r += term;
+                m += std::abs (term);
+            }
+            ref[y * nx + x] = r;
+            mag[y * nx + x] = m;
+        }
+    }
+}
+
+// Check every cell of got against ref, allowing a rounding per term
+void check_field (const std::string& what, const F* got, const std::vector<double>& ref, const std::vector<double>& mag, size_t nx, size_t n_terms)
+{
+    size_t wrong = 0, first = 0;
+    double worst = 0.0;
+    for (size_t i = 0; i < ref.size(); ++i) {
+        const double err = std::abs (got[i] - ref[i]);
+        const double tol = (n_terms + 1) * std::numeric_limits<F>::epsilon() * mag[i];
+        if (!(err <= tol)) {
+            if (wrong++ == 0) { first = i; }
+        }
+        worst = std::max (worst, err);
+    }
+    if (wrong == 0) {
+        std::cout << "  " << what << " is within " << worst << " of the scalar loop at every cell" << std::endl;
+    } else {
+        ++cc::bench::failures;
+        std::cout << "  " << what << " is WRONG at " << wrong << " cells, first at x " << first % nx << ", y " << first / nx
+                  << ": " << got[first] << " where " << ref[first] << " was expected" << std::endl;
+    }
+}
+
+// Eigen: copy into an array with a one cell halo, fill the halo, then one block expression
+typedef Eigen::Array<F, Eigen::Dynamic, Eigen::Dynamic> EigenGrid;
+void eigen_laplacian (const EigenGrid& u, EigenGrid& halo, EigenGrid& out)
+{
+    const Eigen::Index nx = u.rows(), ny = u.cols();
+    halo.block (1, 1, nx, ny) = u;
+    halo.block (0, 1, 1, ny) = u.row (0);
+    halo.block (nx + 1, 1, 1, ny) = u.row (nx - 1);
+    halo.col (0) = halo.col (1);
+    halo.col (ny + 1) = halo.col (ny);
+    out = halo.block (0, 1, nx, ny) + halo.block (2, 1, nx, ny) + halo.block (1, 0, nx, ny) + halo.block (1, 2, nx, ny)
+        - F{4} * halo.block (1, 1, nx, ny);
+}
+
+void square (size_t n)
+{
+    const std::string grid = std::to_string (n) + "x" + std::to_string (n);
+    morph::vVector<F> u(n * n), out(n * n);
+    u.randomize();
+    // Eigen is column major, so its rows are our x
+    EigenGrid eu = Eigen::Map<const EigenGrid> (u.data(), n, n), ehalo (n + 2, n + 2), eout (n, n);
+
+    steady_clock::time_point start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { loop_laplacian (u, n, n, out); }
+    report ("5 point Laplacian", "a nested loop, " + grid, steady_clock::now() - start, out[n * n / 2 + 1]);
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { eigen_laplacian (eu, ehalo, eout); }
+    report ("5 point Laplacian", "Eigen blocks, " + grid, steady_clock::now() - start, eout.data()[n * n / 2 + 1]);
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::stencil::laplacian (u, n, n, out, F{1}, cc::stencil::clamp); }
+    report ("5 point Laplacian", "cc::stencil, " + grid, steady_clock::now() - start, out[n * n / 2 + 1]);
+
+    cc::stencil::stencil l9 = cc::stencil::stencil::laplacian9();
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::stencil::apply (l9, u, n, n, out, cc::stencil::periodic); }
+    report ("9 point Laplacian", "cc::stencil, " + grid, steady_clock::now() - start, out[n * n / 2 + 1]);
+
+    cc::stencil::stencil m2 = cc::stencil::stencil::moore (2, 1.0 / 24);
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::stencil::apply (m2, u, n, n, out, cc::stencil::periodic); }
+    report ("Radius 2 Moore mean", "cc::stencil, " + grid, steady_clock::now() - start, out[n * n / 2 + 1]);
+
+    std::vector<double> ref, mag;
+    const cc::stencil::stencil l5 = cc::stencil::stencil::laplacian5();
+    reference (l5, u, n, n, cc::stencil::clamp, ref, mag);
+    loop_laplacian (u, n, n, out);
+    check_field ("5 point Laplacian, nested loop", out.data(), ref, mag, n, 5);
+    check_field ("5 point Laplacian, Eigen blocks", eout.data(), ref, mag, n, 5);
+    cc::stencil::laplacian (u, n, n, out, F{1}, cc::stencil::clamp);
+    check_field ("5 point Laplacian, cc::stencil", out.data(), ref, mag, n, 5);
+    reference (l9, u, n, n, cc::stencil::periodic, ref, mag);
+    cc::stencil::apply (l9, u, n, n, out, cc::stencil::periodic);
+    check_field ("9 point Laplacian, cc::stencil", out.data(), ref, mag, n, 9);
+    reference (m2, u, n, n, cc::stencil::periodic, ref, mag);
+    cc::stencil::apply (m2, u, n, n, out, cc::stencil::periodic);
+    check_field ("Radius 2 Moore mean, cc::stencil", out.data(), ref, mag, n, m2.taps.size());
+}
+
+void wide (size_t nx, size_t ny)
+{
+    const std::string grid = std::to_string (nx) + "x" + std::to_string (ny);
+    morph::vVector<F> u(nx * ny), out(nx * ny);
+    u.randomize();
+
+    steady_clock::time_point start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { loop_laplacian (u, nx, ny, out); }
+    report ("5 point Laplacian", "a nested loop, " + grid, steady_clock::now() - start, out[nx + 1]);
+
+    const size_t tx = cc::stencil::tile_x;
+    cc::stencil::tile_x = nx;
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::stencil::laplacian (u, nx, ny, out, F{1}, cc::stencil::clamp); }
+    report ("5 point Laplacian", "cc::stencil untiled, " + grid, steady_clock::now() - start, out[nx + 1]);
+    std::vector<double> ref, mag;
+    reference (cc::stencil::stencil::laplacian5(), u, nx, ny, cc::stencil::clamp, ref, mag);
+    check_field ("5 point Laplacian, cc::stencil untiled", out.data(), ref, mag, nx, 5);
+    cc::stencil::tile_x = tx;
+
+    start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) { cc::stencil::laplacian (u, nx, ny, out, F{1}, cc::stencil::clamp); }
+    report ("5 point Laplacian", "cc::stencil tiled, " + grid, steady_clock::now() - start, out[nx + 1]);
+    check_field ("5 point Laplacian, cc::stencil tiled", out.data(), ref, mag, nx, 5);
+    loop_laplacian (u, nx, ny, out);
+    check_field ("5 point Laplacian, nested loop", out.data(), ref, mag, nx, 5);
+}
+
+void rolling (size_t n)
+{
+    const std::string len = std::to_string (n) + " elements";
+    morph::vVector<F> a(n), out(n);
+    a.randomize();
+
+    for (size_t w : { 9, 101 }) {
+        const long h = static_cast<long>(w / 2);
+        const std::string what = "window " + std::to_string (w) + ", " + len;
+        steady_clock::time_point start = steady_clock::now();
+        for (int r = 0; r < reps; ++r) {
+            for (long i = 0; i < static_cast<long>(n); ++i) {
+                F s = F{0};
+                for (long k = i - h; k <= i + h; ++k) { s += a[std::clamp (k, 0L, static_cast<long>(n) - 1)]; }
+                out[i] = s / w;
+            }
+        }
+        report ("Rolling mean", "a nested loop, " + what, steady_clock::now() - start, out[n / 2]);
+
+        start = steady_clock::now();
+        for (int r = 0; r < reps; ++r) { cc::stencil::rolling (a, w, cc::stencil::mean, out, cc::stencil::clamp); }
+        report ("Rolling mean", "cc::stencil, " + what, steady_clock::now() - start, out[n / 2]);
+        std::vector<double> ref, mag;
+        cc::stencil::stencil box;
+        for (long dx = -h; dx <= h; ++dx) { box.taps.push_back ({ static_cast<int>(dx), 0, 1.0 / w }); }
+        reference (box, a, n, 1, cc::stencil::clamp, ref, mag);
+        check_field ("Rolling mean, cc::stencil, " + what, out.data(), ref, mag, n, w);
+
+        start = steady_clock::now();
+        for (int r = 0; r < reps; ++r) {
+            for (long i = 0; i < static_cast<long>(n); ++i) {
+                F m = a[std::clamp (i - h, 0L, static_cast<long>(n) - 1)];
+                for (long k = i - h + 1; k <= i + h; ++k) { m = std::max (m, a[std::clamp (k, 0L, static_cast<long>(n) - 1)]); }
+                out[i] = m;
+            }
+        }
+        report ("Rolling max", "a nested loop, " + what, steady_clock::now() - start, out[n / 2]);
+        const morph::vVector<F> loop_max = out;
+
+        start = steady_clock::now();
+        for (int r = 0; r < reps; ++r) { cc::stencil::rolling (a, w, cc::stencil::max, out, cc::stencil::clamp); }
+        report ("Rolling max", "cc::stencil, " + what, steady_clock::now() - start, out[n / 2]);
+        // A max is one of the inputs, so it must match exactly
+        std::vector<double> exact (loop_max.begin(), loop_max.end()), none (n, 0.0);
+        check_field ("Rolling max, cc::stencil, " + what, out.data(), exact, none, n, 0);
+    }
+}
+
+int main()
+{
+    square (2048);
+    wide (1 << 21, 8);
+    rolling (1 << 20);
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Like exercise.cpp, but the vector lives in a file that may be larger than RAM and is
+ * streamed through the op sequence (scalar mult, vector mult, vector div, pow) in
+ * chunks by cc::stream_pipeline.
+ *
+ * Usage: exercise_stream [GB] [path]
+ *
+ * By default a 16 GB file is generated at /tmp/calculatorcompare_stream.bin (and left
+ * there, so that subsequent runs don't pay to regenerate it). The peak resident set size
+ * is reported at the end; it should be a few MB regardless of the file size.
+ */
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <morph/vVector.h>
+#include "stream_pipeline.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+// Write gb gigabytes of random F values to path, unless a file of that size is there already
+void generate (const std::string& path, double gb)
+{
+    size_t bytes = static_cast<size_t>(gb * 1024.0 * 1024.0 * 1024.0);
+    struct stat st;
+    if (stat (path.c_str(), &st) == 0 && static_cast<size_t>(st.st_size) == bytes) {
+        std::cout << "Re-using " << path << std::endl;
+        return;
+    }
+    std::cout << "Generating " << gb << " GB in " << path << "..." << std::endl;
+    FILE* fp = std::fopen (path.c_str(), "wb");
+    if (fp == nullptr) { throw std::runtime_error ("Can't write " + path); }
+    // Random values in [1,2) so that div and pow stay finite
+    morph::vVector<F> block(1 << 20);
+    size_t remaining = bytes / sizeof(F);
+    while (remaining > 0) {
+        size_t n = std::min (remaining, block.size());
+        block.randomize (F{1}, F{2});
+        if (std::fwrite (block.data(), sizeof(F), n, fp) != n) {
+            std::fclose (fp);
+            throw std::runtime_error ("Short write to " + path);
+        }
+        remaining -= n;
+    }
+    std::fclose (fp);
+}
+
+void report (const std::string& what, const cc::stream_pipeline<F>& p, steady_clock::duration d, double result)
+{
+    double secs = duration_cast<microseconds>(d).count() / 1e6;
+    std::cout << what << " took " << duration_cast<milliseconds>(d).count() << " ms streaming "
+              << (p.bytes_read / (1024.0 * 1024.0 * 1024.0) / secs) << " GB/s (sum = " << result << ")" << std::endl;
+}
+
+int main (int argc, char** argv)
+{
+    double gb = argc > 1 ? std::atof (argv[1]) : 16.0;
+    std::string path = argc > 2 ? argv[2] : "/tmp/calculatorcompare_stream.bin";
+
+    try {
+        generate (path, gb);
+        cc::stream_source<F> a (path);
+        // The second operand for mult and div. Opened separately, so it's read from disk again.
+        cc::stream_source<F> b (path);
+
+        steady_clock::time_point start;
+        steady_clock::duration sincestart;
+
+        // Read and reduce, with no ops. This is the bandwidth to aim for.
+        cc::stream_pipeline<F> p_read;
+        start = steady_clock::now();
+        double r = p_read.run (a);
+        sincestart = steady_clock::now() - start;
+        report ("Read and sum", p_read, sincestart, r);
+
+        // Scalar mult
+        cc::stream_pipeline<F> p_scale;
+        p_scale.scale (F{2});
+        start = steady_clock::now();
+        r = p_scale.run (a);
+        sincestart = steady_clock::now() - start;
+        report ("Scalar mult", p_scale, sincestart, r);
+
+        // Vector mult then vector div (two input streams)
+        cc::stream_pipeline<F> p_multdiv;
+        p_multdiv.mult().div();
+        start = steady_clock::now();
+        r = p_multdiv.run (a, b);
+        sincestart = steady_clock::now() - start;
+        report ("Vector mult, div", p_multdiv, sincestart, r);
+
+        // The whole exercise.cpp sequence in one pass
+        cc::stream_pipeline<F> p_all;
+        p_all.scale (F{2}).mult().div().pow (F{1}/F{3});
+        start = steady_clock::now();
+        r = p_all.run (a, b);
+        sincestart = steady_clock::now() - start;
+        report ("Scalar mult, vector mult, div, pow", p_all, sincestart, r);
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    struct rusage ru;
+    getrusage (RUSAGE_SELF, &ru);
+    std::cout << "Peak RSS: " << (ru.ru_maxrss / 1024) << " MB" << std::endl; // ru_maxrss is in KB on Linux
+
+    return 0;
+}
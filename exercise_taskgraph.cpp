@@ -0,0 +1,144 @@
+/*
+ * A DAG of the exercise.cpp ops, with independent and dependent parts:
+ *
+ *   mult:  m = v * v3   ->  m *= 2     ->  sum(m)  \
+ *   div:   d = v / v3   ->  d = d^0.5  ->  sum(d)   >-> total
+ *   scale: s = v * 3                   ->  sum(s)  /
+ *
+ * run one op at a time (each op parallel inside, as exercise.cpp does it), and as a
+ * cc::task_graph, where the three chains run concurrently, with ops either serial or
+ * parallel inside each task. Also shows cc::run_async futures for the three sums. Every
+ * run's total is checked against the same DAG evaluated in double, one element at a time,
+ * so that a dependency dropped or run twice shows up as a wrong total.
+ */
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <morph/vVector.h>
+#include "task_graph.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+const size_t veclen = 1000000;
+const int reps = 100;
+
+struct state
+{
+    morph::vVector<F> v, v3, m, d, s;
+    F total = F{0};
+    state() : v(veclen), v3(veclen), m(veclen), d(veclen), s(veclen)
+    {
+        v.randomize (F{1}, F{2});
+        v3.randomize (F{1}, F{2});
+    }
+    //! Clear the results, so that a run can't pass on what an earlier one left
+    void reset()
+    {
+        m.zero();
+        d.zero();
+        s.zero();
+        total = F{0};
+    }
+    //! What total should be, in double
+    double expected() const
+    {
+        double t = 0.0;
+        for (size_t i = 0; i < veclen; ++i) {
+            t += 2.0 * v[i] * v3[i] + std::sqrt (static_cast<double>(v[i]) / v3[i]) + 3.0 * v[i];
+        }
+        return t;
+    }
+};
+
+// The float sums of a million terms round differently on each path (vVector::sum, adding
+// one at a time, by a few parts in 1e5); a chain that ran out of order, or a step that ran
+// twice or not at all, moves the total by 5% or more
+void check (const std::string& what, F got, double expect)
+{
+    if (std::abs (got - expect) <= 1e-3 * std::abs (expect)) {
+        std::cout << "  " << what << " agrees with the double reference " << expect << std::endl;
+    } else {
+        ++cc::bench::failures;
+        std::cout << "  " << what << " is WRONG: " << got << " where the double reference is " << expect << std::endl;
+    }
+}
+
+// Build the DAG, with the elementwise ops run on exec
+template <typename Exec>
+void build (cc::task_graph& g, state& st, Exec& exec)
+{
+    auto m1 = g.add ([&]() { cc::par::mult (exec, st.v, st.v3, st.m); });
+    auto m2 = g.add ([&]() { cc::par::scale (exec, st.m, F{2}, st.m); }, { m1 });
+    auto d1 = g.add ([&]() { cc::par::div (exec, st.v, st.v3, st.d); });
+    auto d2 = g.add ([&]() { cc::par::pow (exec, st.d, F{0.5}, st.d); }, { d1 });
+    auto s1 = g.add ([&]() { cc::par::scale (exec, st.v, F{3}, st.s); });
+    g.add ([&]() { st.total = cc::par::sum (exec, st.m) + cc::par::sum (exec, st.d) + cc::par::sum (exec, st.s); }, { m2, d2, s1 });
+}
+
+int main()
+{
+    cc::thread_pool pool;
+    cc::serial_executor serial;
+    std::cout << "Thread pool has " << pool.size() << " threads" << std::endl;
+
+    state st;
+    const double expect = st.expected();
+    steady_clock::time_point start;
+    steady_clock::duration sincestart;
+
+    // One op after another, each op parallel
+    cc::task_graph g_seq;
+    build (g_seq, st, pool);
+    st.reset();
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { g_seq.run_serial(); }
+    sincestart = steady_clock::now() - start;
+    std::cout << "Ops in sequence (parallel within each op) took "
+              << duration_cast<milliseconds>(sincestart).count() << " ms; total " << st.total << std::endl;
+    check ("ops in sequence", st.total, expect);
+
+    // Graph, ops serial inside each task: the only parallelism is between independent chains
+    cc::task_graph g_chains;
+    build (g_chains, st, serial);
+    st.reset();
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { g_chains.run (pool); }
+    sincestart = steady_clock::now() - start;
+    std::cout << "Task graph (parallel across chains) took "
+              << duration_cast<milliseconds>(sincestart).count() << " ms; total " << st.total << std::endl;
+    check ("task graph, across chains", st.total, expect);
+
+    // Graph, and ops parallel inside each task too
+    cc::task_graph g_both;
+    build (g_both, st, pool);
+    st.reset();
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { g_both.run (pool); }
+    sincestart = steady_clock::now() - start;
+    std::cout << "Task graph (parallel across and within chains) took "
+              << duration_cast<milliseconds>(sincestart).count() << " ms; total " << st.total << std::endl;
+    check ("task graph, across and within chains", st.total, expect);
+
+    // Futures: three independent reductions in flight at once
+    start = steady_clock::now();
+    F ftotal = F{0};
+    for (int i = 0; i < reps; ++i) {
+        auto fm = cc::run_async (pool, [&]() { return st.m.sum(); });
+        auto fd = cc::run_async (pool, [&]() { return st.d.sum(); });
+        auto fs = cc::run_async (pool, [&]() { return st.s.sum(); });
+        ftotal = fm.get() + fd.get() + fs.get();
+    }
+    sincestart = steady_clock::now() - start;
+    std::cout << "Three sums as futures took " << duration_cast<milliseconds>(sincestart).count()
+              << " ms; total " << ftotal << std::endl;
+    check ("futures", ftotal, expect);
+
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Temporal blocking of exercise.cpp's op sequence: each op applied 500 times to the same
+ * 1M element vectors, first as exercise.cpp does it (every pass streams the whole vectors)
+ * and then with cc::tblock running all the passes over one cache-sized block before moving
+ * to the next. Plus two ops whose passes depend on each other, as in our iterative solvers:
+ * a pointwise relaxation and a 3 point Jacobi smoothing (which needs the ghost zone tiling).
+ *
+ * For each, the time, the traffic to memory beyond L2 that the access pattern implies, and
+ * the hardware counters (LLC misses per element show the DRAM traffic actually saved). With
+ * a large L3 the 1M element default fits in it; pass a larger size to go to DRAM:
+ *
+ *   ./exercise_tblock 16000000
+ */
+
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <morph/vVector.h>
+#include "temporal_blocking.h"
+#include "perf_counters.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+const size_t passes = 500;
+
+// Time fn, then report it with the traffic beyond L2 for streams vectors of n floats crossing it trips times
+template <typename Fn>
+void run (cc::perf_counters& pc, const std::string& op, const std::string& what, size_t n, size_t streams, size_t trips, Fn fn)
+{
+    steady_clock::time_point start = steady_clock::now();
+    pc.start();
+    fn();
+    pc.stop();
+    steady_clock::duration d = steady_clock::now() - start;
+    const double mb = static_cast<double>(streams * trips * n * sizeof(F)) / (1024.0 * 1024.0);
+    std::cout << op << " took " << duration_cast<milliseconds>(d).count() << " ms with " << what
+              << " (" << static_cast<long long>(mb) << " MB beyond L2)" << std::endl;
+    pc.report (op + " (" + what + ")", static_cast<double>(passes * n));
+}
+
+int main (int argc, char** argv)
+{
+    cc::perf_counters pc;
+    const size_t n = argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 1000000;
+    morph::vVector<F> v(n), v2(n), v3(n);
+    v.randomize();
+    v3.randomize (F{1}, F{2});
+    F* vp = v.data();
+    F* v2p = v2.data();
+    F* v3p = v3.data();
+    const long long nn = static_cast<long long>(n);
+
+    // An op over [i0, i1) for pass it, and the number of vectors it touches
+    auto scalar_mult = [&](size_t it, size_t i0, size_t i1) { const F s = static_cast<F>(it); for (size_t i = i0; i < i1; ++i) { v2p[i] = vp[i] * s; } cc::bench::do_not_optimize (v2p); };
+    auto vector_mult = [&](size_t, size_t i0, size_t i1) { for (size_t i = i0; i < i1; ++i) { v2p[i] = vp[i] * v3p[i]; } cc::bench::do_not_optimize (v2p); };
+    auto vector_div = [&](size_t, size_t i0, size_t i1) { for (size_t i = i0; i < i1; ++i) { v2p[i] = vp[i] / v3p[i]; } cc::bench::do_not_optimize (v2p); };
+    auto power = [&](size_t it, size_t i0, size_t i1) { const F e = F{1} / static_cast<F>(it + 1); for (size_t i = i0; i < i1; ++i) { v2p[i] = std::pow (vp[i], e); } cc::bench::do_not_optimize (v2p); };
+    // v = 0.5 v + 0.5 v3: each pass reads the last one's v
+    auto relax = [&](size_t, size_t i0, size_t i1) { for (size_t i = i0; i < i1; ++i) { vp[i] = F{0.5} * vp[i] + F{0.5} * v3p[i]; } cc::bench::do_not_optimize (vp); };
+
+    // As exercise.cpp does it: pass after pass over all n, in parallel within a pass
+    auto untiled = [&](auto op) {
+        return [&, op]() {
+            for (size_t it = 0; it < passes; ++it) {
+#pragma omp parallel for
+                for (long long c = 0; c < nn; c += 16384) { op (it, c, std::min (nn, c + 16384)); }
+            }
+        };
+    };
+    auto tiled = [&](auto op, size_t streams) {
+        return [&, op, streams]() { cc::tblock::pointwise (n, passes, cc::tblock::block_for<F> (streams), op); };
+    };
+
+    run (pc, "Scalar mult", "whole vector passes", n, 2, passes, untiled (scalar_mult));
+    run (pc, "Scalar mult", "cc::tblock", n, 2, 1, tiled (scalar_mult, 2));
+    const F c1 = v2[n / 2];
+    run (pc, "Vector mult", "whole vector passes", n, 3, passes, untiled (vector_mult));
+    run (pc, "Vector mult", "cc::tblock", n, 3, 1, tiled (vector_mult, 3));
+    run (pc, "Vector div", "whole vector passes", n, 3, passes, untiled (vector_div));
+    run (pc, "Vector div", "cc::tblock", n, 3, 1, tiled (vector_div, 3));
+    // Compute bound: blocking can't help much here
+    run (pc, "Raise to scalar power", "whole vector passes", n, 2, passes, untiled (power));
+    run (pc, "Raise to scalar power", "cc::tblock", n, 2, 1, tiled (power, 2));
+
+    morph::vVector<F> v0 = v;
+    run (pc, "Relaxation", "whole vector passes", n, 2, passes, untiled (relax));
+    morph::vVector<F> r1 = v;
+    v = v0;
+    run (pc, "Relaxation", "cc::tblock", n, 2, 1, tiled (relax, 2));
+    bool same = r1 == v;
+
+    // Jacobi smoothing, double buffered, with clamped ends
+    auto jacobi = [](size_t, const F* in, F* out, size_t i0, size_t i1, size_t m) {
+        auto at = [&](size_t i) { out[i] = (in[i > 0 ? i - 1 : 0] + in[i] + in[i + 1 < m ? i + 1 : i]) * F{1.0 / 3.0}; };
+        // The ends apart, so that the interior loop vectorises
+        if (i0 == 0 && i0 < i1) { at (i0++); }
+        if (i1 == m && i0 < i1) { at (--i1); }
+        for (size_t i = i0; i < i1; ++i) { out[i] = (in[i - 1] + in[i] + in[i + 1]) * F{1.0 / 3.0}; }
+    };
+    morph::vVector<F> u = v0, tmp(n);
+    run (pc, "Jacobi smoothing", "whole vector passes", n, 2, passes, [&]() {
+        for (size_t it = 0; it < passes; ++it) {
+#pragma omp parallel for
+            for (long long c = 0; c < nn; c += 16384) { jacobi (it, u.data(), tmp.data(), c, std::min (nn, c + 16384), n); }
+            u.swap (tmp);
+        }
+    });
+    morph::vVector<F> u2 = v0;
+    const size_t depth = 32;
+    run (pc, "Jacobi smoothing", "cc::tblock, depth " + std::to_string (depth), n, 2, passes / depth + 1, [&]() {
+        cc::tblock::stencil (u2, passes, 1, depth, cc::tblock::block_for<F> (2), jacobi);
+    });
+    same = same && u == u2;
+
+    std::cout << "Results " << (same ? "match" : "DIFFER") << " (" << c1 << ")" << std::endl;
+    return same ? 0 : 1;
+}
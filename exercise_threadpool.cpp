@@ -0,0 +1,157 @@
+/*
+ * Compare parallel backends for vVector ops: vVector's own OpenMP loops, cc::par ops on
+ * the serial, OpenMP and work-stealing thread pool executors, and on a
+ * function_executor that submits to an "application" pool (here another
+ * cc::thread_pool standing in for one). Small vectors show the fork/join overhead;
+ * large ones the throughput. The nested test runs an outer parallel loop over 16
+ * independent vectors whose inner ops are also parallel, as happens when vVector is
+ * called from inside an application's own parallel tasks.
+ *
+ * Each backend's final scale and div outputs must equal the serial executor's element for
+ * element, and its sum must agree with the serial sum to within the floating point
+ * summation error bound. Every nested output is checked too, and the exit status is
+ * nonzero if anything differs.
+ */
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <morph/vVector.h>
+#include "parallel_backend.h"
+#include "bench_check.h"
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+// Check got against the serial executor's want, element for element
+void check (const std::string& what, const std::string& backend, const morph::vVector<F>& got, const morph::vVector<F>& want)
+{
+    size_t wrong = 0;
+    for (size_t i = 0; i < got.size(); ++i) { wrong += got[i] != want[i]; }
+    if (wrong > 0) { ++cc::bench::failures; }
+    std::cout << "  " << what << " with " << backend
+              << (wrong == 0 ? " matches the serial executor" : " is WRONG at " + std::to_string (wrong) + " elements") << std::endl;
+}
+
+template <typename Exec>
+void run (const std::string& backend, Exec& exec, size_t n, int reps)
+{
+    morph::vVector<F> v(n), v2(n), v3(n);
+    v.randomize();
+    v3.randomize (F{1}, F{2});
+    const size_t grain = std::max (size_t{1024}, n / 64);
+
+    steady_clock::time_point start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { cc::par::scale (exec, v, static_cast<F>(i), v2, grain); }
+    steady_clock::duration d = steady_clock::now() - start;
+    std::cout << "  Scalar mult took " << duration_cast<microseconds>(d).count() << " us with " << backend << std::endl;
+
+    // v2 holds the last rep's v * (reps - 1)
+    cc::serial_executor serial;
+    morph::vVector<F> want(n);
+    cc::par::scale (serial, v, static_cast<F>(reps - 1), want, grain);
+    check ("Scalar mult", backend, v2, want);
+
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { cc::par::div (exec, v, v3, v2, grain); }
+    d = steady_clock::now() - start;
+    std::cout << "  Vector div took " << duration_cast<microseconds>(d).count() << " us with " << backend << std::endl;
+
+    cc::par::div (serial, v, v3, want, grain);
+    check ("Vector div", backend, v2, want);
+
+    F s = F{0};
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { s += cc::par::sum (exec, v2, grain); }
+    d = steady_clock::now() - start;
+    std::cout << "  Sum took " << duration_cast<microseconds>(d).count() << " us with " << backend << " (" << s << ")" << std::endl;
+
+    /*
+     * The chunks are the same on every executor, but each instantiation of the chunk loop
+     * may be vectorised differently, so the two sums can round differently. Each is within
+     * (n - 1) * eps * sum|v2| of the exact sum, so they're within twice that of each other.
+     */
+    const F got = cc::par::sum (exec, v2, grain);
+    const F ref = cc::par::sum (serial, v2, grain);
+    double mag = 0.0;
+    for (size_t i = 0; i < n; ++i) { mag += std::abs (double(v2[i])); }
+    const double bound = 2.0 * static_cast<double>(n) * std::numeric_limits<F>::epsilon() * mag;
+    const double diff = std::abs (double(got) - double(ref));
+    const bool ok = diff <= bound;
+    if (!ok) { ++cc::bench::failures; }
+    std::cout << "  Sum with " << backend << (ok ? " matches" : " is WRONG against") << " the serial executor's: differs by "
+              << diff << " (bound " << bound << ")" << std::endl;
+}
+
+// Outer loop over nvec vectors, each doing a parallel scale with exec
+template <typename Outer, typename Inner>
+void run_nested (const std::string& backend, Outer& outer, Inner& inner, size_t n, int reps)
+{
+    const size_t nvec = 16;
+    std::vector<morph::vVector<F>> in(nvec, morph::vVector<F>(n));
+    std::vector<morph::vVector<F>> out(nvec, morph::vVector<F>(n));
+    for (auto& v : in) { v.randomize(); }
+
+    steady_clock::time_point start = steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        outer.parallel_for (nvec, 1, [&](size_t b, size_t e) {
+            for (size_t j = b; j < e; ++j) { cc::par::scale (inner, in[j], static_cast<F>(r), out[j], 8192); }
+        });
+    }
+    steady_clock::duration d = steady_clock::now() - start;
+    std::cout << "  Nested scalar mult took " << duration_cast<microseconds>(d).count() << " us with " << backend << std::endl;
+
+    // out[j] holds the last rep's in[j] * (reps - 1)
+    cc::serial_executor serial;
+    morph::vVector<F> want(n);
+    for (size_t j = 0; j < nvec; ++j) {
+        cc::par::scale (serial, in[j], static_cast<F>(reps - 1), want, 8192);
+        check ("Nested scalar mult of vector " + std::to_string (j), backend, out[j], want);
+    }
+}
+
+int main()
+{
+    cc::serial_executor serial;
+#ifdef _OPENMP
+    cc::openmp_executor omp;
+#endif
+    cc::thread_pool pool;
+    cc::thread_pool app_pool;
+    cc::function_executor app ([&app_pool](std::function<void()> t) { app_pool.submit (std::move (t)); });
+    std::cout << "Thread pool has " << pool.size() << " threads" << std::endl;
+
+    for (size_t n : { size_t{4}, size_t{1000}, size_t{100000}, size_t{1000000} }) {
+        const int reps = n < 100000 ? 10000 : 500;
+        std::cout << "Vector length " << n << ", " << reps << " reps:" << std::endl;
+
+        // vVector's built in OpenMP path, for reference
+        morph::vVector<F> v(n), v2(n);
+        v.randomize();
+        steady_clock::time_point start = steady_clock::now();
+        for (int i = 0; i < reps; ++i) { v.mult (static_cast<F>(i), v2); }
+        steady_clock::duration d = steady_clock::now() - start;
+        std::cout << "  Scalar mult took " << duration_cast<microseconds>(d).count() << " us with vVector::mult" << std::endl;
+
+        run ("serial", serial, n, reps);
+#ifdef _OPENMP
+        run ("OpenMP", omp, n, reps);
+#endif
+        run ("thread_pool", pool, n, reps);
+        run ("function_executor", app, n, reps);
+    }
+
+    std::cout << "Nested parallelism, 16 vectors of 100000:" << std::endl;
+    run_nested ("serial/serial", serial, serial, 100000, 100);
+#ifdef _OPENMP
+    run_nested ("OpenMP/OpenMP", omp, omp, 100000, 100);
+#endif
+    run_nested ("thread_pool/thread_pool", pool, pool, 100000, 100);
+
+    return cc::bench::failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Elementwise kernels specialised on a vector length known at compile time, like
+ * morph::Vector<T, N>'s N, or the 8192 of exerciseEigen.cpp.
+ *
+ * cc::fixed::scale<N>(a, s, out) and friends have a constant trip count, so the compiler
+ * emits no tail handling, and they assume a, b and out are aligned to cc::fixed::alignment
+ * bytes (as they are in a vVector with USE_ALIGNED_ALLOCATOR). Up to full_unroll_max
+ * elements the loop is unrolled completely; beyond that, N being a multiple of the SIMD
+ * width still removes the remainder loop.
+ *
+ * For lengths known only at run time, cc::fixed::scale(a, s, out) etc. on vVectors look
+ * the length up in a table of power-of-two specialisations (4 to 65536 elements) and
+ * fall back to a generic loop for other lengths or for unaligned data.
+ *
+ * The pointer kernels take __restrict__ pointers: out's N elements must not overlap a's or
+ * b's at all, and calling them in place (out == a), or on ranges offset into the same
+ * buffer, is undefined behaviour. The vVector overloads check the ranges and send any call
+ * whose out overlaps an input (such as cc::fixed::scale (v, s, v)) to the generic loop.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <array>
+#include <utility>
+#include <cstdint>
+#include <stdexcept>
+
+namespace cc {
+    namespace fixed {
+
+        //! Alignment that the specialised kernels assume (one AVX2 register)
+        constexpr size_t alignment = 32;
+        //! Lengths up to this are fully unrolled
+        constexpr size_t full_unroll_max = 64;
+        //! The dispatch table covers 2^min_log2 to 2^max_log2 elements
+        constexpr size_t min_log2 = 2;
+        constexpr size_t max_log2 = 16;
+
+        template <typename T>
+        inline bool is_aligned (const T* p) { return (reinterpret_cast<uintptr_t>(p) % alignment) == 0; }
+
+        //! out[i] = a[i] * s for i in [0, N). out[0, N) must not overlap a[0, N) at all.
+        template <size_t N, typename T>
+        inline void scale (const T* __restrict__ a, const T s, T* __restrict__ out)
+        {
+            a = static_cast<const T*>(__builtin_assume_aligned (a, alignment));
+            out = static_cast<T*>(__builtin_assume_aligned (out, alignment));
+            if constexpr (N <= full_unroll_max) {
+#pragma GCC unroll 64
+                for (size_t i = 0; i < N; ++i) { out[i] = a[i] * s; }
+            } else {
+#pragma GCC unroll 4
+                for (size_t i = 0; i < N; ++i) { out[i] = a[i] * s; }
+            }
+        }
+
+        //! out[i] = a[i] * b[i] for i in [0, N). out[0, N) must not overlap a[0, N) or b[0, N) at all.
+        template <size_t N, typename T>
+        inline void mult (const T* __restrict__ a, const T* __restrict__ b, T* __restrict__ out)
+        {
+            a = static_cast<const T*>(__builtin_assume_aligned (a, alignment));
+            b = static_cast<const T*>(__builtin_assume_aligned (b, alignment));
+            out = static_cast<T*>(__builtin_assume_aligned (out, alignment));
+            if constexpr (N <= full_unroll_max) {
+#pragma GCC unroll 64
+                for (size_t i = 0; i < N; ++i) { out[i] = a[i] * b[i]; }
+            } else {
+#pragma GCC unroll 4
+                for (size_t i = 0; i < N; ++i) { out[i] = a[i] * b[i]; }
+            }
+        }
+
+        //! out[i] = a[i] / b[i] for i in [0, N). out[0, N) must not overlap a[0, N) or b[0, N) at all.
+        template <size_t N, typename T>
+        inline void div (const T* __restrict__ a, const T* __restrict__ b, T* __restrict__ out)
+        {
+            a = static_cast<const T*>(__builtin_assume_aligned (a, alignment));
+            b = static_cast<const T*>(__builtin_assume_aligned (b, alignment));
+            out = static_cast<T*>(__builtin_assume_aligned (out, alignment));
+            if constexpr (N <= full_unroll_max) {
+#pragma GCC unroll 64
+                for (size_t i = 0; i < N; ++i) { out[i] = a[i] / b[i]; }
+            } else {
+#pragma GCC unroll 4
+                for (size_t i = 0; i < N; ++i) { out[i] = a[i] / b[i]; }
+            }
+        }
+
+        namespace detail {
+
+            // Generic (runtime length) fallbacks
+            template <typename T>
+            void scale_any (const T* a, const T s, T* out, size_t n) { for (size_t i = 0; i < n; ++i) { out[i] = a[i] * s; } }
+            template <typename T>
+            void mult_any (const T* a, const T* b, T* out, size_t n) { for (size_t i = 0; i < n; ++i) { out[i] = a[i] * b[i]; } }
+            template <typename T>
+            void div_any (const T* a, const T* b, T* out, size_t n) { for (size_t i = 0; i < n; ++i) { out[i] = a[i] / b[i]; } }
+
+            // Tables of the specialisations, indexed by log2(N) - min_log2
+            constexpr size_t table_size = max_log2 - min_log2 + 1;
+
+            template <typename T, size_t... L>
+            constexpr std::array<void(*)(const T*, const T, T*), table_size> scale_table (std::index_sequence<L...>)
+            {
+                return { &scale<(size_t{1} << (L + min_log2)), T>... };
+            }
+            template <typename T, size_t... L>
+            constexpr std::array<void(*)(const T*, const T*, T*), table_size> mult_table (std::index_sequence<L...>)
+            {
+                return { &mult<(size_t{1} << (L + min_log2)), T>... };
+            }
+            template <typename T, size_t... L>
+            constexpr std::array<void(*)(const T*, const T*, T*), table_size> div_table (std::index_sequence<L...>)
+            {
+                return { &div<(size_t{1} << (L + min_log2)), T>... };
+            }
+
+            //! Do the n element ranges from x and y share any element?
+            template <typename T>
+            inline bool overlap (const T* x, const T* y, size_t n)
+            {
+                const uintptr_t px = reinterpret_cast<uintptr_t>(x), py = reinterpret_cast<uintptr_t>(y);
+                return n > 0 && px < py + n * sizeof(T) && py < px + n * sizeof(T);
+            }
+
+            //! Table index for a length n, or -1 if there's no specialisation for it
+            inline int table_index (size_t n)
+            {
+                if (n == 0 || (n & (n - 1)) != 0) { return -1; }
+                int l = __builtin_ctzll (n);
+                if (l < static_cast<int>(min_log2) || l > static_cast<int>(max_log2)) { return -1; }
+                return l - static_cast<int>(min_log2);
+            }
+
+            template <typename T>
+            void check_sizes (const morph::vVector<T>& a, const morph::vVector<T>& b)
+            {
+                if (a.size() != b.size()) { throw std::runtime_error ("fixed: vVectors must be the same size"); }
+            }
+        } // namespace detail
+
+        //! out = a * s, dispatching to a specialised kernel if a.size() has one (and out doesn't overlap a)
+        template <typename T>
+        void scale (const morph::vVector<T>& a, const T s, morph::vVector<T>& out)
+        {
+            detail::check_sizes (a, out);
+            static constexpr auto table = detail::scale_table<T> (std::make_index_sequence<detail::table_size>{});
+            int ti = detail::table_index (a.size());
+            if (ti >= 0 && is_aligned (a.data()) && is_aligned (out.data()) && !detail::overlap (a.data(), out.data(), a.size())) {
+                table[ti] (a.data(), s, out.data());
+            } else {
+                detail::scale_any (a.data(), s, out.data(), a.size());
+            }
+        }
+
+        //! out = a * b, dispatching to a specialised kernel if a.size() has one (and out overlaps neither a nor b)
+        template <typename T>
+        void mult (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            detail::check_sizes (a, out);
+            detail::check_sizes (b, out);
+            static constexpr auto table = detail::mult_table<T> (std::make_index_sequence<detail::table_size>{});
+            int ti = detail::table_index (a.size());
+            if (ti >= 0 && is_aligned (a.data()) && is_aligned (b.data()) && is_aligned (out.data())
+                && !detail::overlap (a.data(), out.data(), a.size()) && !detail::overlap (b.data(), out.data(), a.size())) {
+                table[ti] (a.data(), b.data(), out.data());
+            } else {
+                detail::mult_any (a.data(), b.data(), out.data(), a.size());
+            }
+        }
+
+        //! out = a / b, dispatching to a specialised kernel if a.size() has one (and out overlaps neither a nor b)
+        template <typename T>
+        void div (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            detail::check_sizes (a, out);
+            detail::check_sizes (b, out);
+            static constexpr auto table = detail::div_table<T> (std::make_index_sequence<detail::table_size>{});
+            int ti = detail::table_index (a.size());
+            if (ti >= 0 && is_aligned (a.data()) && is_aligned (b.data()) && is_aligned (out.data())
+                && !detail::overlap (a.data(), out.data(), a.size()) && !detail::overlap (b.data(), out.data(), a.size())) {
+                table[ti] (a.data(), b.data(), out.data());
+            } else {
+                detail::div_any (a.data(), b.data(), out.data(), a.size());
+            }
+        }
+
+    } // namespace fixed
+} // namespace cc
@@ -0,0 +1,371 @@
+/*
+ * Histograms of a vVector, with fixed width bins or arbitrary (sorted) bin edges. The bin
+ * index of a register of elements is computed with SIMD arithmetic (fixed width) or a
+ * SIMD search of the edges, and the counts go into private sub-histograms: one per
+ * thread, and within a thread one per SIMD lane while those fit in cache, so that the
+ * lanes of a register never increment the same counter. The scalar loop
+ * ++counts[bin(x)] serialises on the store-to-load dependency whenever consecutive
+ * elements land in the same bin, which for skewed data is most of the time.
+ *
+ *   cc::hist::histogram h;
+ *   cc::hist::fixed (a, 0.0f, 1.0f, 100, h);      // 100 bins over [0, 1]
+ *   cc::hist::edges (a, e, h);                    // bins [e[k], e[k+1]), e sorted
+ *   h.counts[k], h.under, h.over
+ *
+ * Both add to h, so that one histogram can collect many steps of a simulation. As with
+ * numpy.histogram the last bin is closed, so hi (or the last edge) is counted in it.
+ * Elements that aren't >= lo (so including NaNs) count as under; those above hi as over.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+#if !defined(__AVX2__)
+# error "histogram.h needs at least -mavx2"
+#endif
+
+namespace cc {
+    namespace hist {
+
+        //! Bin counts, plus the counts of elements below and above the range
+        struct histogram
+        {
+            std::vector<uint64_t> counts;
+            uint64_t under = 0;
+            uint64_t over = 0;
+
+            size_t bins() const { return this->counts.size(); }
+            uint64_t total() const
+            {
+                uint64_t t = this->under + this->over;
+                for (auto c : this->counts) { t += c; }
+                return t;
+            }
+            void clear()
+            {
+                std::fill (this->counts.begin(), this->counts.end(), uint64_t{0});
+                this->under = 0;
+                this->over = 0;
+            }
+        };
+
+        //! Below this many elements, bin on the calling thread
+        inline size_t parallel_min = 1 << 16;
+
+        //! Per-lane sub-histograms are used while a thread's set of them is no bigger than this
+        inline size_t lane_copies_max_bytes = 256 * 1024;
+
+        namespace detail {
+
+            // The bin arithmetic for a register of elements at the widest width compiled for.
+            // Slots are 0 for under, k + 1 for bin k and nbins + 1 for over, kept in the
+            // floating point type until they're stored as int32.
+            template <typename T> struct simd;
+#if defined(__AVX512F__)
+            template <>
+            struct simd<float>
+            {
+                typedef __m512 reg;
+                static constexpr size_t n = 16;
+                static reg load (const float* p) { return _mm512_loadu_ps (p); }
+                static reg set1 (float f) { return _mm512_set1_ps (f); }
+                static reg add (reg a, reg b) { return _mm512_add_ps (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_ps (a, b); }
+                static reg floor (reg a) { return _mm512_roundscale_ps (a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+                //! x P y ? a : b
+                template <int P> static reg select (reg x, reg y, reg a, reg b) { return _mm512_mask_blend_ps (_mm512_cmp_ps_mask (x, y, P), b, a); }
+                //! base[pos], pos holding whole numbers
+                static reg gather (const float* base, reg pos) { return _mm512_i32gather_ps (_mm512_cvttps_epi32 (pos), base, 4); }
+                static void store_slots (int32_t* p, reg s) { _mm512_storeu_si512 (p, _mm512_cvttps_epi32 (s)); }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m512d reg;
+                static constexpr size_t n = 8;
+                static reg load (const double* p) { return _mm512_loadu_pd (p); }
+                static reg set1 (double f) { return _mm512_set1_pd (f); }
+                static reg add (reg a, reg b) { return _mm512_add_pd (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_pd (a, b); }
+                static reg floor (reg a) { return _mm512_roundscale_pd (a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+                template <int P> static reg select (reg x, reg y, reg a, reg b) { return _mm512_mask_blend_pd (_mm512_cmp_pd_mask (x, y, P), b, a); }
+                static reg gather (const double* base, reg pos) { return _mm512_i32gather_pd (_mm512_cvttpd_epi32 (pos), base, 8); }
+                static void store_slots (int32_t* p, reg s) { _mm256_storeu_si256 (reinterpret_cast<__m256i*>(p), _mm512_cvttpd_epi32 (s)); }
+            };
+#else
+            template <>
+            struct simd<float>
+            {
+                typedef __m256 reg;
+                static constexpr size_t n = 8;
+                static reg load (const float* p) { return _mm256_loadu_ps (p); }
+                static reg set1 (float f) { return _mm256_set1_ps (f); }
+                static reg add (reg a, reg b) { return _mm256_add_ps (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_ps (a, b); }
+                static reg floor (reg a) { return _mm256_floor_ps (a); }
+                template <int P> static reg select (reg x, reg y, reg a, reg b) { return _mm256_blendv_ps (b, a, _mm256_cmp_ps (x, y, P)); }
+                static reg gather (const float* base, reg pos) { return _mm256_i32gather_ps (base, _mm256_cvttps_epi32 (pos), 4); }
+                static void store_slots (int32_t* p, reg s) { _mm256_storeu_si256 (reinterpret_cast<__m256i*>(p), _mm256_cvttps_epi32 (s)); }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m256d reg;
+                static constexpr size_t n = 4;
+                static reg load (const double* p) { return _mm256_loadu_pd (p); }
+                static reg set1 (double f) { return _mm256_set1_pd (f); }
+                static reg add (reg a, reg b) { return _mm256_add_pd (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_pd (a, b); }
+                static reg floor (reg a) { return _mm256_floor_pd (a); }
+                template <int P> static reg select (reg x, reg y, reg a, reg b) { return _mm256_blendv_pd (b, a, _mm256_cmp_pd (x, y, P)); }
+                static reg gather (const double* base, reg pos) { return _mm256_i32gather_pd (base, _mm256_cvttpd_epi32 (pos), 8); }
+                static void store_slots (int32_t* p, reg s) { _mm_storeu_si128 (reinterpret_cast<__m128i*>(p), _mm256_cvttpd_epi32 (s)); }
+            };
+#endif
+
+            //! Fixed width bins: slot = 1 + min(floor((x - lo) * scale), nbins - 1), or under/over
+            template <typename T>
+            struct fixed_binner
+            {
+                typedef simd<T> S;
+                T lo, hi, scale;
+                size_t nbins;
+                typename S::reg vlo, vhi, vscale, vzero, vlast, vone, vover;
+
+                fixed_binner (T lo_, T hi_, size_t nbins_)
+                    : lo(lo_), hi(hi_), scale(static_cast<T>(nbins_) / (hi_ - lo_)), nbins(nbins_)
+                {
+                    this->vlo = S::set1 (this->lo);
+                    this->vhi = S::set1 (this->hi);
+                    this->vscale = S::set1 (this->scale);
+                    this->vzero = S::set1 (T{0});
+                    this->vlast = S::set1 (static_cast<T>(nbins_ - 1));
+                    this->vone = S::set1 (T{1});
+                    this->vover = S::set1 (static_cast<T>(nbins_ + 1));
+                }
+                size_t slots() const { return this->nbins + 2; }
+
+                typename S::reg slot (typename S::reg x) const
+                {
+                    typename S::reg f = S::floor (S::mul (S::sub (x, this->vlo), this->vscale));
+                    f = S::add (S::min (S::max (f, this->vzero), this->vlast), this->vone);
+                    f = S::template select<_CMP_GE_OQ> (x, this->vlo, f, this->vzero);
+                    return S::template select<_CMP_GT_OQ> (x, this->vhi, this->vover, f);
+                }
+                size_t slot (T x) const
+                {
+                    if (!(x >= this->lo)) { return 0; }
+                    if (x > this->hi) { return this->nbins + 1; }
+                    T f = std::floor ((x - this->lo) * this->scale);
+                    return 1 + static_cast<size_t>(std::min (f, static_cast<T>(this->nbins - 1)));
+                }
+            };
+
+            //! Arbitrary edges: slot = the number of edges <= x, less one if x is the last edge
+            template <typename T>
+            struct edge_binner
+            {
+                typedef simd<T> S;
+                //! Below this many edges, compare against each in turn rather than searching
+                static constexpr size_t linear_max = 16;
+
+                std::vector<T> e;     // the edges, padded with +inf to a power of two for the search
+                size_t n_edges, span;
+                typename S::reg vlast, vone, vzero, vn;
+
+                edge_binner (const std::vector<T>& edges_) : e(edges_), n_edges(edges_.size())
+                {
+                    if (this->n_edges < 2) { throw std::runtime_error ("hist: need at least two edges"); }
+                    if (!std::is_sorted (edges_.begin(), edges_.end())) { throw std::runtime_error ("hist: edges must be sorted"); }
+                    this->span = 1;
+                    while (this->span < this->n_edges) { this->span <<= 1; }
+                    this->e.resize (this->span, std::numeric_limits<T>::infinity());
+                    this->vlast = S::set1 (edges_.back());
+                    this->vone = S::set1 (T{1});
+                    this->vzero = S::set1 (T{0});
+                    this->vn = S::set1 (static_cast<T>(this->n_edges));
+                }
+                size_t slots() const { return this->n_edges + 1; }
+
+                typename S::reg slot (typename S::reg x) const
+                {
+                    typename S::reg c = this->vzero;
+                    if (this->n_edges <= linear_max) {
+                        // A broadcast from memory per edge is as cheap as keeping them in registers
+                        for (size_t k = 0; k < this->n_edges; ++k) { c = S::add (c, S::template select<_CMP_GE_OQ> (x, S::set1 (this->e[k]), this->vone, this->vzero)); }
+                    } else {
+                        // Branchless binary search for the count of edges <= x. The padding is
+                        // +inf, so only an infinite x can count it, and the min takes that back off.
+                        for (size_t step = this->span >> 1; step > 0; step >>= 1) {
+                            const typename S::reg st = S::set1 (static_cast<T>(step));
+                            const typename S::reg probe = S::gather (this->e.data(), S::sub (S::add (c, st), this->vone));
+                            c = S::add (c, S::template select<_CMP_GE_OQ> (x, probe, st, this->vzero));
+                        }
+                        c = S::add (c, S::template select<_CMP_GE_OQ> (x, S::gather (this->e.data(), c), this->vone, this->vzero));
+                        c = S::min (c, this->vn);
+                    }
+                    return S::sub (c, S::template select<_CMP_EQ_OQ> (x, this->vlast, this->vone, this->vzero));
+                }
+                size_t slot (T x) const
+                {
+                    size_t c = std::upper_bound (this->e.begin(), this->e.begin() + this->n_edges, x) - this->e.begin();
+                    if (x == this->e[this->n_edges - 1]) { --c; }
+                    return x >= this->e[0] ? c : 0;
+                }
+            };
+
+            /*!
+             * Count the slots of a[i0, i1) into c, which has L interleaved sub-histograms
+             * (c[slot * L + lane]), so that the lanes of one register never collide. The counts
+             * are 32 bit; the caller folds them before they can overflow.
+             */
+            template <size_t L, typename T, typename B>
+            void count_range (const T* a, size_t i0, size_t i1, const B& b, uint32_t* c)
+            {
+                typedef simd<T> S;
+                static_assert (L == 1 || L == S::n, "one sub-histogram per thread, or one per lane");
+                alignas(64) int32_t s[S::n];
+                size_t i = i0;
+                for (; i + S::n <= i1; i += S::n) {
+                    S::store_slots (s, b.slot (S::load (a + i)));
+                    for (size_t j = 0; j < S::n; ++j) { ++c[static_cast<size_t>(s[j]) * L + (L == 1 ? 0 : j)]; }
+                }
+                for (; i < i1; ++i) { ++c[b.slot (a[i]) * L]; }
+            }
+
+            //! Sum the L interleaved sub-histograms of c into the slots of h, and zero c
+            template <size_t L>
+            void fold (uint32_t* c, size_t slots, std::vector<uint64_t>& h)
+            {
+                for (size_t k = 0; k < slots; ++k) {
+                    uint64_t t = 0;
+                    for (size_t j = 0; j < L; ++j) { t += c[k * L + j]; c[k * L + j] = 0; }
+                    h[k] += t;
+                }
+            }
+
+            //! Bin a[i0, i1) into the slot totals h, on the calling thread
+            template <size_t L, typename T, typename B>
+            void bin_range (const T* a, size_t i0, size_t i1, const B& b, std::vector<uint64_t>& h)
+            {
+                // No more than 2^31 counts per block keeps the 32 bit sub-histogram counters safe
+                constexpr size_t block = size_t{1} << 31;
+                const size_t slots = b.slots();
+                std::vector<uint32_t> c (slots * L, 0u);
+                for (size_t i = i0; i < i1; i += block) {
+                    count_range<L> (a, i, std::min (i1, i + block), b, c.data());
+                    fold<L> (c.data(), slots, h);
+                }
+            }
+
+            template <size_t L, typename T, typename B>
+            void bin (const morph::vVector<T>& a, const B& b, std::vector<uint64_t>& h)
+            {
+                const size_t n = a.size();
+                const T* ap = a.data();
+#ifdef _OPENMP
+                const int nt = omp_get_max_threads();
+#else
+                const int nt = 1;
+#endif
+                if (nt == 1 || n < parallel_min) {
+                    bin_range<L> (ap, 0, n, b, h);
+                    return;
+                }
+                // One block per thread, split on register boundaries, each with its own totals
+                const size_t nr = n / simd<T>::n;
+                std::vector<std::vector<uint64_t>> mine (nt, std::vector<uint64_t>(h.size(), uint64_t{0}));
+#pragma omp parallel for schedule(static)
+                for (int t = 0; t < nt; ++t) {
+                    const size_t i0 = (nr * t / nt) * simd<T>::n;
+                    const size_t i1 = t + 1 == nt ? n : (nr * (t + 1) / nt) * simd<T>::n;
+                    bin_range<L> (ap, i0, i1, b, mine[t]);
+                }
+                for (int t = 0; t < nt; ++t) {
+                    for (size_t k = 0; k < h.size(); ++k) { h[k] += mine[t][k]; }
+                }
+            }
+
+            //! Bin a with b and add the result to out
+            template <typename T, typename B>
+            void run (const morph::vVector<T>& a, const B& b, histogram& out)
+            {
+                const size_t slots = b.slots();
+                if (out.counts.empty()) {
+                    out.counts.assign (slots - 2, uint64_t{0});
+                } else if (out.counts.size() != slots - 2) {
+                    throw std::runtime_error ("hist: histogram has a different number of bins");
+                }
+                std::vector<uint64_t> h (slots, uint64_t{0});
+                if (slots * simd<T>::n * sizeof(uint32_t) <= lane_copies_max_bytes) {
+                    bin<simd<T>::n> (a, b, h);
+                } else {
+                    // Too many bins for a copy per lane to stay in cache; with this many, lanes rarely collide anyway
+                    bin<1> (a, b, h);
+                }
+                out.under += h[0];
+                for (size_t k = 0; k + 2 < slots; ++k) { out.counts[k] += h[k + 1]; }
+                out.over += h[slots - 1];
+            }
+        } // namespace detail
+
+        //! Add a to h, binned into nbins equal width bins over [lo, hi]
+        template <typename T>
+        void fixed (const morph::vVector<T>& a, const T lo, const T hi, const size_t nbins, histogram& h)
+        {
+            if (nbins == 0) { throw std::runtime_error ("hist: need at least one bin"); }
+            if (nbins >= (size_t{1} << 24)) { throw std::runtime_error ("hist: too many bins"); }
+            if (!(hi > lo)) { throw std::runtime_error ("hist: need lo < hi"); }
+            detail::run (a, detail::fixed_binner<T> (lo, hi, nbins), h);
+        }
+
+        //! Add a to h, binned into [e[k], e[k+1]) for sorted edges e, the last bin closed
+        template <typename T>
+        void edges (const morph::vVector<T>& a, const std::vector<T>& e, histogram& h)
+        {
+            if (e.size() >= (size_t{1} << 24)) { throw std::runtime_error ("hist: too many bins"); }
+            detail::run (a, detail::edge_binner<T> (e), h);
+        }
+
+        //! The histogram of a in nbins equal width bins over [lo, hi]
+        template <typename T>
+        histogram fixed (const morph::vVector<T>& a, const T lo, const T hi, const size_t nbins)
+        {
+            histogram h;
+            fixed (a, lo, hi, nbins, h);
+            return h;
+        }
+
+        //! The histogram of a in the bins between the sorted edges e
+        template <typename T>
+        histogram edges (const morph::vVector<T>& a, const std::vector<T>& e)
+        {
+            histogram h;
+            edges (a, e, h);
+            return h;
+        }
+
+    } // namespace hist
+} // namespace cc
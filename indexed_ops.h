@@ -0,0 +1,447 @@
+/*
+ * Indexed access to vVector fields: gather, scatter and scatter-add through an index
+ * vector, permutations, and locality-improving renumberings to apply once to a mesh.
+ *
+ *   morph::vVector<float> f(n_nodes), g, acc(n_nodes);
+ *   morph::vVector<uint32_t> nb;                   // e.g. each element's node numbers
+ *   cc::indexed::check (nb, f.size());            // once, as the kernels don't bounds check
+ *   cc::indexed::gather (f, nb, g);               // g[k] = f[nb[k]]
+ *   cc::indexed::scatter (g, nb, f);              // f[nb[k]] = g[k]
+ *   cc::indexed::scatter_add (g, nb, acc);        // acc[nb[k]] += g[k], repeats and all
+ *
+ * Gathers use the hardware gather instructions. Scatters need AVX-512 (vpscatter) and are
+ * scalar loops without it. A vectorised scatter-add needs AVX-512CD too (vpconflict finds
+ * the lanes of a register that share an index, so that each repeat is added in turn), and
+ * is only used if cc::indexed::vector_scatter_add is set.
+ *
+ * Gathers and scatters hit a cache line per element unless neighbouring indices are close,
+ * so the ordering of the nodes matters as much as the instructions. Renumber once:
+ *
+ *   morph::vVector<uint32_t> p, q;
+ *   cc::indexed::hilbert_order (x, y, p);         // or morton_order (x, y, z, p), or
+ *   cc::indexed::first_touch_order (nb, n, p);    // with no coordinates, by first use in nb
+ *   cc::indexed::inverse (p, q);
+ *   cc::indexed::permute (f, p, f2);              // f2[i] = f[p[i]]: fields in the new order
+ *   cc::indexed::renumber (nb, q);                // nb[k] = q[nb[k]]: indices to match
+ *
+ * Indices are 32 bit (int32_t or uint32_t). Gathers of floats treat them as signed, so a
+ * float source is limited to 2^31 elements. With duplicate indices, which of the values
+ * scatter stores is unspecified once OpenMP splits the work. scatter_add sums in a
+ * different order when threaded, so float results can differ in the last bits.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include "sort_ops.h"
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+#if !defined(__AVX2__)
+# error "indexed_ops.h needs at least -mavx2"
+#endif
+
+namespace cc {
+    namespace indexed {
+
+        //! Below this many indices, scatter_add runs on the calling thread
+        inline size_t parallel_min = 1 << 16;
+
+        /*!
+         * Use the AVX-512CD scatter-add kernel (when compiled in) rather than scalar adds. Off by
+         * default: on the hosts we've measured, each register's gather waits for the previous
+         * register's scatter to retire, and it is no faster than the scalar loop (see exercise_gather).
+         */
+        inline bool vector_scatter_add = false;
+
+        namespace detail {
+
+            //! Elements per OpenMP chunk, a multiple of every register width
+            constexpr size_t chunk = 16384;
+
+            // Indexed loads and stores for a register of T at the widest width compiled for.
+            // idx is a register of n indices, widened to 64 bits where T is. scatter is only
+            // defined where has_scatter is true and scatter_add where has_conflict is, so a
+            // caller that doesn't check those fails to compile rather than dropping the stores.
+            template <typename T> struct simd;
+#if defined(__AVX512F__)
+            template <>
+            struct simd<float>
+            {
+                typedef __m512 reg;
+                typedef __m512i idx;
+                static constexpr size_t n = 16;
+                static constexpr bool has_scatter = true;
+                static idx load_idx (const uint32_t* p) { return _mm512_loadu_si512 (p); }
+                static void store (float* p, reg v) { _mm512_storeu_ps (p, v); }
+                static reg load (const float* p) { return _mm512_loadu_ps (p); }
+                static reg gather (const float* base, idx ix) { return _mm512_i32gather_ps (ix, base, 4); }
+                static void scatter (float* base, idx ix, reg v) { _mm512_i32scatter_ps (base, ix, v, 4); }
+# if defined(__AVX512CD__)
+                static constexpr bool has_conflict = true;
+                /*!
+                 * base[ix] += v, lane by lane. vpconflictd sets bit j of lane i where an earlier
+                 * lane j has the same index. Each pass adds the lanes with no such lane left to
+                 * do, which are all different, so a register with k repeats of an index takes k passes.
+                 */
+                static void scatter_add (float* base, idx ix, reg v)
+                {
+                    const __m512i c = _mm512_conflict_epi32 (ix);
+                    __mmask16 todo = 0xffff;
+                    while (todo) {
+                        const __mmask16 m = _mm512_mask_testn_epi32_mask (todo, c, _mm512_set1_epi32 (todo));
+                        const reg g = _mm512_mask_i32gather_ps (_mm512_setzero_ps(), m, ix, base, 4);
+                        _mm512_mask_i32scatter_ps (base, m, ix, _mm512_add_ps (g, v), 4);
+                        todo &= ~m;
+                    }
+                }
+# else
+                static constexpr bool has_conflict = false;
+# endif
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m512d reg;
+                typedef __m512i idx;
+                static constexpr size_t n = 8;
+                static constexpr bool has_scatter = true;
+                static idx load_idx (const uint32_t* p) { return _mm512_cvtepu32_epi64 (_mm256_loadu_si256 (reinterpret_cast<const __m256i*>(p))); }
+                static void store (double* p, reg v) { _mm512_storeu_pd (p, v); }
+                static reg load (const double* p) { return _mm512_loadu_pd (p); }
+                static reg gather (const double* base, idx ix) { return _mm512_i64gather_pd (ix, base, 8); }
+                static void scatter (double* base, idx ix, reg v) { _mm512_i64scatter_pd (base, ix, v, 8); }
+# if defined(__AVX512CD__)
+                static constexpr bool has_conflict = true;
+                static void scatter_add (double* base, idx ix, reg v)
+                {
+                    const __m512i c = _mm512_conflict_epi64 (ix);
+                    __mmask8 todo = 0xff;
+                    while (todo) {
+                        const __mmask8 m = _mm512_mask_testn_epi64_mask (todo, c, _mm512_set1_epi64 (todo));
+                        const reg g = _mm512_mask_i64gather_pd (_mm512_setzero_pd(), m, ix, base, 8);
+                        _mm512_mask_i64scatter_pd (base, m, ix, _mm512_add_pd (g, v), 8);
+                        todo &= ~m;
+                    }
+                }
+# else
+                static constexpr bool has_conflict = false;
+# endif
+            };
+#else
+            template <>
+            struct simd<float>
+            {
+                typedef __m256 reg;
+                typedef __m256i idx;
+                static constexpr size_t n = 8;
+                static constexpr bool has_scatter = false;
+                static constexpr bool has_conflict = false;
+                static idx load_idx (const uint32_t* p) { return _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(p)); }
+                static void store (float* p, reg v) { _mm256_storeu_ps (p, v); }
+                static reg load (const float* p) { return _mm256_loadu_ps (p); }
+                static reg gather (const float* base, idx ix) { return _mm256_i32gather_ps (base, ix, 4); }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m256d reg;
+                typedef __m256i idx;
+                static constexpr size_t n = 4;
+                static constexpr bool has_scatter = false;
+                static constexpr bool has_conflict = false;
+                static idx load_idx (const uint32_t* p) { return _mm256_cvtepu32_epi64 (_mm_loadu_si128 (reinterpret_cast<const __m128i*>(p))); }
+                static void store (double* p, reg v) { _mm256_storeu_pd (p, v); }
+                static reg load (const double* p) { return _mm256_loadu_pd (p); }
+                static reg gather (const double* base, idx ix) { return _mm256_i64gather_pd (base, ix, 8); }
+            };
+#endif
+
+            //! body(i0, i1) for each chunk of [0, n), shared out over OpenMP when there's more than one
+            template <typename Fn>
+            void for_chunks (size_t n, Fn body)
+            {
+                const long long nc = static_cast<long long>((n + chunk - 1) / chunk);
+                if (nc <= 1) {
+                    if (nc == 1) { body (size_t{0}, n); }
+                } else {
+#pragma omp parallel for
+                    for (long long c = 0; c < nc; ++c) { body (c * chunk, std::min (n, static_cast<size_t>(c + 1) * chunk)); }
+                }
+            }
+
+            template <typename I>
+            const uint32_t* raw (const morph::vVector<I>& idx)
+            {
+                static_assert (std::is_integral<I>::value && sizeof(I) == 4, "indexed: indices must be 32 bit integers");
+                return reinterpret_cast<const uint32_t*>(idx.data());
+            }
+
+            //! Registers whose first and last indices are closer than this take the scalar path in scatter_add
+            constexpr int64_t local_span = 256;
+
+            //! out[ix[i]] += v[i] for i in [i0, i1), on the calling thread
+            template <typename T>
+            void scatter_add_range (const T* v, const uint32_t* ix, size_t i0, size_t i1, T* out)
+            {
+                typedef simd<T> S;
+                size_t i = i0;
+                if constexpr (S::has_conflict) {
+                    for (; vector_scatter_add && i + S::n <= i1; i += S::n) {
+                        // Where the register's indices are close together (sorted or well
+                        // ordered), the next one's gather would wait on this one's scatter to
+                        // the same lines, and the scalar adds are faster
+                        const int64_t span = static_cast<int64_t>(ix[i + S::n - 1]) - ix[i];
+                        if (span > -local_span && span < local_span) {
+                            for (size_t j = i; j < i + S::n; ++j) { out[ix[j]] += v[j]; }
+                        } else {
+                            S::scatter_add (out, S::load_idx (ix + i), S::load (v + i));
+                        }
+                    }
+                }
+                for (; i < i1; ++i) { out[ix[i]] += v[i]; }
+            }
+
+            //! Sort order of 31 bit keys, as a permutation p (p[0] is the index of the smallest key)
+            inline void order_by (const std::vector<uint32_t>& key, morph::vVector<uint32_t>& p)
+            {
+                const size_t n = key.size();
+                morph::vVector<int64_t> packed (n);
+                for (size_t i = 0; i < n; ++i) { packed[i] = (static_cast<int64_t>(key[i]) << 32) | i; }
+                cc::order::sort (packed);
+                if (p.size() != n) { p.resize (n); }
+                for (size_t i = 0; i < n; ++i) { p[i] = static_cast<uint32_t>(packed[i]); }
+            }
+
+            //! x quantised to [0, 2^bits) over [lo, hi]
+            template <typename T>
+            uint32_t quantise (T x, T lo, T hi, int bits)
+            {
+                const double top = static_cast<double>((uint32_t{1} << bits) - 1);
+                const double f = hi > lo ? (static_cast<double>(x) - lo) / (static_cast<double>(hi) - lo) : 0.0;
+                return static_cast<uint32_t>(std::min (top, std::max (0.0, f * top)));
+            }
+
+            template <typename T>
+            void bounds (const morph::vVector<T>& x, T& lo, T& hi)
+            {
+                const auto mm = std::minmax_element (x.begin(), x.end());
+                lo = *mm.first;
+                hi = *mm.second;
+            }
+
+            //! Position of (x, y) along the Hilbert curve through a 2^bits square
+            inline uint32_t hilbert_d (uint32_t x, uint32_t y, int bits)
+            {
+                uint32_t d = 0;
+                for (uint32_t s = uint32_t{1} << (bits - 1); s > 0; s /= 2) {
+                    const uint32_t rx = (x & s) > 0, ry = (y & s) > 0;
+                    d += s * s * ((3 * rx) ^ ry);
+                    // Rotate the quadrant so the curve inside it runs the right way
+                    if (ry == 0) {
+                        if (rx == 1) {
+                            x = s - 1 - (x & (s - 1));
+                            y = s - 1 - (y & (s - 1));
+                        }
+                        std::swap (x, y);
+                    }
+                }
+                return d;
+            }
+
+            //! The bits of x spread out to every third bit
+            inline uint32_t spread3 (uint32_t x)
+            {
+                x &= 0x3ff;
+                x = (x | (x << 16)) & 0x030000ff;
+                x = (x | (x << 8)) & 0x0300f00f;
+                x = (x | (x << 4)) & 0x030c30c3;
+                x = (x | (x << 2)) & 0x09249249;
+                return x;
+            }
+
+            template <typename A, typename B>
+            void check_sizes (const A& a, const B& b)
+            {
+                if (a.size() != b.size()) { throw std::runtime_error ("indexed: vectors must be the same size"); }
+            }
+        } // namespace detail
+
+        //! Throw unless every index in idx is in [0, n)
+        template <typename I>
+        void check (const morph::vVector<I>& idx, size_t n)
+        {
+            for (I k : idx) {
+                if (k < 0 || static_cast<uint64_t>(k) >= n) {
+                    throw std::runtime_error ("indexed: index " + std::to_string (k) + " out of range for " + std::to_string (n) + " elements");
+                }
+            }
+        }
+
+        //! out[k] = src[idx[k]]
+        template <typename T, typename I>
+        void gather (const morph::vVector<T>& src, const morph::vVector<I>& idx, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            if (out.size() != idx.size()) { out.resize (idx.size()); }
+            const T* sp = src.data();
+            const uint32_t* ix = detail::raw (idx);
+            T* op = out.data();
+            detail::for_chunks (idx.size(), [&](size_t i, size_t hi) {
+                for (; i + S::n <= hi; i += S::n) { S::store (op + i, S::gather (sp, S::load_idx (ix + i))); }
+                for (; i < hi; ++i) { op[i] = sp[ix[i]]; }
+            });
+        }
+
+        //! out[idx[k]] = src[k]. out must already be big enough.
+        template <typename T, typename I>
+        void scatter (const morph::vVector<T>& src, const morph::vVector<I>& idx, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::check_sizes (src, idx);
+            const T* sp = src.data();
+            const uint32_t* ix = detail::raw (idx);
+            T* op = out.data();
+            detail::for_chunks (idx.size(), [&](size_t i, size_t hi) {
+                if constexpr (S::has_scatter) {
+                    for (; i + S::n <= hi; i += S::n) { S::scatter (op, S::load_idx (ix + i), S::load (sp + i)); }
+                }
+                for (; i < hi; ++i) { op[ix[i]] = sp[i]; }
+            });
+        }
+
+        /*!
+         * out[idx[k]] += src[k], for every k, repeated indices included. out must already be
+         * big enough. Threads each add into a private copy of out, which are then summed, so
+         * that's only done when out is no bigger than src split between the threads.
+         */
+        template <typename T, typename I>
+        void scatter_add (const morph::vVector<T>& src, const morph::vVector<I>& idx, morph::vVector<T>& out)
+        {
+            detail::check_sizes (src, idx);
+            const size_t n = src.size();
+            const T* sp = src.data();
+            const uint32_t* ix = detail::raw (idx);
+#ifdef _OPENMP
+            const int nt = omp_get_max_threads();
+#else
+            const int nt = 1;
+#endif
+            if (nt == 1 || n < parallel_min || out.size() * nt > n) {
+                detail::scatter_add_range (sp, ix, 0, n, out.data());
+                return;
+            }
+            const size_t m = out.size();
+            std::vector<std::vector<T>> mine (nt);
+#pragma omp parallel for schedule(static)
+            for (int t = 0; t < nt; ++t) {
+                mine[t].assign (m, T{0});
+                detail::scatter_add_range (sp, ix, n * t / nt, n * (t + 1) / nt, mine[t].data());
+            }
+            T* op = out.data();
+            detail::for_chunks (m, [&](size_t k0, size_t k1) {
+                for (int t = 0; t < nt; ++t) {
+                    const T* c = mine[t].data();
+                    for (size_t k = k0; k < k1; ++k) { op[k] += c[k]; }
+                }
+            });
+        }
+
+        //! out[i] = a[p[i]], for a permutation p of a's indices
+        template <typename T, typename I>
+        void permute (const morph::vVector<T>& a, const morph::vVector<I>& p, morph::vVector<T>& out)
+        {
+            detail::check_sizes (a, p);
+            gather (a, p, out);
+        }
+
+        //! q, the inverse of the permutation p: q[p[i]] = i
+        template <typename I>
+        void inverse (const morph::vVector<I>& p, morph::vVector<I>& q)
+        {
+            if (q.size() != p.size()) { q.resize (p.size()); }
+            const long long n = static_cast<long long>(p.size());
+#pragma omp parallel for
+            for (long long i = 0; i < n; ++i) { q[p[i]] = static_cast<I>(i); }
+        }
+
+        //! idx[k] = q[idx[k]]: the same references after the elements are renumbered by q
+        template <typename I>
+        void renumber (morph::vVector<I>& idx, const morph::vVector<I>& q)
+        {
+            const long long n = static_cast<long long>(idx.size());
+#pragma omp parallel for
+            for (long long k = 0; k < n; ++k) { idx[k] = q[idx[k]]; }
+        }
+
+        /*!
+         * Number n elements in the order idx first refers to them (those it never does go
+         * last, in their old order), as a permutation p: new element i is old element p[i].
+         * A gather through the renumbered idx then walks the source nearly in order.
+         */
+        template <typename I>
+        void first_touch_order (const morph::vVector<I>& idx, size_t n, morph::vVector<I>& p)
+        {
+            std::vector<bool> seen (n, false);
+            p.clear();
+            p.reserve (n);
+            for (I k : idx) {
+                if (!seen[k]) {
+                    seen[k] = true;
+                    p.push_back (k);
+                }
+            }
+            for (size_t k = 0; k < n; ++k) {
+                if (!seen[k]) { p.push_back (static_cast<I>(k)); }
+            }
+        }
+
+        //! The order of the points (x[i], y[i]) along a Hilbert curve over their bounding box, as a permutation p
+        template <typename T>
+        void hilbert_order (const morph::vVector<T>& x, const morph::vVector<T>& y, morph::vVector<uint32_t>& p)
+        {
+            detail::check_sizes (x, y);
+            if (x.empty()) { p.clear(); return; }
+            // 2^15 cells a side keeps the curve position in 30 bits, to pack with a 32 bit index
+            constexpr int bits = 15;
+            T x0, x1, y0, y1;
+            detail::bounds (x, x0, x1);
+            detail::bounds (y, y0, y1);
+            std::vector<uint32_t> key (x.size());
+            for (size_t i = 0; i < x.size(); ++i) {
+                key[i] = detail::hilbert_d (detail::quantise (x[i], x0, x1, bits), detail::quantise (y[i], y0, y1, bits), bits);
+            }
+            detail::order_by (key, p);
+        }
+
+        //! The order of the points (x[i], y[i], z[i]) along a Morton (Z order) curve over their bounding box
+        template <typename T>
+        void morton_order (const morph::vVector<T>& x, const morph::vVector<T>& y, const morph::vVector<T>& z, morph::vVector<uint32_t>& p)
+        {
+            detail::check_sizes (x, y);
+            detail::check_sizes (x, z);
+            if (x.empty()) { p.clear(); return; }
+            constexpr int bits = 10;
+            T x0, x1, y0, y1, z0, z1;
+            detail::bounds (x, x0, x1);
+            detail::bounds (y, y0, y1);
+            detail::bounds (z, z0, z1);
+            std::vector<uint32_t> key (x.size());
+            for (size_t i = 0; i < x.size(); ++i) {
+                key[i] = detail::spread3 (detail::quantise (x[i], x0, x1, bits))
+                    | (detail::spread3 (detail::quantise (y[i], y0, y1, bits)) << 1)
+                    | (detail::spread3 (detail::quantise (z[i], z0, z1, bits)) << 2);
+            }
+            detail::order_by (key, p);
+        }
+
+    } // namespace indexed
+} // namespace cc
@@ -0,0 +1,692 @@
+/*
+ * SIMD kernels for integer vVectors: vVector<int8_t>, <int16_t>, <int32_t> (so vVector<int>)
+ * and <int64_t>. vVector's own operators on these are generic loops which the compiler may
+ * or may not vectorise, which wrap silently on overflow and whose dot and sum accumulate in
+ * the element type. These are written for quantised pipelines, where that's exactly wrong.
+ *
+ *   morph::vVector<int8_t> a(n), b(n), c(n);
+ *   cc::ints::add (a, b, c);                   // c = a + b, wrapping, as two's complement
+ *   cc::ints::mult (a, b, c);                  // c = a * b, the low 8 bits of each product
+ *   cc::ints::adds (a, b, c);                  // c = a + b, saturating at -128 and 127
+ *   cc::ints::subs (a, b, c);                  // c = a - b, saturating
+ *   cc::ints::min (a, b, c);                   // and max, elementwise
+ *   int8_t lo = cc::ints::min (a);             // and max, over the whole vector
+ *   int64_t s = cc::ints::sum (a);             // widened, so it can't overflow
+ *   int64_t d = cc::ints::dot (a, b);          // widened, so it can't overflow
+ *
+ * sum and dot return cc::ints::wide<T>::sum_type and dot_type: int64_t, except for the sum
+ * of int64s and the dot products of int32s and int64s, which are __int128. They're exact
+ * for any vector that fits in memory, except that an int64 dot product overflows its
+ * __int128 if it sums more than two products near 2^126.
+ *
+ * Everything runs at 256 bits with AVX2 and at 512 bits with AVX-512BW (8 and 16 bit
+ * lanes need BW). 64 bit products use AVX-512DQ's vpmullq when compiled with -mavx512dq;
+ * otherwise they're built from 32 bit ones. There's no SIMD 64 x 64 -> 128 bit multiply,
+ * so the int64 dot product is a scalar loop.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#if !defined(__AVX2__)
+# error "int_ops.h needs at least -mavx2"
+#endif
+
+namespace cc {
+    namespace ints {
+
+        //! The types sum and dot return for vectors of T
+        template <typename T> struct wide;
+        template <> struct wide<int8_t> { typedef int64_t sum_type; typedef int64_t dot_type; };
+        template <> struct wide<int16_t> { typedef int64_t sum_type; typedef int64_t dot_type; };
+        template <> struct wide<int32_t> { typedef int64_t sum_type; typedef __int128 dot_type; };
+        template <> struct wide<int64_t> { typedef __int128 sum_type; typedef __int128 dot_type; };
+
+        namespace detail {
+
+            //! Elements per OpenMP chunk, a multiple of every register width. The widening
+            //! kernels rely on a chunk being short enough that their 32 bit partial sums can't overflow.
+            constexpr size_t chunk = 16384;
+
+            //! Sum of the 64 bit lanes of a register
+            template <typename R>
+            inline int64_t hsum64 (R v)
+            {
+                int64_t l[sizeof(R) / 8];
+                std::memcpy (l, &v, sizeof(R));
+                int64_t s = 0;
+                for (size_t k = 0; k < sizeof(R) / 8; ++k) { s += l[k]; }
+                return s;
+            }
+            //! Sum of the 32 bit lanes of a register, in 64 bits
+            template <typename R>
+            inline int64_t hsum32 (R v)
+            {
+                int32_t l[sizeof(R) / 4];
+                std::memcpy (l, &v, sizeof(R));
+                int64_t s = 0;
+                for (size_t k = 0; k < sizeof(R) / 4; ++k) { s += l[k]; }
+                return s;
+            }
+            //! lo + hi * 2^32, for lane sums of the low (unsigned) and high (signed) halves of 64 bit values
+            template <typename R>
+            inline __int128 join64 (R lo, R hi)
+            {
+                uint64_t l[sizeof(R) / 8];
+                int64_t h[sizeof(R) / 8];
+                std::memcpy (l, &lo, sizeof(R));
+                std::memcpy (h, &hi, sizeof(R));
+                __int128 s = 0;
+                for (size_t k = 0; k < sizeof(R) / 8; ++k) { s += static_cast<__int128>(h[k]) * (__int128{1} << 32) + l[k]; }
+                return s;
+            }
+
+            /*
+             * Integer arithmetic on registers at the widest width compiled for. Besides the
+             * elementwise ops, each has sum_block and dot_block, which widen nr registers' worth
+             * of elements (nr * n <= chunk) into a partial sum.
+             */
+            template <typename T> struct simd;
+#if defined(__AVX512BW__)
+            //! The 64 bit lane product a * b, from 32 bit products without AVX-512DQ
+            inline __m512i mullo64 (__m512i a, __m512i b)
+            {
+# if defined(__AVX512DQ__)
+                return _mm512_mullo_epi64 (a, b);
+# else
+                const __m512i cross = _mm512_add_epi64 (_mm512_mul_epu32 (a, _mm512_srli_epi64 (b, 32)),
+                                                        _mm512_mul_epu32 (_mm512_srli_epi64 (a, 32), b));
+                return _mm512_add_epi64 (_mm512_mul_epu32 (a, b), _mm512_slli_epi64 (cross, 32));
+# endif
+            }
+            //! Saturate s = a op b where the sign bits of ovf flag overflow: to MIN if a < 0, else MAX
+            inline __m512i saturate32 (__m512i a, __m512i s, __m512i ovf)
+            {
+                const __m512i sat = _mm512_xor_si512 (_mm512_srai_epi32 (a, 31), _mm512_set1_epi32 (std::numeric_limits<int32_t>::max()));
+                return _mm512_mask_blend_epi32 (_mm512_cmplt_epi32_mask (ovf, _mm512_setzero_si512()), s, sat);
+            }
+            inline __m512i saturate64 (__m512i a, __m512i s, __m512i ovf)
+            {
+                const __m512i sat = _mm512_xor_si512 (_mm512_srai_epi64 (a, 63), _mm512_set1_epi64 (std::numeric_limits<int64_t>::max()));
+                return _mm512_mask_blend_epi64 (_mm512_cmplt_epi64_mask (ovf, _mm512_setzero_si512()), s, sat);
+            }
+
+            template <>
+            struct simd<int8_t>
+            {
+                typedef __m512i reg;
+                static constexpr size_t n = 64;
+                static reg load (const int8_t* p) { return _mm512_loadu_si512 (p); }
+                static void store (int8_t* p, reg v) { _mm512_storeu_si512 (p, v); }
+                static reg add (reg a, reg b) { return _mm512_add_epi8 (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_epi8 (a, b); }
+                static reg adds (reg a, reg b) { return _mm512_adds_epi8 (a, b); }
+                static reg subs (reg a, reg b) { return _mm512_subs_epi8 (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_epi8 (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_epi8 (a, b); }
+                //! No 8 bit multiply: the even bytes' products from 16 bit ones, then the odd bytes', already shifted up
+                static reg mul (reg a, reg b)
+                {
+                    const reg even = _mm512_mullo_epi16 (a, b);
+                    const reg odd = _mm512_mullo_epi16 (_mm512_srli_epi16 (a, 8), _mm512_and_si512 (b, _mm512_set1_epi16 (-256)));
+                    return _mm512_or_si512 (_mm512_and_si512 (even, _mm512_set1_epi16 (0xff)), odd);
+                }
+                //! psadbw sums unsigned bytes, so bias each by 128 and take that off at the end
+                static int64_t sum_block (const int8_t* p, size_t nr)
+                {
+                    const reg bias = _mm512_set1_epi8 (-128);
+                    reg acc = _mm512_setzero_si512();
+                    for (size_t k = 0; k < nr; ++k) {
+                        acc = _mm512_add_epi64 (acc, _mm512_sad_epu8 (_mm512_xor_si512 (load (p + k * n), bias), _mm512_setzero_si512()));
+                    }
+                    return hsum64 (acc) - 128 * static_cast<int64_t>(nr * n);
+                }
+                //! Sign extend to 16 bits and pmaddwd: |pair sums| <= 2^15, so 32 bit lanes take a chunk
+                static int64_t dot_block (const int8_t* a, const int8_t* b, size_t nr)
+                {
+                    reg acc = _mm512_setzero_si512();
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg va = load (a + k * n), vb = load (b + k * n);
+                        const reg lo = _mm512_madd_epi16 (_mm512_cvtepi8_epi16 (_mm512_castsi512_si256 (va)),
+                                                          _mm512_cvtepi8_epi16 (_mm512_castsi512_si256 (vb)));
+                        const reg hi = _mm512_madd_epi16 (_mm512_cvtepi8_epi16 (_mm512_extracti64x4_epi64 (va, 1)),
+                                                          _mm512_cvtepi8_epi16 (_mm512_extracti64x4_epi64 (vb, 1)));
+                        acc = _mm512_add_epi32 (acc, _mm512_add_epi32 (lo, hi));
+                    }
+                    return hsum32 (acc);
+                }
+            };
+            template <>
+            struct simd<int16_t>
+            {
+                typedef __m512i reg;
+                static constexpr size_t n = 32;
+                static reg load (const int16_t* p) { return _mm512_loadu_si512 (p); }
+                static void store (int16_t* p, reg v) { _mm512_storeu_si512 (p, v); }
+                static reg add (reg a, reg b) { return _mm512_add_epi16 (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_epi16 (a, b); }
+                static reg adds (reg a, reg b) { return _mm512_adds_epi16 (a, b); }
+                static reg subs (reg a, reg b) { return _mm512_subs_epi16 (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_epi16 (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_epi16 (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mullo_epi16 (a, b); }
+                static int64_t sum_block (const int16_t* p, size_t nr)
+                {
+                    const reg ones = _mm512_set1_epi16 (1);
+                    reg acc = _mm512_setzero_si512();
+                    for (size_t k = 0; k < nr; ++k) { acc = _mm512_add_epi32 (acc, _mm512_madd_epi16 (load (p + k * n), ones)); }
+                    return hsum32 (acc);
+                }
+                /*!
+                 * pmaddwd's pair sums fit in 32 bits except (-2^15)^2 + (-2^15)^2 = 2^31, which wraps
+                 * to INT32_MIN, a value no other pair gives. So widen to 64 bits and add 2^32 for those.
+                 */
+                static int64_t dot_block (const int16_t* a, const int16_t* b, size_t nr)
+                {
+                    reg acc = _mm512_setzero_si512();
+                    int64_t wrapped = 0;
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg m = _mm512_madd_epi16 (load (a + k * n), load (b + k * n));
+                        wrapped += __builtin_popcount (_mm512_cmpeq_epi32_mask (m, _mm512_set1_epi32 (std::numeric_limits<int32_t>::min())));
+                        acc = _mm512_add_epi64 (acc, _mm512_add_epi64 (_mm512_cvtepi32_epi64 (_mm512_castsi512_si256 (m)),
+                                                                       _mm512_cvtepi32_epi64 (_mm512_extracti64x4_epi64 (m, 1))));
+                    }
+                    return hsum64 (acc) + wrapped * (int64_t{1} << 32);
+                }
+            };
+            template <>
+            struct simd<int32_t>
+            {
+                typedef __m512i reg;
+                static constexpr size_t n = 16;
+                static reg load (const int32_t* p) { return _mm512_loadu_si512 (p); }
+                static void store (int32_t* p, reg v) { _mm512_storeu_si512 (p, v); }
+                static reg add (reg a, reg b) { return _mm512_add_epi32 (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_epi32 (a, b); }
+                //! Overflow where a and b have the same sign and the sum has the other
+                static reg adds (reg a, reg b)
+                {
+                    const reg s = add (a, b);
+                    return saturate32 (a, s, _mm512_and_si512 (_mm512_xor_si512 (a, s), _mm512_xor_si512 (b, s)));
+                }
+                //! Overflow where a and b have different signs and the difference has b's
+                static reg subs (reg a, reg b)
+                {
+                    const reg d = sub (a, b);
+                    return saturate32 (a, d, _mm512_and_si512 (_mm512_xor_si512 (a, b), _mm512_xor_si512 (a, d)));
+                }
+                static reg min (reg a, reg b) { return _mm512_min_epi32 (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_epi32 (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mullo_epi32 (a, b); }
+                static int64_t sum_block (const int32_t* p, size_t nr)
+                {
+                    reg acc = _mm512_setzero_si512();
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg v = load (p + k * n);
+                        acc = _mm512_add_epi64 (acc, _mm512_add_epi64 (_mm512_cvtepi32_epi64 (_mm512_castsi512_si256 (v)),
+                                                                       _mm512_cvtepi32_epi64 (_mm512_extracti64x4_epi64 (v, 1))));
+                    }
+                    return hsum64 (acc);
+                }
+                /*!
+                 * pmuldq gives exact 64 bit products of the even lanes (and, shifted down, the odd
+                 * ones). Summing many of those could overflow 64 bits, so accumulate their low
+                 * (unsigned) and high (signed) 32 bit halves separately.
+                 */
+                static __int128 dot_block (const int32_t* a, const int32_t* b, size_t nr)
+                {
+                    const reg low = _mm512_set1_epi64 (0xffffffff);
+                    reg lo = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg va = load (a + k * n), vb = load (b + k * n);
+                        const reg pe = _mm512_mul_epi32 (va, vb);
+                        const reg po = _mm512_mul_epi32 (_mm512_srli_epi64 (va, 32), _mm512_srli_epi64 (vb, 32));
+                        lo = _mm512_add_epi64 (lo, _mm512_add_epi64 (_mm512_and_si512 (pe, low), _mm512_and_si512 (po, low)));
+                        hi = _mm512_add_epi64 (hi, _mm512_add_epi64 (_mm512_srai_epi64 (pe, 32), _mm512_srai_epi64 (po, 32)));
+                    }
+                    return join64 (lo, hi);
+                }
+            };
+            template <>
+            struct simd<int64_t>
+            {
+                typedef __m512i reg;
+                static constexpr size_t n = 8;
+                static reg load (const int64_t* p) { return _mm512_loadu_si512 (p); }
+                static void store (int64_t* p, reg v) { _mm512_storeu_si512 (p, v); }
+                static reg add (reg a, reg b) { return _mm512_add_epi64 (a, b); }
+                static reg sub (reg a, reg b) { return _mm512_sub_epi64 (a, b); }
+                static reg adds (reg a, reg b)
+                {
+                    const reg s = add (a, b);
+                    return saturate64 (a, s, _mm512_and_si512 (_mm512_xor_si512 (a, s), _mm512_xor_si512 (b, s)));
+                }
+                static reg subs (reg a, reg b)
+                {
+                    const reg d = sub (a, b);
+                    return saturate64 (a, d, _mm512_and_si512 (_mm512_xor_si512 (a, b), _mm512_xor_si512 (a, d)));
+                }
+                static reg min (reg a, reg b) { return _mm512_min_epi64 (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_epi64 (a, b); }
+                static reg mul (reg a, reg b) { return mullo64 (a, b); }
+                //! As int32's dot_block: sum the low and high halves separately
+                static __int128 sum_block (const int64_t* p, size_t nr)
+                {
+                    const reg low = _mm512_set1_epi64 (0xffffffff);
+                    reg lo = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg v = load (p + k * n);
+                        lo = _mm512_add_epi64 (lo, _mm512_and_si512 (v, low));
+                        hi = _mm512_add_epi64 (hi, _mm512_srai_epi64 (v, 32));
+                    }
+                    return join64 (lo, hi);
+                }
+            };
+#else
+            //! The 64 bit lane product a * b, from 32 bit products
+            inline __m256i mullo64 (__m256i a, __m256i b)
+            {
+                const __m256i cross = _mm256_add_epi64 (_mm256_mul_epu32 (a, _mm256_srli_epi64 (b, 32)),
+                                                        _mm256_mul_epu32 (_mm256_srli_epi64 (a, 32), b));
+                return _mm256_add_epi64 (_mm256_mul_epu32 (a, b), _mm256_slli_epi64 (cross, 32));
+            }
+            //! AVX2 has no 64 bit arithmetic shift; this is the high half of each 64 bit lane, sign extended
+            inline __m256i high64 (__m256i v)
+            {
+                const __m256i flip = _mm256_set1_epi64x (0x80000000);
+                return _mm256_sub_epi64 (_mm256_xor_si256 (_mm256_srli_epi64 (v, 32), flip), flip);
+            }
+            //! Saturate s = a op b where the sign bits of ovf flag overflow: to MIN if a < 0, else MAX
+            inline __m256i saturate32 (__m256i a, __m256i s, __m256i ovf)
+            {
+                const __m256i sat = _mm256_xor_si256 (_mm256_srai_epi32 (a, 31), _mm256_set1_epi32 (std::numeric_limits<int32_t>::max()));
+                return _mm256_blendv_epi8 (s, sat, _mm256_srai_epi32 (ovf, 31));
+            }
+            inline __m256i saturate64 (__m256i a, __m256i s, __m256i ovf)
+            {
+                const __m256i zero = _mm256_setzero_si256();
+                const __m256i sat = _mm256_xor_si256 (_mm256_cmpgt_epi64 (zero, a), _mm256_set1_epi64x (std::numeric_limits<int64_t>::max()));
+                return _mm256_blendv_epi8 (s, sat, _mm256_cmpgt_epi64 (zero, ovf));
+            }
+
+            template <>
+            struct simd<int8_t>
+            {
+                typedef __m256i reg;
+                static constexpr size_t n = 32;
+                static reg load (const int8_t* p) { return _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(p)); }
+                static void store (int8_t* p, reg v) { _mm256_storeu_si256 (reinterpret_cast<__m256i*>(p), v); }
+                static reg add (reg a, reg b) { return _mm256_add_epi8 (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_epi8 (a, b); }
+                static reg adds (reg a, reg b) { return _mm256_adds_epi8 (a, b); }
+                static reg subs (reg a, reg b) { return _mm256_subs_epi8 (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_epi8 (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_epi8 (a, b); }
+                //! No 8 bit multiply: the even bytes' products from 16 bit ones, then the odd bytes', already shifted up
+                static reg mul (reg a, reg b)
+                {
+                    const reg even = _mm256_mullo_epi16 (a, b);
+                    const reg odd = _mm256_mullo_epi16 (_mm256_srli_epi16 (a, 8), _mm256_and_si256 (b, _mm256_set1_epi16 (-256)));
+                    return _mm256_or_si256 (_mm256_and_si256 (even, _mm256_set1_epi16 (0xff)), odd);
+                }
+                //! psadbw sums unsigned bytes, so bias each by 128 and take that off at the end
+                static int64_t sum_block (const int8_t* p, size_t nr)
+                {
+                    const reg bias = _mm256_set1_epi8 (-128);
+                    reg acc = _mm256_setzero_si256();
+                    for (size_t k = 0; k < nr; ++k) {
+                        acc = _mm256_add_epi64 (acc, _mm256_sad_epu8 (_mm256_xor_si256 (load (p + k * n), bias), _mm256_setzero_si256()));
+                    }
+                    return hsum64 (acc) - 128 * static_cast<int64_t>(nr * n);
+                }
+                //! Sign extend to 16 bits and pmaddwd: |pair sums| <= 2^15, so 32 bit lanes take a chunk
+                static int64_t dot_block (const int8_t* a, const int8_t* b, size_t nr)
+                {
+                    reg acc = _mm256_setzero_si256();
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg va = load (a + k * n), vb = load (b + k * n);
+                        const reg lo = _mm256_madd_epi16 (_mm256_cvtepi8_epi16 (_mm256_castsi256_si128 (va)),
+                                                          _mm256_cvtepi8_epi16 (_mm256_castsi256_si128 (vb)));
+                        const reg hi = _mm256_madd_epi16 (_mm256_cvtepi8_epi16 (_mm256_extracti128_si256 (va, 1)),
+                                                          _mm256_cvtepi8_epi16 (_mm256_extracti128_si256 (vb, 1)));
+                        acc = _mm256_add_epi32 (acc, _mm256_add_epi32 (lo, hi));
+                    }
+                    return hsum32 (acc);
+                }
+            };
+            template <>
+            struct simd<int16_t>
+            {
+                typedef __m256i reg;
+                static constexpr size_t n = 16;
+                static reg load (const int16_t* p) { return _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(p)); }
+                static void store (int16_t* p, reg v) { _mm256_storeu_si256 (reinterpret_cast<__m256i*>(p), v); }
+                static reg add (reg a, reg b) { return _mm256_add_epi16 (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_epi16 (a, b); }
+                static reg adds (reg a, reg b) { return _mm256_adds_epi16 (a, b); }
+                static reg subs (reg a, reg b) { return _mm256_subs_epi16 (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_epi16 (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_epi16 (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mullo_epi16 (a, b); }
+                static int64_t sum_block (const int16_t* p, size_t nr)
+                {
+                    const reg ones = _mm256_set1_epi16 (1);
+                    reg acc = _mm256_setzero_si256();
+                    for (size_t k = 0; k < nr; ++k) { acc = _mm256_add_epi32 (acc, _mm256_madd_epi16 (load (p + k * n), ones)); }
+                    return hsum32 (acc);
+                }
+                /*!
+                 * pmaddwd's pair sums fit in 32 bits except (-2^15)^2 + (-2^15)^2 = 2^31, which wraps
+                 * to INT32_MIN, a value no other pair gives. So widen to 64 bits and add 2^32 for those.
+                 */
+                static int64_t dot_block (const int16_t* a, const int16_t* b, size_t nr)
+                {
+                    reg acc = _mm256_setzero_si256();
+                    int64_t wrapped = 0;
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg m = _mm256_madd_epi16 (load (a + k * n), load (b + k * n));
+                        const reg w = _mm256_cmpeq_epi32 (m, _mm256_set1_epi32 (std::numeric_limits<int32_t>::min()));
+                        wrapped += __builtin_popcount (_mm256_movemask_ps (_mm256_castsi256_ps (w)));
+                        acc = _mm256_add_epi64 (acc, _mm256_add_epi64 (_mm256_cvtepi32_epi64 (_mm256_castsi256_si128 (m)),
+                                                                       _mm256_cvtepi32_epi64 (_mm256_extracti128_si256 (m, 1))));
+                    }
+                    return hsum64 (acc) + wrapped * (int64_t{1} << 32);
+                }
+            };
+            template <>
+            struct simd<int32_t>
+            {
+                typedef __m256i reg;
+                static constexpr size_t n = 8;
+                static reg load (const int32_t* p) { return _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(p)); }
+                static void store (int32_t* p, reg v) { _mm256_storeu_si256 (reinterpret_cast<__m256i*>(p), v); }
+                static reg add (reg a, reg b) { return _mm256_add_epi32 (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_epi32 (a, b); }
+                //! Overflow where a and b have the same sign and the sum has the other
+                static reg adds (reg a, reg b)
+                {
+                    const reg s = add (a, b);
+                    return saturate32 (a, s, _mm256_and_si256 (_mm256_xor_si256 (a, s), _mm256_xor_si256 (b, s)));
+                }
+                //! Overflow where a and b have different signs and the difference has b's
+                static reg subs (reg a, reg b)
+                {
+                    const reg d = sub (a, b);
+                    return saturate32 (a, d, _mm256_and_si256 (_mm256_xor_si256 (a, b), _mm256_xor_si256 (a, d)));
+                }
+                static reg min (reg a, reg b) { return _mm256_min_epi32 (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_epi32 (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mullo_epi32 (a, b); }
+                static int64_t sum_block (const int32_t* p, size_t nr)
+                {
+                    reg acc = _mm256_setzero_si256();
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg v = load (p + k * n);
+                        acc = _mm256_add_epi64 (acc, _mm256_add_epi64 (_mm256_cvtepi32_epi64 (_mm256_castsi256_si128 (v)),
+                                                                       _mm256_cvtepi32_epi64 (_mm256_extracti128_si256 (v, 1))));
+                    }
+                    return hsum64 (acc);
+                }
+                /*!
+                 * pmuldq gives exact 64 bit products of the even lanes (and, shifted down, the odd
+                 * ones). Summing many of those could overflow 64 bits, so accumulate their low
+                 * (unsigned) and high (signed) 32 bit halves separately.
+                 */
+                static __int128 dot_block (const int32_t* a, const int32_t* b, size_t nr)
+                {
+                    const reg low = _mm256_set1_epi64x (0xffffffff);
+                    reg lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg va = load (a + k * n), vb = load (b + k * n);
+                        const reg pe = _mm256_mul_epi32 (va, vb);
+                        const reg po = _mm256_mul_epi32 (_mm256_srli_epi64 (va, 32), _mm256_srli_epi64 (vb, 32));
+                        lo = _mm256_add_epi64 (lo, _mm256_add_epi64 (_mm256_and_si256 (pe, low), _mm256_and_si256 (po, low)));
+                        hi = _mm256_add_epi64 (hi, _mm256_add_epi64 (high64 (pe), high64 (po)));
+                    }
+                    return join64 (lo, hi);
+                }
+            };
+            template <>
+            struct simd<int64_t>
+            {
+                typedef __m256i reg;
+                static constexpr size_t n = 4;
+                static reg load (const int64_t* p) { return _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(p)); }
+                static void store (int64_t* p, reg v) { _mm256_storeu_si256 (reinterpret_cast<__m256i*>(p), v); }
+                static reg add (reg a, reg b) { return _mm256_add_epi64 (a, b); }
+                static reg sub (reg a, reg b) { return _mm256_sub_epi64 (a, b); }
+                static reg adds (reg a, reg b)
+                {
+                    const reg s = add (a, b);
+                    return saturate64 (a, s, _mm256_and_si256 (_mm256_xor_si256 (a, s), _mm256_xor_si256 (b, s)));
+                }
+                static reg subs (reg a, reg b)
+                {
+                    const reg d = sub (a, b);
+                    return saturate64 (a, d, _mm256_and_si256 (_mm256_xor_si256 (a, b), _mm256_xor_si256 (a, d)));
+                }
+                //! No 64 bit min and max before AVX-512
+                static reg min (reg a, reg b) { return _mm256_blendv_epi8 (a, b, _mm256_cmpgt_epi64 (a, b)); }
+                static reg max (reg a, reg b) { return _mm256_blendv_epi8 (b, a, _mm256_cmpgt_epi64 (a, b)); }
+                static reg mul (reg a, reg b) { return mullo64 (a, b); }
+                //! As int32's dot_block: sum the low and high halves separately
+                static __int128 sum_block (const int64_t* p, size_t nr)
+                {
+                    const reg low = _mm256_set1_epi64x (0xffffffff);
+                    reg lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+                    for (size_t k = 0; k < nr; ++k) {
+                        const reg v = load (p + k * n);
+                        lo = _mm256_add_epi64 (lo, _mm256_and_si256 (v, low));
+                        hi = _mm256_add_epi64 (hi, high64 (v));
+                    }
+                    return join64 (lo, hi);
+                }
+            };
+#endif
+
+            //! The scalar versions, for the elements left over after the last whole register
+            template <typename T>
+            T sat (__int128 x)
+            {
+                return static_cast<T>(std::min<__int128> (std::max<__int128> (x, std::numeric_limits<T>::min()), std::numeric_limits<T>::max()));
+            }
+            template <typename T>
+            T wrap (uint64_t x) { return static_cast<T>(x); }
+
+            /*!
+             * body(c, i0, i1) for each chunk of [0, n), shared out over OpenMP when there's more
+             * than one. Chunks start at multiples of chunk, so whole registers stay whole.
+             */
+            template <typename Fn>
+            void for_chunks (size_t n, Fn body)
+            {
+                const long long nc = static_cast<long long>((n + chunk - 1) / chunk);
+                if (nc <= 1) {
+                    if (nc == 1) { body (0, 0, n); }
+                } else {
+#pragma omp parallel for
+                    for (long long c = 0; c < nc; ++c) { body (c, c * chunk, std::min (n, static_cast<size_t>(c + 1) * chunk)); }
+                }
+            }
+
+            //! out[i] = vec(a, b) for whole registers and scal(a[i], b[i]) for the rest
+            template <typename T, typename V, typename Sc>
+            void binary (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out, V vec, Sc scal)
+            {
+                typedef simd<T> S;
+                if (a.size() != b.size()) { throw std::runtime_error ("ints: vectors must be the same size"); }
+                if (out.size() != a.size()) { out.resize (a.size()); }
+                const T* ap = a.data();
+                const T* bp = b.data();
+                T* op = out.data();
+                for_chunks (a.size(), [&](long long, size_t i, size_t hi) {
+                    for (; i + S::n <= hi; i += S::n) { S::store (op + i, vec (S::load (ap + i), S::load (bp + i))); }
+                    for (; i < hi; ++i) { op[i] = scal (ap[i], bp[i]); }
+                });
+            }
+
+            //! min or max over a, by the register op vec and the scalar op scal
+            template <typename T, typename V, typename Sc>
+            T reduce (const morph::vVector<T>& a, V vec, Sc scal)
+            {
+                typedef simd<T> S;
+                if (a.empty()) { throw std::runtime_error ("ints: min and max need a non-empty vector"); }
+                const long long nc = static_cast<long long>((a.size() + chunk - 1) / chunk);
+                std::vector<T> part (nc);
+                const T* ap = a.data();
+                for_chunks (a.size(), [&](long long c, size_t i, size_t hi) {
+                    T r = ap[i];
+                    if (i + S::n <= hi) {
+                        typename S::reg m = S::load (ap + i);
+                        for (i += S::n; i + S::n <= hi; i += S::n) { m = vec (m, S::load (ap + i)); }
+                        T l[S::n];
+                        S::store (l, m);
+                        for (size_t k = 0; k < S::n; ++k) { r = scal (r, l[k]); }
+                    }
+                    for (; i < hi; ++i) { r = scal (r, ap[i]); }
+                    part[c] = r;
+                });
+                T r = part[0];
+                for (long long c = 1; c < nc; ++c) { r = scal (r, part[c]); }
+                return r;
+            }
+
+            //! The sum over chunks of R partials, each block(i, nr) over nr registers from i plus scal(i) for the rest
+            template <typename R, typename T, typename B, typename Sc>
+            R widen (size_t n, B block, Sc scal)
+            {
+                typedef simd<T> S;
+                const long long nc = static_cast<long long>((n + chunk - 1) / chunk);
+                std::vector<R> part (nc, R{0});
+                for_chunks (n, [&](long long c, size_t i, size_t hi) {
+                    const size_t nr = (hi - i) / S::n;
+                    R r = block (i, nr);
+                    for (i += nr * S::n; i < hi; ++i) { r += scal (i); }
+                    part[c] = r;
+                });
+                R r = R{0};
+                for (long long c = 0; c < nc; ++c) { r += part[c]; }
+                return r;
+            }
+        } // namespace detail
+
+        //! out = a + b, wrapping on overflow
+        template <typename T>
+        void add (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::binary (a, b, out, [](typename S::reg x, typename S::reg y) { return S::add (x, y); },
+                            [](T x, T y) { return detail::wrap<T> (static_cast<uint64_t>(x) + static_cast<uint64_t>(y)); });
+        }
+
+        //! out = a - b, wrapping on overflow
+        template <typename T>
+        void sub (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::binary (a, b, out, [](typename S::reg x, typename S::reg y) { return S::sub (x, y); },
+                            [](T x, T y) { return detail::wrap<T> (static_cast<uint64_t>(x) - static_cast<uint64_t>(y)); });
+        }
+
+        //! out = a * b elementwise, keeping the low bits of each product
+        template <typename T>
+        void mult (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::binary (a, b, out, [](typename S::reg x, typename S::reg y) { return S::mul (x, y); },
+                            [](T x, T y) { return detail::wrap<T> (static_cast<uint64_t>(x) * static_cast<uint64_t>(y)); });
+        }
+
+        //! out = a + b, clamped to T's range
+        template <typename T>
+        void adds (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::binary (a, b, out, [](typename S::reg x, typename S::reg y) { return S::adds (x, y); },
+                            [](T x, T y) { return detail::sat<T> (static_cast<__int128>(x) + y); });
+        }
+
+        //! out = a - b, clamped to T's range
+        template <typename T>
+        void subs (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::binary (a, b, out, [](typename S::reg x, typename S::reg y) { return S::subs (x, y); },
+                            [](T x, T y) { return detail::sat<T> (static_cast<__int128>(x) - y); });
+        }
+
+        //! out = the elementwise minimum of a and b
+        template <typename T>
+        void min (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::binary (a, b, out, [](typename S::reg x, typename S::reg y) { return S::min (x, y); },
+                            [](T x, T y) { return std::min (x, y); });
+        }
+
+        //! out = the elementwise maximum of a and b
+        template <typename T>
+        void max (const morph::vVector<T>& a, const morph::vVector<T>& b, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> S;
+            detail::binary (a, b, out, [](typename S::reg x, typename S::reg y) { return S::max (x, y); },
+                            [](T x, T y) { return std::max (x, y); });
+        }
+
+        //! The smallest element of a
+        template <typename T>
+        T min (const morph::vVector<T>& a)
+        {
+            typedef detail::simd<T> S;
+            return detail::reduce (a, [](typename S::reg x, typename S::reg y) { return S::min (x, y); },
+                                   [](T x, T y) { return std::min (x, y); });
+        }
+
+        //! The largest element of a
+        template <typename T>
+        T max (const morph::vVector<T>& a)
+        {
+            typedef detail::simd<T> S;
+            return detail::reduce (a, [](typename S::reg x, typename S::reg y) { return S::max (x, y); },
+                                   [](T x, T y) { return std::max (x, y); });
+        }
+
+        //! The sum of the elements of a, in a type wide enough not to overflow
+        template <typename T>
+        typename wide<T>::sum_type sum (const morph::vVector<T>& a)
+        {
+            typedef typename wide<T>::sum_type R;
+            const T* ap = a.data();
+            return detail::widen<R, T> (a.size(), [&](size_t i, size_t nr) { return R (detail::simd<T>::sum_block (ap + i, nr)); },
+                                        [&](size_t i) { return R (ap[i]); });
+        }
+
+        //! The dot product of a and b, in a type wide enough not to overflow
+        template <typename T>
+        typename wide<T>::dot_type dot (const morph::vVector<T>& a, const morph::vVector<T>& b)
+        {
+            typedef typename wide<T>::dot_type R;
+            if (a.size() != b.size()) { throw std::runtime_error ("ints: vectors must be the same size"); }
+            const T* ap = a.data();
+            const T* bp = b.data();
+            return detail::widen<R, T> (a.size(), [&](size_t i, size_t nr) {
+                if constexpr (sizeof(T) == 8) {
+                    // No SIMD 64 x 64 -> 128 bit multiply
+                    R r = R{0};
+                    for (size_t j = i; j < i + nr * detail::simd<T>::n; ++j) { r += static_cast<R>(ap[j]) * bp[j]; }
+                    return r;
+                } else {
+                    return R (detail::simd<T>::dot_block (ap + i, bp + i, nr));
+                }
+            }, [&](size_t i) { return static_cast<R>(ap[i]) * bp[i]; });
+        }
+
+    } // namespace ints
+} // namespace cc
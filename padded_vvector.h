@@ -0,0 +1,188 @@
+/*
+ * A vVector storage policy whose allocations are aligned to 64 bytes and padded to a
+ * whole number of 64 byte (AVX-512 register) blocks, with the padding zeroed. Kernels
+ * can then run over the padded length with aligned loads and stores and no scalar tail.
+ *
+ *   cc::padded_vVector<float> a(1000003), b(1000003), out(1000003);
+ *   cc::padded::mult (a, b, out); // 62501 aligned AVX-512 (or 125001 AVX) iterations
+ *
+ * The padding is zeroed when it is allocated, and the cc::padded kernels re-zero the
+ * output's padding after writing it (so that, for instance, 0/0 in the padding of a div
+ * doesn't leave NaNs there). After other operations that change the size (resize,
+ * push_back) call cc::padded::zero_padding() before relying on it.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <immintrin.h>
+
+namespace cc {
+
+    //! Allocator that aligns to Align bytes and rounds every allocation up to a multiple of Align bytes, zeroing the extra
+    template <typename T, size_t Align = 64>
+    struct padded_allocator
+    {
+        typedef T value_type;
+        template <typename U> struct rebind { typedef padded_allocator<U, Align> other; };
+
+        padded_allocator() {}
+        template <typename U> padded_allocator (const padded_allocator<U, Align>&) {}
+
+        //! Bytes actually allocated for n elements
+        static size_t padded_bytes (size_t n) { return ((n * sizeof(T) + Align - 1) / Align) * Align; }
+
+        T* allocate (size_t n)
+        {
+            size_t bytes = padded_bytes (n == 0 ? 1 : n);
+            void* p = std::aligned_alloc (Align, bytes);
+            if (p == nullptr) { throw std::bad_alloc(); }
+            // Zero the padding beyond the n elements that the vector will construct
+            std::memset (static_cast<char*>(p) + n * sizeof(T), 0, bytes - n * sizeof(T));
+            return static_cast<T*>(p);
+        }
+        void deallocate (T* p, size_t) { std::free (p); }
+
+        bool operator== (const padded_allocator&) const { return true; }
+        bool operator!= (const padded_allocator&) const { return false; }
+    };
+
+    template <typename T>
+    using padded_vVector = morph::vVector<T, padded_allocator<T>>;
+
+    namespace padded {
+
+        //! Bytes per padding block (one AVX-512 register)
+        constexpr size_t block_bytes = 64;
+        //! Below this many registers the kernels don't start an OpenMP team
+        constexpr long long parallel_min_blocks = 8192;
+
+        //! Number of elements in v including its padding
+        template <typename T>
+        size_t padded_size (const padded_vVector<T>& v)
+        {
+            constexpr size_t per_block = block_bytes / sizeof(T);
+            return ((v.size() + per_block - 1) / per_block) * per_block;
+        }
+
+        //! Zero the elements between v.size() and padded_size(v)
+        template <typename T>
+        void zero_padding (padded_vVector<T>& v)
+        {
+            size_t n = v.size();
+            size_t np = padded_size (v);
+            if (np > n) { std::memset (v.data() + n, 0, (np - n) * sizeof(T)); }
+        }
+
+        namespace detail {
+            // Aligned load/store/ops for float and double at the widest width compiled for
+#if defined(__AVX512F__)
+            inline __m512 load (const float* p) { return _mm512_load_ps (p); }
+            inline __m512d load (const double* p) { return _mm512_load_pd (p); }
+            inline void store (float* p, __m512 v) { _mm512_store_ps (p, v); }
+            inline void store (double* p, __m512d v) { _mm512_store_pd (p, v); }
+            inline __m512 set1 (float f) { return _mm512_set1_ps (f); }
+            inline __m512d set1 (double f) { return _mm512_set1_pd (f); }
+            inline __m512 mul (__m512 a, __m512 b) { return _mm512_mul_ps (a, b); }
+            inline __m512d mul (__m512d a, __m512d b) { return _mm512_mul_pd (a, b); }
+            inline __m512 div (__m512 a, __m512 b) { return _mm512_div_ps (a, b); }
+            inline __m512d div (__m512d a, __m512d b) { return _mm512_div_pd (a, b); }
+            //! Elements of T per register
+            template <typename T> constexpr size_t lanes = 64 / sizeof(T);
+#elif defined(__AVX__)
+            inline __m256 load (const float* p) { return _mm256_load_ps (p); }
+            inline __m256d load (const double* p) { return _mm256_load_pd (p); }
+            inline void store (float* p, __m256 v) { _mm256_store_ps (p, v); }
+            inline void store (double* p, __m256d v) { _mm256_store_pd (p, v); }
+            inline __m256 set1 (float f) { return _mm256_set1_ps (f); }
+            inline __m256d set1 (double f) { return _mm256_set1_pd (f); }
+            inline __m256 mul (__m256 a, __m256 b) { return _mm256_mul_ps (a, b); }
+            inline __m256d mul (__m256d a, __m256d b) { return _mm256_mul_pd (a, b); }
+            inline __m256 div (__m256 a, __m256 b) { return _mm256_div_ps (a, b); }
+            inline __m256d div (__m256d a, __m256d b) { return _mm256_div_pd (a, b); }
+            template <typename T> constexpr size_t lanes = 32 / sizeof(T);
+#else
+            template <typename T> inline T load (const T* p) { return *p; }
+            template <typename T> inline void store (T* p, T v) { *p = v; }
+            template <typename T> inline T set1 (T f) { return f; }
+            template <typename T> inline T mul (T a, T b) { return a * b; }
+            template <typename T> inline T div (T a, T b) { return a / b; }
+            //! The scalar load and store handle one element at a time, whatever T is
+            template <typename T> constexpr size_t lanes = 1;
+#endif
+            static_assert (block_bytes % (lanes<float> * sizeof(float)) == 0 && block_bytes % (lanes<double> * sizeof(double)) == 0,
+                           "padding must be a whole number of registers");
+
+            //! Call fn(k) for k in [0, nb), only starting an OpenMP team for large nb (an if clause still costs a team of one)
+            template <typename Fn>
+            inline void for_blocks (const long long nb, Fn fn)
+            {
+                if (nb < parallel_min_blocks) {
+                    for (long long k = 0; k < nb; ++k) { fn (k); }
+                } else {
+#pragma omp parallel for
+                    for (long long k = 0; k < nb; ++k) { fn (k); }
+                }
+            }
+
+            template <typename T>
+            void check_sizes (const padded_vVector<T>& a, const padded_vVector<T>& b)
+            {
+                if (a.size() != b.size()) { throw std::runtime_error ("padded: vVectors must be the same size"); }
+            }
+        } // namespace detail
+
+        //! out = a * s, over the padded length with aligned loads and no tail
+        template <typename T>
+        void scale (const padded_vVector<T>& a, const T s, padded_vVector<T>& out)
+        {
+            detail::check_sizes (a, out);
+            constexpr size_t w = detail::lanes<T>;
+            const long long nb = static_cast<long long>(padded_size (a) / w);
+            const T* ap = a.data();
+            T* op = out.data();
+            const auto sv = detail::set1 (s);
+            detail::for_blocks (nb, [=](long long k) { detail::store (op + k * w, detail::mul (detail::load (ap + k * w), sv)); });
+            zero_padding (out);
+        }
+
+        //! out = a * b, over the padded length with aligned loads and no tail
+        template <typename T>
+        void mult (const padded_vVector<T>& a, const padded_vVector<T>& b, padded_vVector<T>& out)
+        {
+            detail::check_sizes (a, out);
+            detail::check_sizes (b, out);
+            constexpr size_t w = detail::lanes<T>;
+            const long long nb = static_cast<long long>(padded_size (a) / w);
+            const T* ap = a.data();
+            const T* bp = b.data();
+            T* op = out.data();
+            detail::for_blocks (nb, [=](long long k) {
+                detail::store (op + k * w, detail::mul (detail::load (ap + k * w), detail::load (bp + k * w)));
+            });
+            zero_padding (out);
+        }
+
+        //! out = a / b, over the padded length with aligned loads and no tail
+        template <typename T>
+        void div (const padded_vVector<T>& a, const padded_vVector<T>& b, padded_vVector<T>& out)
+        {
+            detail::check_sizes (a, out);
+            detail::check_sizes (b, out);
+            constexpr size_t w = detail::lanes<T>;
+            const long long nb = static_cast<long long>(padded_size (a) / w);
+            const T* ap = a.data();
+            const T* bp = b.data();
+            T* op = out.data();
+            detail::for_blocks (nb, [=](long long k) {
+                detail::store (op + k * w, detail::div (detail::load (ap + k * w), detail::load (bp + k * w)));
+            });
+            zero_padding (out);
+        }
+
+    } // namespace padded
+} // namespace cc
@@ -0,0 +1,377 @@
+/*
+ * Pluggable parallel backends for elementwise vVector ops, as an alternative to the
+ * OpenMP parallel for loops inside vVector itself.
+ *
+ * An executor is anything with
+ *
+ *   template <typename Fn> void parallel_for (size_t n, size_t grain, Fn fn);
+ *
+ * which calls fn(begin, end) over chunks of [0, n) of about grain elements, and returns
+ * when they're all done. Four are provided:
+ *
+ *   cc::serial_executor    runs fn(0, n) on the calling thread
+ *   cc::openmp_executor    an omp parallel for over the chunks (only if built with OpenMP)
+ *   cc::thread_pool        a work-stealing pool. Threads that wait for a parallel_for to
+ *                          finish run other queued chunks meanwhile, so nested
+ *                          parallel_for calls don't oversubscribe or deadlock.
+ *   cc::function_executor  hands each chunk to a caller-supplied submit function, so the
+ *                          chunks run on an application's existing thread pool
+ *
+ * The ops in cc::par (scale, mult, div, pow, sum) take any executor:
+ *
+ *   cc::thread_pool pool;
+ *   cc::par::mult (pool, a, b, out);
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <exception>
+#include <cmath>
+#include <algorithm>
+
+namespace cc {
+
+    //! Number of chunks to split n elements into, given a grain size
+    inline size_t n_chunks (size_t n, size_t grain)
+    {
+        grain = std::max (grain, size_t{1});
+        return (n + grain - 1) / grain;
+    }
+
+    struct serial_executor
+    {
+        template <typename Fn>
+        void parallel_for (size_t n, size_t, Fn fn) { if (n > 0) { fn (size_t{0}, n); } }
+    };
+
+#ifdef _OPENMP
+    struct openmp_executor
+    {
+        template <typename Fn>
+        void parallel_for (size_t n, size_t grain, Fn fn)
+        {
+            grain = std::max (grain, size_t{1});
+            const long long nc = static_cast<long long>(n_chunks (n, grain));
+#pragma omp parallel for schedule(static)
+            for (long long c = 0; c < nc; ++c) {
+                size_t b = c * grain;
+                fn (b, std::min (n, b + grain));
+            }
+        }
+    };
+#endif
+
+    class thread_pool
+    {
+    public:
+        explicit thread_pool (unsigned n_threads = std::max (1u, std::thread::hardware_concurrency()))
+        {
+            // Queue 0 belongs to threads that aren't in the pool; 1..n to the workers
+            for (unsigned i = 0; i <= n_threads; ++i) { this->queues.emplace_back (new queue); }
+            for (unsigned i = 1; i <= n_threads; ++i) {
+                this->threads.emplace_back ([this, i]() { this->worker_loop (i); });
+            }
+        }
+
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lk (this->sleep_m);
+                this->stopping = true;
+            }
+            this->sleep_cv.notify_all();
+            for (auto& t : this->threads) { t.join(); }
+        }
+
+        thread_pool (const thread_pool&) = delete;
+        thread_pool& operator= (const thread_pool&) = delete;
+
+        size_t size() const { return this->threads.size(); }
+
+        //! Queue a task. Callers can use this as the submit function of a function_executor.
+        void submit (std::function<void()> task)
+        {
+            queue& q = *this->queues[this_worker() >= 0 && this_pool() == this ? this_worker() : 0];
+            {
+                std::lock_guard<std::mutex> lk (q.m);
+                q.tasks.push_back (std::move (task));
+            }
+            {
+                std::lock_guard<std::mutex> lk (this->sleep_m);
+                ++this->queued;
+            }
+            this->sleep_cv.notify_one();
+        }
+
+        /*!
+         * If any chunk throws, the rest still run (queued tasks refer to fn, so this can't
+         * return before they're done), then the first exception is rethrown here.
+         */
+        template <typename Fn>
+        void parallel_for (size_t n, size_t grain, Fn fn)
+        {
+            grain = std::max (grain, size_t{1});
+            const size_t nc = n_chunks (n, grain);
+            if (nc == 0) { return; }
+            if (nc == 1) { fn (size_t{0}, n); return; }
+            std::atomic<size_t> remaining (nc - 1);
+            std::mutex err_m;
+            std::exception_ptr err;
+            auto failed = [&err_m, &err]() {
+                std::lock_guard<std::mutex> lk (err_m);
+                if (!err) { err = std::current_exception(); }
+            };
+            auto run = [&fn, &failed](size_t b, size_t e) {
+                try { fn (b, e); } catch (...) { failed(); }
+            };
+            size_t c = 1;
+            try {
+                for (; c < nc; ++c) {
+                    size_t b = c * grain;
+                    size_t e = std::min (n, b + grain);
+                    this->submit ([&run, &remaining, b, e]() { run (b, e); remaining.fetch_sub (1, std::memory_order_release); });
+                }
+            } catch (...) {
+                // Chunks c.. were never queued, so don't wait for them
+                failed();
+                remaining.fetch_sub (nc - c, std::memory_order_release);
+            }
+            // Do the first chunk here, then help with whatever is queued until our chunks are done
+            run (size_t{0}, std::min (n, grain));
+            this->wait ([&remaining]() { return remaining.load (std::memory_order_acquire) == 0; });
+            if (err) { std::rethrow_exception (err); }
+        }
+
+        //! Run queued tasks on the calling thread until done() returns true
+        template <typename Pred>
+        void wait (Pred done)
+        {
+            int self = this_pool() == this ? this_worker() : 0;
+            while (!done()) {
+                if (!this->run_one (self)) { std::this_thread::yield(); }
+            }
+        }
+
+    private:
+        struct queue
+        {
+            std::mutex m;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        static int& this_worker() { static thread_local int w = -1; return w; }
+        static thread_pool*& this_pool() { static thread_local thread_pool* p = nullptr; return p; }
+
+        //! Run one task: newest from our own queue first (it's hot in cache), else steal the
+        //! oldest from someone else's (it's likely the biggest remaining piece of work).
+        bool run_one (int self)
+        {
+            std::function<void()> task;
+            {
+                queue& q = *this->queues[self];
+                std::lock_guard<std::mutex> lk (q.m);
+                if (!q.tasks.empty()) {
+                    task = std::move (q.tasks.back());
+                    q.tasks.pop_back();
+                }
+            }
+            for (size_t i = 1; !task && i < this->queues.size(); ++i) {
+                queue& q = *this->queues[(self + i) % this->queues.size()];
+                std::lock_guard<std::mutex> lk (q.m);
+                if (!q.tasks.empty()) {
+                    task = std::move (q.tasks.front());
+                    q.tasks.pop_front();
+                }
+            }
+            if (!task) { return false; }
+            {
+                std::lock_guard<std::mutex> lk (this->sleep_m);
+                --this->queued;
+            }
+            task();
+            return true;
+        }
+
+        void worker_loop (int self)
+        {
+            this_worker() = self;
+            this_pool() = this;
+            for (;;) {
+                if (this->run_one (self)) { continue; }
+                std::unique_lock<std::mutex> lk (this->sleep_m);
+                this->sleep_cv.wait (lk, [this]() { return this->stopping || this->queued > 0; });
+                if (this->stopping && this->queued == 0) { return; }
+            }
+        }
+
+        std::vector<std::unique_ptr<queue>> queues;
+        std::vector<std::thread> threads;
+        std::mutex sleep_m;
+        std::condition_variable sleep_cv;
+        size_t queued = 0;
+        bool stopping = false;
+    };
+
+    /*!
+     * Runs chunks through a caller-supplied submit function (e.g. an application's own
+     * thread pool). The calling thread runs the first chunk itself and then blocks until
+     * the rest have been run, so submit must not run tasks only on this thread.
+     */
+    class function_executor
+    {
+    public:
+        explicit function_executor (std::function<void(std::function<void()>)> _submit) : submit (std::move (_submit)) {}
+
+        //! Like thread_pool's: every submitted chunk runs before the first exception is rethrown
+        template <typename Fn>
+        void parallel_for (size_t n, size_t grain, Fn fn)
+        {
+            grain = std::max (grain, size_t{1});
+            const size_t nc = n_chunks (n, grain);
+            if (nc == 0) { return; }
+            std::mutex m;
+            std::condition_variable cv;
+            size_t remaining = nc - 1;
+            std::exception_ptr err;
+            auto run = [&](size_t b, size_t e) {
+                try {
+                    fn (b, e);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lk (m);
+                    if (!err) { err = std::current_exception(); }
+                }
+            };
+            size_t c = 1;
+            try {
+                for (; c < nc; ++c) {
+                    size_t b = c * grain;
+                    size_t e = std::min (n, b + grain);
+                    this->submit ([&, b, e]() {
+                        run (b, e);
+                        std::lock_guard<std::mutex> lk (m);
+                        if (--remaining == 0) { cv.notify_one(); }
+                    });
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lk (m);
+                if (!err) { err = std::current_exception(); }
+                remaining -= nc - c;
+            }
+            run (size_t{0}, std::min (n, grain));
+            std::unique_lock<std::mutex> lk (m);
+            cv.wait (lk, [&]() { return remaining == 0; });
+            if (err) { std::rethrow_exception (err); }
+        }
+
+    private:
+        std::function<void(std::function<void()>)> submit;
+    };
+
+    /*!
+     * Reduce over [0, n) with any executor: map(begin, end) gives a partial result for a
+     * chunk, and the partials are combined, in chunk order, with combine(a, b).
+     */
+    template <typename T, typename Exec, typename Map, typename Combine>
+    T parallel_reduce (Exec& exec, size_t n, size_t grain, T init, Map map, Combine combine)
+    {
+        grain = std::max (grain, size_t{1});
+        std::vector<T> partial (n_chunks (n, grain), init);
+        exec.parallel_for (n, grain, [&](size_t b, size_t e) { partial[b / grain] = map (b, e); });
+        T result = init;
+        for (const T& p : partial) { result = combine (result, p); }
+        return result;
+    }
+
+    //! vVector ops on a chosen executor
+    namespace par {
+
+        //! Default chunk size: big enough to amortise scheduling, small enough to balance
+        constexpr size_t default_grain = 16384;
+
+        template <typename F>
+        void check_sizes (const morph::vVector<F>& a, const morph::vVector<F>& b)
+        {
+            if (a.size() != b.size()) { throw std::runtime_error ("par: vVectors must be the same size"); }
+        }
+
+        //! out = a * s
+        template <typename Exec, typename F>
+        void scale (Exec& exec, const morph::vVector<F>& a, const F s, morph::vVector<F>& out, size_t grain = default_grain)
+        {
+            check_sizes (a, out);
+            const F* ap = a.data();
+            F* op = out.data();
+            exec.parallel_for (a.size(), grain, [=](size_t b, size_t e) {
+#pragma omp simd
+                for (size_t i = b; i < e; ++i) { op[i] = ap[i] * s; }
+            });
+        }
+
+        //! out = a * b (elementwise)
+        template <typename Exec, typename F>
+        void mult (Exec& exec, const morph::vVector<F>& a, const morph::vVector<F>& b, morph::vVector<F>& out, size_t grain = default_grain)
+        {
+            check_sizes (a, out);
+            check_sizes (b, out);
+            const F* ap = a.data();
+            const F* bp = b.data();
+            F* op = out.data();
+            exec.parallel_for (a.size(), grain, [=](size_t lo, size_t hi) {
+#pragma omp simd
+                for (size_t i = lo; i < hi; ++i) { op[i] = ap[i] * bp[i]; }
+            });
+        }
+
+        //! out = a / b (elementwise)
+        template <typename Exec, typename F>
+        void div (Exec& exec, const morph::vVector<F>& a, const morph::vVector<F>& b, morph::vVector<F>& out, size_t grain = default_grain)
+        {
+            check_sizes (a, out);
+            check_sizes (b, out);
+            const F* ap = a.data();
+            const F* bp = b.data();
+            F* op = out.data();
+            exec.parallel_for (a.size(), grain, [=](size_t lo, size_t hi) {
+#pragma omp simd
+                for (size_t i = lo; i < hi; ++i) { op[i] = ap[i] / bp[i]; }
+            });
+        }
+
+        //! out = a^p
+        template <typename Exec, typename F>
+        void pow (Exec& exec, const morph::vVector<F>& a, const F p, morph::vVector<F>& out, size_t grain = default_grain)
+        {
+            check_sizes (a, out);
+            const F* ap = a.data();
+            F* op = out.data();
+            exec.parallel_for (a.size(), grain, [=](size_t b, size_t e) {
+                for (size_t i = b; i < e; ++i) { op[i] = std::pow (ap[i], p); }
+            });
+        }
+
+        //! Sum of the elements of a
+        template <typename Exec, typename F>
+        F sum (Exec& exec, const morph::vVector<F>& a, size_t grain = default_grain)
+        {
+            const F* ap = a.data();
+            return parallel_reduce (exec, a.size(), grain, F{0},
+                                    [=](size_t b, size_t e) {
+                                        F s = F{0};
+#pragma omp simd reduction(+:s)
+                                        for (size_t i = b; i < e; ++i) { s += ap[i]; }
+                                        return s;
+                                    },
+                                    [](F x, F y) { return x + y; });
+        }
+
+    } // namespace par
+} // namespace cc
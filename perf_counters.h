@@ -0,0 +1,177 @@
+/*
+ * Hardware performance counters for the benchmark kernels, via Linux perf_event_open.
+ *
+ *   cc::perf_counters pc;
+ *   pc.start();
+ *   for (...) { v.mult (i, v2); }
+ *   pc.stop();
+ *   pc.report ("Scalar mult (vVector)", 500 * v.size());
+ *
+ * Reports cycles, instructions, IPC, L1D read misses, last level cache misses and (on
+ * Intel) retired scalar and packed floating point instructions, each per element. A
+ * kernel with low IPC and many LLC misses per element is memory bound; a kernel with
+ * high IPC and few misses is compute bound.
+ *
+ * Each counter is opened on its own, so if some can't be opened (no PMU in a VM, a
+ * restrictive kernel.perf_event_paranoid, an AMD host for the Intel-only FP events or a
+ * non-Linux OS) the rest are still reported and the missing ones show as "n/a". If
+ * nothing can be counted, report() says so once and then stays quiet.
+ */
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#ifdef __GLN__
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+#endif
+
+namespace cc {
+
+    class perf_counters
+    {
+    public:
+        enum counter { cycles, instructions, l1d_misses, llc_misses, fp_scalar, fp_packed, n_counters };
+
+        perf_counters()
+        {
+            for (int c = 0; c < n_counters; ++c) { this->fd[c] = -1; this->value[c] = 0; }
+#ifdef __GLN__
+            this->open_counter (cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+            this->open_counter (instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+            this->open_counter (l1d_misses, PERF_TYPE_HW_CACHE,
+                                PERF_COUNT_HW_CACHE_L1D
+                                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+            this->open_counter (llc_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+            if (perf_counters::is_intel()) {
+                // FP_ARITH_INST_RETIRED (event 0xc7). umask 0x03: scalar single and double.
+                // umask 0xfc: 128, 256 and 512 bit packed single and double.
+                this->open_counter (fp_scalar, PERF_TYPE_RAW, 0x03c7);
+                this->open_counter (fp_packed, PERF_TYPE_RAW, 0xfcc7);
+            }
+#endif
+        }
+
+        ~perf_counters()
+        {
+#ifdef __GLN__
+            for (int c = 0; c < n_counters; ++c) { if (this->fd[c] >= 0) { close (this->fd[c]); } }
+#endif
+        }
+
+        perf_counters (const perf_counters&) = delete;
+        perf_counters& operator= (const perf_counters&) = delete;
+
+        //! True if at least one counter could be opened
+        bool available() const
+        {
+            for (int c = 0; c < n_counters; ++c) { if (this->fd[c] >= 0) { return true; } }
+            return false;
+        }
+
+        //! Zero and enable all the counters
+        void start()
+        {
+#ifdef __GLN__
+            for (int c = 0; c < n_counters; ++c) {
+                if (this->fd[c] < 0) { continue; }
+                ioctl (this->fd[c], PERF_EVENT_IOC_RESET, 0);
+                ioctl (this->fd[c], PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        //! Disable the counters and read their values, scaling up if the kernel had to multiplex them
+        void stop()
+        {
+#ifdef __GLN__
+            for (int c = 0; c < n_counters; ++c) {
+                if (this->fd[c] < 0) { continue; }
+                ioctl (this->fd[c], PERF_EVENT_IOC_DISABLE, 0);
+                uint64_t buf[3] = {0, 0, 0}; // value, time enabled, time running
+                if (read (this->fd[c], buf, sizeof(buf)) != sizeof(buf)) { this->value[c] = 0; continue; }
+                this->value[c] = buf[2] > 0 ? static_cast<double>(buf[0]) * buf[1] / buf[2] : 0.0;
+            }
+#endif
+        }
+
+        //! The last value read by stop() for counter c, or -1 if c isn't available
+        double get (counter c) const { return this->fd[c] >= 0 ? this->value[c] : -1.0; }
+
+        //! Print the counters from the last start()/stop() normalised by n_elements. os's format state is left as it was.
+        void report (const std::string& what, double n_elements, std::ostream& os = std::cout)
+        {
+            if (!this->available()) {
+                if (!this->warned) {
+                    os << "(hardware performance counters are unavailable on this host)" << std::endl;
+                    this->warned = true;
+                }
+                return;
+            }
+            // Format into a local stream, so the precision set here doesn't stick to the caller's
+            std::ostringstream ss;
+            ss << "  " << what << " per element:";
+            this->field (ss, " cycles", cycles, n_elements);
+            this->field (ss, " instr", instructions, n_elements);
+            if (this->fd[cycles] >= 0 && this->fd[instructions] >= 0 && this->value[cycles] > 0.0) {
+                ss << " IPC " << std::setprecision(3) << this->value[instructions] / this->value[cycles];
+            } else {
+                ss << " IPC n/a";
+            }
+            this->field (ss, " L1D-miss", l1d_misses, n_elements);
+            this->field (ss, " LLC-miss", llc_misses, n_elements);
+            this->field (ss, " fp-scalar", fp_scalar, n_elements);
+            this->field (ss, " fp-packed", fp_packed, n_elements);
+            os << ss.str() << std::endl;
+        }
+
+    private:
+#ifdef __GLN__
+        void open_counter (counter c, uint32_t type, uint64_t config)
+        {
+            struct perf_event_attr pe;
+            std::memset (&pe, 0, sizeof(pe));
+            pe.size = sizeof(pe);
+            pe.type = type;
+            pe.config = config;
+            pe.disabled = 1;
+            pe.exclude_kernel = 1;
+            pe.exclude_hv = 1;
+            // Count the threads that OpenMP starts after this point, too
+            pe.inherit = 1;
+            pe.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            this->fd[c] = static_cast<int>(syscall (__NR_perf_event_open, &pe, 0, -1, -1, 0));
+        }
+
+        static bool is_intel()
+        {
+            std::ifstream f ("/proc/cpuinfo");
+            std::string line;
+            while (std::getline (f, line)) {
+                if (line.compare (0, 9, "vendor_id") == 0) { return line.find ("GenuineIntel") != std::string::npos; }
+            }
+            return false;
+        }
+#endif
+
+        //! Append one counter to os, which report() owns; this sets os's precision
+        void field (std::ostream& os, const char* name, counter c, double n_elements) const
+        {
+            os << name << " ";
+            if (this->fd[c] < 0) { os << "n/a"; } else { os << std::setprecision(3) << this->value[c] / n_elements; }
+        }
+
+        int fd[n_counters];
+        double value[n_counters];
+        bool warned = false;
+    };
+
+} // namespace cc
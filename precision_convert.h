@@ -0,0 +1,73 @@
+/*
+ * Vectorised, OpenMP parallel float <-> double conversion between vVectors. Unlike
+ * vVector::as_double() and vVector::as_float(), which build and return a new vVector,
+ * these write into a destination that the caller keeps between calls, so a conversion
+ * made every iteration doesn't allocate.
+ *
+ *   morph::vVector<double> d;
+ *   cc::as_double (f, d); // d is resized only if its size differs from f's
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+
+namespace cc {
+
+    //! Convert float to double (cvtps2pd), writing into out.
+    inline void as_double (const morph::vVector<float>& in, morph::vVector<double>& out)
+    {
+        if (out.size() != in.size()) { out.resize (in.size()); }
+        const float* ip = in.data();
+        double* op = out.data();
+#if defined(__AVX512F__)
+        constexpr size_t w = 8;
+#elif defined(__AVX__)
+        constexpr size_t w = 4;
+#else
+        constexpr size_t w = 1;
+#endif
+        const long long nb = static_cast<long long>(in.size() / w);
+#pragma omp parallel for
+        for (long long k = 0; k < nb; ++k) {
+            size_t i = k * w;
+#if defined(__AVX512F__)
+            _mm512_storeu_pd (op + i, _mm512_cvtps_pd (_mm256_loadu_ps (ip + i)));
+#elif defined(__AVX__)
+            _mm256_storeu_pd (op + i, _mm256_cvtps_pd (_mm_loadu_ps (ip + i)));
+#else
+            op[i] = static_cast<double>(ip[i]);
+#endif
+        }
+        for (size_t i = nb * w; i < in.size(); ++i) { op[i] = static_cast<double>(ip[i]); }
+    }
+
+    //! Convert double to float (cvtpd2ps, rounding to nearest), writing into out.
+    inline void as_float (const morph::vVector<double>& in, morph::vVector<float>& out)
+    {
+        if (out.size() != in.size()) { out.resize (in.size()); }
+        const double* ip = in.data();
+        float* op = out.data();
+#if defined(__AVX512F__)
+        constexpr size_t w = 8;
+#elif defined(__AVX__)
+        constexpr size_t w = 4;
+#else
+        constexpr size_t w = 1;
+#endif
+        const long long nb = static_cast<long long>(in.size() / w);
+#pragma omp parallel for
+        for (long long k = 0; k < nb; ++k) {
+            size_t i = k * w;
+#if defined(__AVX512F__)
+            _mm256_storeu_ps (op + i, _mm512_cvtpd_ps (_mm512_loadu_pd (ip + i)));
+#elif defined(__AVX__)
+            _mm_storeu_ps (op + i, _mm256_cvtpd_ps (_mm256_loadu_pd (ip + i)));
+#else
+            op[i] = static_cast<float>(ip[i]);
+#endif
+        }
+        for (size_t i = nb * w; i < in.size(); ++i) { op[i] = static_cast<float>(ip[i]); }
+    }
+
+} // namespace cc
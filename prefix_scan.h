@@ -0,0 +1,276 @@
+/*
+ * Inclusive prefix scans of vVectors: cumulative sum, product, max and min.
+ *
+ * Within a register the scan is log2(width) shift-and-combine steps; the register's last
+ * lane is then the carry into the next one. Across threads it is a two pass block scan:
+ * each thread reduces its block, the block totals are scanned serially, and each thread
+ * then scans its block again starting from the total of the blocks before it. That reads
+ * the input twice and writes the output once.
+ *
+ *   morph::vVector<float> c;
+ *   cc::scan::cumsum (a, c); // c[i] = a[0] + ... + a[i]; c is resized to a.size() if necessary
+ *
+ * The SIMD and parallel scans combine in a different order from a serial loop, so cumsum
+ * and cumprod results differ from a serial scan by rounding. For float they carry in
+ * double, which costs SIMD width but is usually closer than a serial float loop. out may be a.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+#if !defined(__AVX2__)
+# error "prefix_scan.h needs at least -mavx2"
+#endif
+
+namespace cc {
+    namespace scan {
+
+        //! Below this many elements the scan runs in a single pass on one thread
+        constexpr size_t parallel_min = 65536;
+
+        namespace detail {
+
+            // Per type and width: load/store, shift_in<K> (move each lane up K places,
+            // filling the bottom K with ident) and broadcast of the last lane.
+            template <typename T> struct simd;
+#if defined(__AVX512F__)
+            template <>
+            struct simd<float>
+            {
+                typedef __m512 reg;
+                static constexpr int n = 16;
+                static reg load (const float* p) { return _mm512_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm512_storeu_ps (p, v); }
+                static reg set1 (float f) { return _mm512_set1_ps (f); }
+                template <int K> static reg shift_in (reg x, reg ident)
+                {
+                    const __m512i idx = _mm512_sub_epi32 (_mm512_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32 (K));
+                    return _mm512_mask_permutexvar_ps (ident, static_cast<__mmask16>(0xffffu << K), idx, x);
+                }
+                static reg last (reg x) { return _mm512_permutexvar_ps (_mm512_set1_epi32 (15), x); }
+                static reg add (reg a, reg b) { return _mm512_add_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_ps (a, b); }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m512d reg;
+                static constexpr int n = 8;
+                static reg load (const double* p) { return _mm512_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm512_storeu_pd (p, v); }
+                static reg set1 (double f) { return _mm512_set1_pd (f); }
+                template <int K> static reg shift_in (reg x, reg ident)
+                {
+                    const __m512i idx = _mm512_sub_epi64 (_mm512_setr_epi64 (0, 1, 2, 3, 4, 5, 6, 7), _mm512_set1_epi64 (K));
+                    return _mm512_mask_permutexvar_pd (ident, static_cast<__mmask8>(0xffu << K), idx, x);
+                }
+                static reg last (reg x) { return _mm512_permutexvar_pd (_mm512_set1_epi64 (7), x); }
+                static reg add (reg a, reg b) { return _mm512_add_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_pd (a, b); }
+            };
+#else
+            template <>
+            struct simd<float>
+            {
+                typedef __m256 reg;
+                static constexpr int n = 8;
+                static reg load (const float* p) { return _mm256_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm256_storeu_ps (p, v); }
+                static reg set1 (float f) { return _mm256_set1_ps (f); }
+                template <int K> static reg shift_in (reg x, reg ident)
+                {
+                    const __m256i idx = _mm256_max_epi32 (_mm256_sub_epi32 (_mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32 (K)),
+                                                          _mm256_setzero_si256());
+                    return _mm256_blend_ps (_mm256_permutevar8x32_ps (x, idx), ident, (1 << K) - 1);
+                }
+                static reg last (reg x) { return _mm256_permutevar8x32_ps (x, _mm256_set1_epi32 (7)); }
+                static reg add (reg a, reg b) { return _mm256_add_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_ps (a, b); }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m256d reg;
+                static constexpr int n = 4;
+                static reg load (const double* p) { return _mm256_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm256_storeu_pd (p, v); }
+                static reg set1 (double f) { return _mm256_set1_pd (f); }
+                template <int K> static reg shift_in (reg x, reg ident)
+                {
+                    // Lanes (0,0,1,2) for K = 1 and (0,0,0,1) for K = 2, then ident into the bottom K
+                    constexpr int sel = K == 1 ? 0x90 : 0x40;
+                    return _mm256_blend_pd (_mm256_permute4x64_pd (x, sel), ident, (1 << K) - 1);
+                }
+                static reg last (reg x) { return _mm256_permute4x64_pd (x, 0xff); }
+                static reg add (reg a, reg b) { return _mm256_add_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_pd (a, b); }
+            };
+#endif
+
+            /*!
+             * simd<double> that loads from and stores to float. Used for float cumsum and
+             * cumprod: a float carry loses too much, particularly for products of factors
+             * close to 1, where 8 element partial products lose most of their precision.
+             */
+            struct widen : public simd<double>
+            {
+                using simd<double>::load;
+                using simd<double>::store;
+#if defined(__AVX512F__)
+                static reg load (const float* p) { return _mm512_cvtps_pd (_mm256_loadu_ps (p)); }
+                static void store (float* p, reg v) { _mm256_storeu_ps (p, _mm512_cvtpd_ps (v)); }
+#else
+                static reg load (const float* p) { return _mm256_cvtps_pd (_mm_loadu_ps (p)); }
+                static void store (float* p, reg v) { _mm_storeu_ps (p, _mm256_cvtpd_ps (v)); }
+#endif
+            };
+
+            //! Inclusive scan of the lanes of x
+            template <typename V, int K = 1, typename Op>
+            inline typename V::reg scan_reg (typename V::reg x, typename V::reg ident, Op op)
+            {
+                if constexpr (K < V::n) {
+                    return scan_reg<V, 2 * K> (op (x, V::template shift_in<K> (x, ident)), ident, op);
+                } else {
+                    return x;
+                }
+            }
+
+            //! Scan a[0, n) into out, starting from carry. Returns the last value (carry if n is 0).
+            template <typename V, typename T, typename A, typename Op, typename SOp>
+            A scan_block (const T* a, T* out, size_t n, A carry, A ident, Op op, SOp sop)
+            {
+                const typename V::reg id = V::set1 (ident);
+                typename V::reg c = V::set1 (carry);
+                size_t i = 0;
+                for (; i + V::n <= n; i += V::n) {
+                    typename V::reg x = op (scan_reg<V> (V::load (a + i), id, op), c);
+                    V::store (out + i, x);
+                    c = V::last (x);
+                }
+                alignas(64) A lanes[V::n];
+                V::store (lanes, c);
+                carry = lanes[0];
+                for (; i < n; ++i) { carry = sop (carry, static_cast<A>(a[i])); out[i] = static_cast<T>(carry); }
+                return carry;
+            }
+
+            //! Reduce a[0, n), starting from ident
+            template <typename V, typename T, typename A, typename Op, typename SOp>
+            A reduce_block (const T* a, size_t n, A ident, Op op, SOp sop)
+            {
+                typename V::reg acc0 = V::set1 (ident), acc1 = acc0;
+                size_t i = 0;
+                for (; i + 2 * V::n <= n; i += 2 * V::n) {
+                    acc0 = op (acc0, V::load (a + i));
+                    acc1 = op (acc1, V::load (a + i + V::n));
+                }
+                alignas(64) A lanes[V::n];
+                V::store (lanes, op (acc0, acc1));
+                A r = ident;
+                for (int l = 0; l < V::n; ++l) { r = sop (r, lanes[l]); }
+                for (; i < n; ++i) { r = sop (r, static_cast<A>(a[i])); }
+                return r;
+            }
+
+            //! Scan a into out with the kernels of V, carrying values of type A
+            template <typename V, typename T, typename A, typename Op, typename SOp>
+            void scan (const morph::vVector<T>& a, morph::vVector<T>& out, A ident, Op op, SOp sop)
+            {
+                if (out.size() != a.size()) { out.resize (a.size()); }
+                const size_t n = a.size();
+                const T* ap = a.data();
+                T* op_ = out.data();
+#ifdef _OPENMP
+                const int nt = omp_get_max_threads();
+#else
+                const int nt = 1;
+#endif
+                if (nt == 1 || n < parallel_min) {
+                    scan_block<V> (ap, op_, n, ident, ident, op, sop);
+                    return;
+                }
+                // One block per thread. Pass 1: block totals.
+                const size_t bl = (n + nt - 1) / nt;
+                std::vector<A> carry (nt, ident);
+#pragma omp parallel for schedule(static)
+                for (int b = 0; b < nt; ++b) {
+                    const size_t lo = std::min (n, b * bl);
+                    const size_t hi = std::min (n, lo + bl);
+                    carry[b] = reduce_block<V> (ap + lo, hi - lo, ident, op, sop);
+                }
+                // Exclusive scan of the totals
+                A run = ident;
+                for (int b = 0; b < nt; ++b) { A t = carry[b]; carry[b] = run; run = sop (run, t); }
+                // Pass 2: scan each block from its carry
+#pragma omp parallel for schedule(static)
+                for (int b = 0; b < nt; ++b) {
+                    const size_t lo = std::min (n, b * bl);
+                    const size_t hi = std::min (n, lo + bl);
+                    scan_block<V> (ap + lo, op_ + lo, hi - lo, carry[b], ident, op, sop);
+                }
+            }
+
+
+            //! Which kernels and carry type to use for T: float sums and products are carried in double
+            template <typename T> struct sum_kernels { typedef simd<T> V; typedef T A; };
+            template <> struct sum_kernels<float> { typedef widen V; typedef double A; };
+        } // namespace detail
+
+        //! out[i] = a[0] + ... + a[i]
+        template <typename T>
+        void cumsum (const morph::vVector<T>& a, morph::vVector<T>& out)
+        {
+            typedef detail::sum_kernels<T> K;
+            typedef typename K::A A;
+            typedef typename K::V::reg R;
+            detail::scan<typename K::V> (a, out, A{0}, [](R x, R y) { return K::V::add (x, y); }, [](A x, A y) { return x + y; });
+        }
+
+        //! out[i] = a[0] * ... * a[i]
+        template <typename T>
+        void cumprod (const morph::vVector<T>& a, morph::vVector<T>& out)
+        {
+            typedef detail::sum_kernels<T> K;
+            typedef typename K::A A;
+            typedef typename K::V::reg R;
+            detail::scan<typename K::V> (a, out, A{1}, [](R x, R y) { return K::V::mul (x, y); }, [](A x, A y) { return x * y; });
+        }
+
+        //! out[i] = max(a[0], ..., a[i])
+        template <typename T>
+        void cummax (const morph::vVector<T>& a, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> V;
+            typedef typename V::reg R;
+            detail::scan<V> (a, out, std::numeric_limits<T>::lowest(),
+                             [](R x, R y) { return V::max (x, y); }, [](T x, T y) { return x > y ? x : y; });
+        }
+
+        //! out[i] = min(a[0], ..., a[i])
+        template <typename T>
+        void cummin (const morph::vVector<T>& a, morph::vVector<T>& out)
+        {
+            typedef detail::simd<T> V;
+            typedef typename V::reg R;
+            detail::scan<V> (a, out, std::numeric_limits<T>::max(),
+                             [](R x, R y) { return V::min (x, y); }, [](T x, T y) { return x < y ? x : y; });
+        }
+
+    } // namespace scan
+} // namespace cc
@@ -0,0 +1,207 @@
+/*
+ * Performance regression gate for the vVector ops timed in exercise.cpp.
+ *
+ *   regression --save baseline.txt      record samples for each op and size
+ *   regression --compare baseline.txt   take new samples and compare with the baseline
+ *
+ * Each sample is the time for a fixed amount of work (about 2M elements) of one op at
+ * one vector size. A comparison uses the one-sided Mann-Whitney U test (normal
+ * approximation with tie correction) to ask whether the new times are larger, and the
+ * Hodges-Lehmann estimator, with its 95% confidence interval, for the size of the
+ * slowdown. An op/size fails if p < 0.01 and the lower end of the confidence interval is
+ * a slowdown of more than --threshold percent (default 5). Any failure gives exit status
+ * 1. A missing baseline gives exit status 77, which ctest treats as "skipped".
+ *
+ * Other options: --samples N (default 15).
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <morph/vVector.h>
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+// How much numerical precision in the test numbers?
+typedef float F;
+
+// Vector sizes to test, from "fits in L1" to "streams from DRAM"
+const std::vector<size_t> sizes = { 1000, 100000, 1000000 };
+
+// Key for one op at one size, e.g. "vector_mult 100000"
+typedef std::map<std::string, std::vector<double>> samples_t;
+
+samples_t measure (int n_samples)
+{
+    samples_t samples;
+    for (size_t n : sizes) {
+        morph::vVector<F> v(n), v2(n), v3(n);
+        v.randomize (F{1}, F{2});
+        v3.randomize (F{1}, F{2});
+        const int reps = static_cast<int>(std::max (size_t{1}, 2000000 / n));
+
+        std::vector<std::pair<std::string, std::function<void(int)>>> ops = {
+            { "scalar_mult", [&](int i) { v.mult (static_cast<F>(i), v2); } },
+            { "vector_mult", [&](int) { v2 = v * v3; } },
+            { "vector_div",  [&](int) { v2 = v / v3; } },
+            { "pow",         [&](int i) { v2 = v.pow (F{1} / (i + 1)); } }
+        };
+        for (auto& op : ops) {
+            std::string key = op.first + " " + std::to_string (n);
+            op.second (0); // warm up
+            for (int s = 0; s < n_samples; ++s) {
+                steady_clock::time_point start = steady_clock::now();
+                for (int i = 0; i < reps; ++i) { op.second (i); }
+                steady_clock::duration d = steady_clock::now() - start;
+                samples[key].push_back (duration_cast<nanoseconds>(d).count() / 1e6);
+            }
+        }
+    }
+    return samples;
+}
+
+void save (const std::string& path, const samples_t& samples)
+{
+    std::ofstream f (path);
+    if (!f) { throw std::runtime_error ("Can't write " + path); }
+    f << std::setprecision(9);
+    for (const auto& kv : samples) {
+        f << kv.first;
+        for (double t : kv.second) { f << " " << t; }
+        f << "\n";
+    }
+}
+
+samples_t load (const std::string& path)
+{
+    samples_t samples;
+    std::ifstream f (path);
+    if (!f) { return samples; }
+    std::string line;
+    while (std::getline (f, line)) {
+        std::istringstream ss (line);
+        std::string op, n;
+        if (!(ss >> op >> n)) { continue; }
+        double t;
+        std::vector<double>& v = samples[op + " " + n];
+        while (ss >> t) { v.push_back (t); }
+    }
+    return samples;
+}
+
+// One-sided Mann-Whitney p value for "b tends to be larger than a"
+double mann_whitney_p (const std::vector<double>& a, const std::vector<double>& b)
+{
+    // Rank the pooled samples, averaging ranks over ties
+    std::vector<std::pair<double, int>> pooled;
+    for (double x : a) { pooled.push_back ({x, 0}); }
+    for (double x : b) { pooled.push_back ({x, 1}); }
+    std::sort (pooled.begin(), pooled.end());
+    const double n1 = a.size();
+    const double n2 = b.size();
+    const double N = n1 + n2;
+    double rank_sum_b = 0.0;
+    double tie_term = 0.0;
+    for (size_t i = 0; i < pooled.size(); ) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first) { ++j; }
+        double avg_rank = (i + 1 + j) / 2.0;
+        double t = static_cast<double>(j - i);
+        tie_term += t * t * t - t;
+        for (size_t k = i; k < j; ++k) { if (pooled[k].second == 1) { rank_sum_b += avg_rank; } }
+        i = j;
+    }
+    double U = rank_sum_b - n2 * (n2 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double sigma = std::sqrt (n1 * n2 / 12.0 * ((N + 1) - tie_term / (N * (N - 1))));
+    if (sigma == 0.0) { return 0.5; }
+    double z = (U - mean - 0.5) / sigma; // with continuity correction
+    return 0.5 * std::erfc (z / std::sqrt (2.0));
+}
+
+// Hodges-Lehmann estimate (and 95% CI) of the shift in log time from a to b
+void hodges_lehmann (const std::vector<double>& a, const std::vector<double>& b,
+                     double& est, double& lo, double& hi)
+{
+    std::vector<double> d;
+    for (double y : b) { for (double x : a) { d.push_back (std::log (y) - std::log (x)); } }
+    std::sort (d.begin(), d.end());
+    const double n1 = a.size();
+    const double n2 = b.size();
+    est = d.size() % 2 ? d[d.size() / 2] : 0.5 * (d[d.size() / 2 - 1] + d[d.size() / 2]);
+    // k is the 1-based rank of the lower bound among the sorted differences; the upper
+    // bound is the k-th from the top
+    double k = n1 * n2 / 2.0 - 1.96 * std::sqrt (n1 * n2 * (n1 + n2 + 1) / 12.0);
+    size_t ki = static_cast<size_t>(std::max (1.0, std::floor (k)));
+    ki = std::min (ki, (d.size() + 1) / 2);
+    lo = d[ki - 1];
+    hi = d[d.size() - ki];
+}
+
+int main (int argc, char** argv)
+{
+    std::string save_path, compare_path;
+    int n_samples = 15;
+    double threshold = 5.0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--save" && i + 1 < argc) { save_path = argv[++i]; }
+        else if (arg == "--compare" && i + 1 < argc) { compare_path = argv[++i]; }
+        else if (arg == "--samples" && i + 1 < argc) { n_samples = std::atoi (argv[++i]); }
+        else if (arg == "--threshold" && i + 1 < argc) { threshold = std::atof (argv[++i]); }
+        else {
+            std::cerr << "Usage: " << argv[0] << " (--save FILE | --compare FILE) [--samples N] [--threshold PCT]" << std::endl;
+            return 2;
+        }
+    }
+    if (save_path.empty() == compare_path.empty()) {
+        std::cerr << "Give exactly one of --save or --compare" << std::endl;
+        return 2;
+    }
+
+    if (!save_path.empty()) {
+        save (save_path, measure (n_samples));
+        std::cout << "Saved baseline to " << save_path << std::endl;
+        return 0;
+    }
+
+    samples_t base = load (compare_path);
+    if (base.empty()) {
+        std::cout << "No baseline in " << compare_path << "; run with --save first" << std::endl;
+        return 77;
+    }
+
+    samples_t now = measure (n_samples);
+    int failures = 0;
+    for (const auto& kv : now) {
+        auto bi = base.find (kv.first);
+        if (bi == base.end() || bi->second.size() < 2) {
+            std::cout << std::left << std::setw(22) << kv.first << " not in baseline" << std::endl;
+            continue;
+        }
+        double p = mann_whitney_p (bi->second, kv.second);
+        double est, lo, hi;
+        hodges_lehmann (bi->second, kv.second, est, lo, hi);
+        // As percentages
+        est = 100.0 * (std::exp (est) - 1.0);
+        lo = 100.0 * (std::exp (lo) - 1.0);
+        hi = 100.0 * (std::exp (hi) - 1.0);
+        bool fail = p < 0.01 && lo > threshold;
+        if (fail) { ++failures; }
+        std::cout << std::left << std::setw(22) << kv.first << std::right << std::fixed << std::setprecision(1)
+                  << " change " << std::setw(6) << est << " % [" << lo << ", " << hi << "]"
+                  << " p = " << std::setprecision(4) << p << (fail ? "  SLOWER" : "") << std::endl;
+    }
+    std::cout << (failures ? std::to_string (failures) + " significant slowdown(s)" : std::string("No significant slowdowns")) << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * A roofline for this host, and where the exercise.cpp kernels sit on it.
+ *
+ * First measure the machine: a STREAM-style triad (a = b + s * c) with AVX2 or AVX-512
+ * intrinsics, at working set sizes that fit in L1, L2, L3 and only in DRAM, then the peak
+ * FMA throughput with enough independent accumulators to hide FMA latency. Each thread
+ * runs its own copy, so the figures are for the whole machine.
+ *
+ * Then time the vVector, Eigen and FloatVec kernels, and for each report its arithmetic
+ * intensity (flops per byte of memory traffic), achieved GFLOP/s, the attainable
+ * GFLOP/s at that intensity, min(peak, AI * bandwidth), using the bandwidth of the level
+ * that the kernel's working set fits in, and the percentage of attainable reached.
+ *
+ * Build roofline for the AVX2 version and roofline512 for AVX-512.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <immintrin.h>
+#include <Eigen/Dense>
+#include <morph/vVector.h>
+#include <morph/aligned_allocator.h>
+// The workshop headers compare signed with unsigned; they're not ours to change
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#include "chryswoods/floatvec.h"
+#pragma GCC diagnostic pop
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+#ifdef __GLN__
+# include <unistd.h>
+#endif
+
+using namespace std::chrono;
+using std::chrono::steady_clock;
+
+typedef float F;
+typedef Eigen::Array<F, Eigen::Dynamic, 1> EigenVec;
+
+#if defined(__AVX512F__)
+typedef __m512 vreg;
+const int lanes = 16;
+inline vreg vload (const float* p) { return _mm512_load_ps (p); }
+inline void vstore (float* p, vreg v) { _mm512_store_ps (p, v); }
+inline vreg vset1 (float f) { return _mm512_set1_ps (f); }
+inline vreg vfma (vreg a, vreg b, vreg c) { return _mm512_fmadd_ps (a, b, c); }
+#else
+typedef __m256 vreg;
+const int lanes = 8;
+inline vreg vload (const float* p) { return _mm256_load_ps (p); }
+inline void vstore (float* p, vreg v) { _mm256_store_ps (p, v); }
+inline vreg vset1 (float f) { return _mm256_set1_ps (f); }
+inline vreg vfma (vreg a, vreg b, vreg c) { return _mm256_fmadd_ps (a, b, c); }
+#endif
+
+typedef std::vector<float, morph::aligned_allocator<float, 64>> avec;
+
+int n_threads()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// One level of the memory hierarchy, as measured
+struct level
+{
+    std::string name;
+    size_t capacity;         // bytes that fit in this level, summed over all the threads' share of it
+    size_t bytes_per_thread; // working set of the triad on each thread
+    double gbps;             // measured whole-machine bandwidth
+};
+
+// Cache size from sysconf where glibc knows it, else a typical value
+size_t cache_size (int level, size_t fallback)
+{
+    long sz = 0;
+#if defined(__GLN__) && defined(_SC_LEVEL1_DCACHE_SIZE)
+    if (level == 1) { sz = sysconf (_SC_LEVEL1_DCACHE_SIZE); }
+    else if (level == 2) { sz = sysconf (_SC_LEVEL2_CACHE_SIZE); }
+    else if (level == 3) { sz = sysconf (_SC_LEVEL3_CACHE_SIZE); }
+#endif
+    return sz > 0 ? static_cast<size_t>(sz) : fallback;
+}
+
+// Triad bandwidth in GB/s with bytes_per_thread of working set (3 arrays) on every thread
+double triad_bandwidth (size_t bytes_per_thread)
+{
+    const size_t n = (bytes_per_thread / (3 * sizeof(float))) / lanes * lanes;
+    // Repeat enough times to move about 2 GB per thread, so each measurement takes a while
+    const size_t reps = std::max (size_t{2}, (size_t{2} << 30) / (3 * n * sizeof(float)));
+    double seconds = 0.0;
+#pragma omp parallel reduction(max:seconds)
+    {
+        avec a(n), b(n, 1.0f), c(n, 2.0f);
+        const vreg s = vset1 (0.5f);
+        // Warm up (and fault the pages in)
+        for (size_t i = 0; i < n; i += lanes) { vstore (&a[i], vfma (s, vload (&c[i]), vload (&b[i]))); }
+#pragma omp barrier
+        steady_clock::time_point start = steady_clock::now();
+        for (size_t r = 0; r < reps; ++r) {
+            for (size_t i = 0; i < n; i += lanes) { vstore (&a[i], vfma (s, vload (&c[i]), vload (&b[i]))); }
+            // Stop the compiler from collapsing the repeats into one
+            __asm__ __volatile__ ("" : : "r"(a.data()) : "memory");
+        }
+        seconds = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1e9;
+    }
+    return static_cast<double>(n_threads()) * reps * 3 * n * sizeof(float) / seconds / 1e9;
+}
+
+// Peak FMA throughput in GFLOP/s, all threads
+double peak_gflops()
+{
+    // 10 independent chains covers 4-5 cycle latency on two FMA ports
+    const int chains = 10;
+    const size_t iters = 100000000 / lanes;
+    double seconds = 0.0;
+    float sink = 0.0f;
+#pragma omp parallel reduction(max:seconds) reduction(+:sink)
+    {
+        vreg acc[chains];
+        for (int c = 0; c < chains; ++c) { acc[c] = vset1 (static_cast<float>(c)); }
+        const vreg m = vset1 (0.999999f);
+        const vreg k = vset1 (1e-7f);
+        steady_clock::time_point start = steady_clock::now();
+        for (size_t i = 0; i < iters; ++i) {
+            for (int c = 0; c < chains; ++c) { acc[c] = vfma (acc[c], m, k); }
+        }
+        seconds = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1e9;
+        alignas(64) float out[lanes];
+        for (int c = 0; c < chains; ++c) {
+            vstore (out, acc[c]);
+            sink += out[0];
+        }
+    }
+    if (sink == 12345.0f) { std::cout << ""; } // keep the result live
+    return static_cast<double>(n_threads()) * iters * chains * lanes * 2 / seconds / 1e9;
+}
+
+// A benchmarked kernel and its place on the roofline
+void place (const std::string& what, double flops_per_elem, double bytes_per_elem, size_t n,
+            int reps, steady_clock::duration d, const std::vector<level>& levels, double peak)
+{
+    double ai = flops_per_elem / bytes_per_elem;
+    double secs = duration_cast<nanoseconds>(d).count() / 1e9;
+    double achieved = flops_per_elem * n * reps / secs / 1e9;
+    // The smallest level whose (whole machine) capacity holds the working set
+    size_t ws = static_cast<size_t>(bytes_per_elem * n);
+    const level* lv = &levels.back();
+    for (const auto& l : levels) {
+        if (ws <= l.capacity) { lv = &l; break; }
+    }
+    double attainable = std::min (peak, ai * lv->gbps);
+    std::cout << std::left << std::setw(28) << what << std::right
+              << " AI " << std::setw(7) << std::setprecision(3) << ai
+              << " GFLOP/s " << std::setw(8) << achieved
+              << " attainable " << std::setw(8) << attainable << " (" << lv->name << ")"
+              << " = " << std::setw(5) << std::setprecision(3) << (100.0 * achieved / attainable) << " %" << std::endl;
+}
+
+int main()
+{
+    std::cout << "Threads: " << n_threads() << ", SIMD lanes: " << lanes << std::endl;
+
+    // L1 and L2 are per core; L3 is shared, so each thread gets a share of it. The
+    // triad uses half of each thread's share, to stay clear of conflict misses.
+    const size_t nt = static_cast<size_t>(n_threads());
+    const size_t l1 = cache_size (1, 32 * 1024);
+    const size_t l2 = cache_size (2, 1024 * 1024);
+    const size_t l3 = cache_size (3, 16 * 1024 * 1024);
+    std::vector<level> levels = {
+        { "L1", l1 * nt, l1 / 2, 0.0 },
+        { "L2", l2 * nt, l2 / 2, 0.0 },
+        { "L3", l3, l3 / nt / 2, 0.0 },
+        { "DRAM", ~size_t{0}, std::max (size_t{256} << 20, 8 * l3 / nt), 0.0 }
+    };
+    for (auto& l : levels) {
+        l.gbps = triad_bandwidth (l.bytes_per_thread);
+        std::cout << "Triad bandwidth (" << l.name << ", " << l.bytes_per_thread / 1024 << " KB per thread): "
+                  << l.gbps << " GB/s" << std::endl;
+    }
+    double peak = peak_gflops();
+    std::cout << "Peak FMA throughput: " << peak << " GFLOP/s" << std::endl;
+    std::cout << "Ridge point: " << peak / levels.back().gbps << " flops/byte (DRAM)" << std::endl << std::endl;
+
+    // Now the exercise.cpp kernels. Traffic counts reads and writes of 4 byte floats (not
+    // write-allocate reads). pow is counted as one (expensive) flop per element.
+    const size_t n = 1000000;
+    const int reps = 500;
+    steady_clock::time_point start;
+    steady_clock::duration d;
+
+    morph::vVector<F> v(n), v2(n), v3(n);
+    v.randomize();
+    v3.randomize();
+    EigenVec ev(n), ev2(n), ev3(n);
+    for (size_t i = 0; i < n; ++i) { ev[i] = v[i]; ev3[i] = v3[i]; }
+
+    start = steady_clock::now();
+    for (F i = F{0}; i < F{500}; i += F{1}) { v.mult (i, v2); }
+    d = steady_clock::now() - start;
+    place ("Scalar mult (vVector)", 1, 8, n, reps, d, levels, peak);
+
+    start = steady_clock::now();
+    for (F i = F{0}; i < F{500}; i += F{1}) { ev2 = ev * i; }
+    d = steady_clock::now() - start;
+    place ("Scalar mult (Eigen)", 1, 8, n, reps, d, levels, peak);
+
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { v2 = v * v3; }
+    d = steady_clock::now() - start;
+    place ("Vector mult (vVector)", 1, 12, n, reps, d, levels, peak);
+
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { ev2 = ev * ev3; }
+    d = steady_clock::now() - start;
+    place ("Vector mult (Eigen)", 1, 12, n, reps, d, levels, peak);
+
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { v2 = v / v3; }
+    d = steady_clock::now() - start;
+    place ("Vector div (vVector)", 1, 12, n, reps, d, levels, peak);
+
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) { ev2 = ev / ev3; }
+    d = steady_clock::now() - start;
+    place ("Vector div (Eigen)", 1, 12, n, reps, d, levels, peak);
+
+    start = steady_clock::now();
+    for (F i = F{1}; i <= F{500}; i += F{1}) { v2 = v.pow (F{1}/i); }
+    d = steady_clock::now() - start;
+    place ("Raise to power (vVector)", 1, 8, n, reps, d, levels, peak);
+
+    start = steady_clock::now();
+    for (F i = F{1}; i <= F{500}; i += F{1}) { ev2 = ev.pow (F{1}/i); }
+    d = steady_clock::now() - start;
+    place ("Raise to power (Eigen)", 1, 8, n, reps, d, levels, peak);
+
+    // FloatVec only has + and sqrt
+    workshop::Array<float> wa (v.begin(), v.end());
+    workshop::Array<float> wb (v3.begin(), v3.end());
+    FloatVec::Array fa = FloatVec::fromArray (wa);
+    FloatVec::Array fb = FloatVec::fromArray (wb);
+    FloatVec::Array fc (fa.size());
+    start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) {
+        for (size_t j = 0; j < fa.size(); ++j) { fc[j] = fa[j] + fb[j]; }
+        __asm__ __volatile__ ("" : : "r"(fc.data()) : "memory");
+    }
+    d = steady_clock::now() - start;
+    place ("Vector add (FloatVec)", 1, 12, fa.size() * FloatVec::size(), reps, d, levels, peak);
+
+    return 0;
+}
@@ -0,0 +1,411 @@
+/*
+ * vVector data shared between worker processes on one host, in a named POSIX shared memory
+ * segment, instead of copied between them over pipes. A team of nprocs processes maps the
+ * segment; each owns a contiguous, cache line aligned part of every vector in it, computes
+ * on that part, and meets the others at a barrier. The barrier, and the slots that
+ * reductions are gathered in, live in the segment too. They're built only on lock-free
+ * atomics, so no process ever takes a lock that a dying peer could leave held. That
+ * doesn't make a team survive a dead peer: the others wait for it at the next barrier,
+ * which throws after cc::shm::barrier_timeout seconds rather than spinning forever.
+ * The team can't be used after that, and its processes should exit.
+ *
+ *   // In the process that sets up the job:
+ *   cc::shm::team t = cc::shm::team::create ("/fields", 4, bytes);        // rank 0
+ *   // In each of the other three (forked, or started separately):
+ *   cc::shm::team t = cc::shm::team::attach ("/fields", rank);            // rank 1, 2 or 3
+ *   // Then in all four, allocating the same vectors in the same order:
+ *   cc::shm::shared_vector<float> a = t.alloc<float> (n), b = t.alloc<float> (n), c = t.alloc<float> (n);
+ *   cc::shm::mult (t, a, b, c);            // c = a * b, each process its own part, then a barrier
+ *   double d = cc::shm::dot (t, a, b);     // the same value in every process
+ *
+ * Vectors are placed by a bump allocator that every process runs identically, so they get
+ * the same offsets (the segment may be mapped at different addresses in each process).
+ * Reductions sum each process's part in double and add the parts in rank order, so the
+ * result doesn't depend on timing. The creator unlinks the segment when its team is
+ * destroyed; processes already attached keep their mappings until they're done. attach
+ * may be called before create: it waits, up to cc::shm::attach_timeout seconds, for the
+ * segment to be created, sized and initialised.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+#endif
+
+namespace cc {
+    namespace shm {
+
+        //! The largest team a segment has barrier and reduction slots for
+        constexpr int max_procs = 256;
+
+        //! Alignment of each vector in the segment, and of the parts processes own
+        constexpr size_t align = 64;
+
+        //! Seconds team::attach waits for the segment to be created and made ready
+        inline double attach_timeout = 10.0;
+
+        //! Seconds team::barrier waits for the rest of the team before it throws. 0 waits forever.
+        inline double barrier_timeout = 60.0;
+
+        namespace detail {
+
+            static_assert (std::atomic<uint32_t>::is_always_lock_free, "shm: needs lock-free 32 bit atomics");
+
+            constexpr uint64_t magic = 0x63632d73686d3031ull; // "cc-shm01"
+
+            //! A double on a cache line of its own
+            struct alignas(64) slot { double v; };
+
+            //! The start of the segment, before the vectors
+            struct alignas(64) control
+            {
+                std::atomic<uint64_t> ready;
+                uint64_t bytes;
+                uint32_t nprocs;
+                alignas(64) std::atomic<uint32_t> arrived;
+                alignas(64) std::atomic<uint32_t> generation;
+                //! Reduction partials, double buffered by barrier generation
+                slot partial[2][max_procs];
+            };
+
+            inline void pause()
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                _mm_pause();
+#endif
+            }
+
+            inline size_t round_up (size_t x, size_t a) { return (x + a - 1) / a * a; }
+
+            inline std::runtime_error fail (const std::string& what, const std::string& name)
+            {
+                return std::runtime_error ("shm: " + what + " " + name + ": " + std::strerror (errno));
+            }
+        } // namespace detail
+
+        //! A vector in a team's segment. Copies refer to the same elements.
+        template <typename T>
+        struct shared_vector
+        {
+            shared_vector() {}
+            shared_vector (T* d, size_t n) : p(d), n(n) {}
+
+            size_t size() const { return this->n; }
+            T* data() { return this->p; }
+            const T* data() const { return this->p; }
+            T& operator[] (size_t i) { return this->p[i]; }
+            const T& operator[] (size_t i) const { return this->p[i]; }
+            T* begin() { return this->p; }
+            T* end() { return this->p + this->n; }
+            const T* begin() const { return this->p; }
+            const T* end() const { return this->p + this->n; }
+
+            //! Copy a vVector in (from one process, followed by a barrier, or from each into its own part)
+            void assign (const morph::vVector<T>& v, size_t i0 = 0, size_t i1 = std::numeric_limits<size_t>::max())
+            {
+                if (v.size() != this->n) { throw std::runtime_error ("shm: vVector is a different size"); }
+                i1 = std::min (i1, this->n);
+                std::copy (v.begin() + i0, v.begin() + i1, this->p + i0);
+            }
+            //! A private copy, as a vVector
+            morph::vVector<T> to_vvector() const { return morph::vVector<T> (this->p, this->p + this->n); }
+
+        private:
+            T* p = nullptr;
+            size_t n = 0;
+        };
+
+        /*!
+         * One process's handle on a shared segment and its team of nprocs processes. Move
+         * only; the creator's handle unlinks the segment's name when it's destroyed.
+         */
+        class team
+        {
+        public:
+            //! Create the segment name, with room for bytes of vectors, as rank 0 of nprocs
+            static team create (const std::string& name, int nprocs, size_t bytes)
+            {
+                if (nprocs < 1 || nprocs > max_procs) { throw std::runtime_error ("shm: team size must be 1 to " + std::to_string (max_procs)); }
+                const size_t total = detail::round_up (sizeof(detail::control), align) + bytes;
+                int fd = shm_open (name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+                if (fd < 0) { throw detail::fail ("can't create", name); }
+                if (ftruncate (fd, static_cast<off_t>(total)) != 0) {
+                    close (fd);
+                    shm_unlink (name.c_str());
+                    throw detail::fail ("can't size", name);
+                }
+                team t (name, fd, total, 0, true);
+                detail::control* c = new (t.base) detail::control;
+                c->bytes = total;
+                c->nprocs = static_cast<uint32_t>(nprocs);
+                c->arrived.store (0, std::memory_order_relaxed);
+                c->generation.store (0, std::memory_order_relaxed);
+                // Last, so that attach doesn't see a half made control block
+                c->ready.store (detail::magic, std::memory_order_release);
+                return t;
+            }
+
+            /*!
+             * Attach to the segment name, created by another process, as rank. The creator
+             * may not have got as far as creating, sizing or initialising the segment yet, so
+             * each is waited for, up to attach_timeout seconds in all.
+             */
+            static team attach (const std::string& name, int rank)
+            {
+                const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+                    + std::chrono::duration_cast<std::chrono::steady_clock::duration> (std::chrono::duration<double> (attach_timeout));
+                for (;; std::this_thread::sleep_for (std::chrono::milliseconds (1))) {
+                    const bool late = std::chrono::steady_clock::now() > deadline;
+                    int fd = shm_open (name.c_str(), O_RDWR, 0600);
+                    if (fd < 0) {
+                        if (errno != ENOENT || late) { throw detail::fail ("can't open", name); }
+                        continue;
+                    }
+                    struct stat st;
+                    if (fstat (fd, &st) != 0) {
+                        const std::runtime_error e = detail::fail ("can't stat", name);
+                        close (fd);
+                        throw e;
+                    }
+                    // Created, but not sized yet
+                    if (static_cast<size_t>(st.st_size) < sizeof(detail::control)) {
+                        close (fd);
+                        if (late) { throw std::runtime_error ("shm: " + name + " is not a team segment (too small)"); }
+                        continue;
+                    }
+                    team t (name, fd, static_cast<size_t>(st.st_size), rank, false);
+                    // Sized, but the control block may not be written yet
+                    while (t.ctl()->ready.load (std::memory_order_acquire) != detail::magic) {
+                        if (std::chrono::steady_clock::now() > deadline) {
+                            throw std::runtime_error ("shm: " + name + " is not a team segment (never made ready)");
+                        }
+                        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+                    }
+                    if (t.ctl()->bytes != t.bytes) { throw std::runtime_error ("shm: " + name + " is not the size its team made it"); }
+                    if (rank < 1 || rank >= t.size()) { throw std::runtime_error ("shm: rank out of range for the team"); }
+                    return t;
+                }
+            }
+
+            team (team&& o) noexcept { this->take (o); }
+            team& operator= (team&& o) noexcept
+            {
+                if (this != &o) {
+                    this->release();
+                    this->take (o);
+                }
+                return *this;
+            }
+            team (const team&) = delete;
+            team& operator= (const team&) = delete;
+            ~team() { this->release(); }
+
+            int rank() const { return this->r; }
+            int size() const { return static_cast<int>(this->ctl()->nprocs); }
+
+            //! The next n element vector in the segment. Every process must make the same calls in the same order.
+            template <typename T>
+            shared_vector<T> alloc (size_t n)
+            {
+                const size_t off = detail::round_up (this->used, align);
+                if (off + n * sizeof(T) > this->bytes) { throw std::runtime_error ("shm: segment " + this->name + " is full"); }
+                this->used = off + n * sizeof(T);
+                return shared_vector<T> (reinterpret_cast<T*>(this->base + off), n);
+            }
+
+            //! This process's part, [i0, i1), of an n element vector of T. Parts start on cache lines.
+            template <typename T>
+            std::pair<size_t, size_t> part (size_t n) const
+            {
+                const size_t per_line = std::max (size_t{1}, align / sizeof(T));
+                const size_t lines = (n + per_line - 1) / per_line;
+                const size_t p = static_cast<size_t>(this->size());
+                const size_t rr = static_cast<size_t>(this->r);
+                return { std::min (n, lines * rr / p * per_line), std::min (n, lines * (rr + 1) / p * per_line) };
+            }
+
+            /*!
+             * Wait until every process in the team has arrived. A sense reversing barrier: the
+             * last to arrive resets the count and moves the generation on, releasing the rest.
+             * Waiters spin briefly, then yield, as the team may have more processes than cores.
+             * Throws if the rest of the team hasn't arrived within barrier_timeout seconds (a
+             * peer has died, or is stuck); the barrier's count is then wrong for good, so the
+             * team can't be used again.
+             */
+            void barrier()
+            {
+                detail::control* c = this->ctl();
+                const uint32_t g = c->generation.load (std::memory_order_acquire);
+                if (c->arrived.fetch_add (1, std::memory_order_acq_rel) + 1 == c->nprocs) {
+                    c->arrived.store (0, std::memory_order_relaxed);
+                    c->generation.store (g + 1, std::memory_order_release);
+                    return;
+                }
+                const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                for (int spins = 0; c->generation.load (std::memory_order_acquire) == g; ++spins) {
+                    if (spins < 1024) {
+                        detail::pause();
+                        continue;
+                    }
+                    sched_yield();
+                    if (barrier_timeout > 0.0 && spins % 1024 == 0
+                        && std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count() > barrier_timeout) {
+                        throw std::runtime_error ("shm: rank " + std::to_string (this->r) + " timed out at a barrier of " + this->name
+                                                  + "; a process in the team has died or is stuck");
+                    }
+                }
+            }
+
+            //! The sum over the team of each process's x, in rank order, in every process
+            double reduce (double x)
+            {
+                detail::control* c = this->ctl();
+                // The buffer not being read by anyone who might still be in the last reduction
+                const uint32_t b = c->generation.load (std::memory_order_acquire) & 1;
+                c->partial[b][this->r].v = x;
+                this->barrier();
+                double s = 0.0;
+                for (int k = 0; k < this->size(); ++k) { s += c->partial[b][k].v; }
+                return s;
+            }
+
+        private:
+            team (const std::string& nm, int fd, size_t total, int rank, bool own)
+                : name(nm), bytes(total), r(rank), owner(own)
+            {
+                void* m = mmap (nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                close (fd);
+                if (m == MAP_FAILED) {
+                    if (own) { shm_unlink (nm.c_str()); }
+                    throw detail::fail ("can't map", nm);
+                }
+                this->base = static_cast<char*>(m);
+                this->used = detail::round_up (sizeof(detail::control), align);
+            }
+
+            detail::control* ctl() const { return reinterpret_cast<detail::control*>(this->base); }
+
+            void take (team& o)
+            {
+                this->name = std::move (o.name);
+                this->base = o.base;
+                this->bytes = o.bytes;
+                this->used = o.used;
+                this->r = o.r;
+                this->owner = o.owner;
+                o.base = nullptr;
+                o.owner = false;
+            }
+
+            void release()
+            {
+                if (this->base != nullptr) { munmap (this->base, this->bytes); }
+                if (this->owner) { shm_unlink (this->name.c_str()); }
+                this->base = nullptr;
+                this->owner = false;
+            }
+
+            std::string name;
+            char* base = nullptr;
+            size_t bytes = 0;
+            size_t used = 0;
+            int r = 0;
+            bool owner = false;
+        };
+
+        //! fn(i0, i1) over this process's part of n elements of T, then a barrier
+        template <typename T, typename Fn>
+        void for_part (team& t, size_t n, Fn fn)
+        {
+            const std::pair<size_t, size_t> pr = t.template part<T> (n);
+            if (pr.first < pr.second) { fn (pr.first, pr.second); }
+            t.barrier();
+        }
+
+        namespace detail {
+            template <typename A, typename B>
+            void check_sizes (const A& a, const B& b)
+            {
+                if (a.size() != b.size()) { throw std::runtime_error ("shm: vectors must be the same size"); }
+            }
+        } // namespace detail
+
+        //! out = a * b
+        template <typename T>
+        void mult (team& t, const shared_vector<T>& a, const shared_vector<T>& b, shared_vector<T>& out)
+        {
+            detail::check_sizes (a, b);
+            detail::check_sizes (a, out);
+            const T* ap = a.data();
+            const T* bp = b.data();
+            T* op = out.data();
+            for_part<T> (t, a.size(), [&](size_t i0, size_t i1) { for (size_t i = i0; i < i1; ++i) { op[i] = ap[i] * bp[i]; } });
+        }
+
+        //! out = a * s
+        template <typename T>
+        void mult (team& t, const shared_vector<T>& a, T s, shared_vector<T>& out)
+        {
+            detail::check_sizes (a, out);
+            const T* ap = a.data();
+            T* op = out.data();
+            for_part<T> (t, a.size(), [&](size_t i0, size_t i1) { for (size_t i = i0; i < i1; ++i) { op[i] = ap[i] * s; } });
+        }
+
+        //! out = a + b
+        template <typename T>
+        void add (team& t, const shared_vector<T>& a, const shared_vector<T>& b, shared_vector<T>& out)
+        {
+            detail::check_sizes (a, b);
+            detail::check_sizes (a, out);
+            const T* ap = a.data();
+            const T* bp = b.data();
+            T* op = out.data();
+            for_part<T> (t, a.size(), [&](size_t i0, size_t i1) { for (size_t i = i0; i < i1; ++i) { op[i] = ap[i] + bp[i]; } });
+        }
+
+        //! The sum of a's elements, in every process
+        template <typename T>
+        double sum (team& t, const shared_vector<T>& a)
+        {
+            const std::pair<size_t, size_t> pr = t.template part<T> (a.size());
+            const T* ap = a.data();
+            double s = 0.0;
+            for (size_t i = pr.first; i < pr.second; ++i) { s += ap[i]; }
+            return t.reduce (s);
+        }
+
+        //! The dot product of a and b, in every process
+        template <typename T>
+        double dot (team& t, const shared_vector<T>& a, const shared_vector<T>& b)
+        {
+            detail::check_sizes (a, b);
+            const std::pair<size_t, size_t> pr = t.template part<T> (a.size());
+            const T* ap = a.data();
+            const T* bp = b.data();
+            double s = 0.0;
+            for (size_t i = pr.first; i < pr.second; ++i) { s += static_cast<double>(ap[i]) * bp[i]; }
+            return t.reduce (s);
+        }
+
+    } // namespace shm
+} // namespace cc
@@ -0,0 +1,481 @@
+/*
+ * Order statistics for vVectors: sort, argsort, nth_element, median and quantiles.
+ *
+ * The sort is a quicksort whose partition step runs a register at a time (compare against
+ * the pivot, then permute the register so the lanes below the pivot come first, using a
+ * table indexed by the comparison's movemask) and whose base case, up to two registers
+ * of elements, is a bitonic sorting network held in registers. Large inputs are split
+ * between OpenMP tasks after each partition. nth_element and quantiles are quickselects
+ * on the same partition, recursing only into the parts holding the ranks asked for.
+ *
+ *   cc::order::sort (v);                                   // in place
+ *   float med = cc::order::median (v);                     // v is not changed
+ *   std::vector<float> q = cc::order::quantiles (v, { 0.5, 0.9, 0.99 });
+ *   morph::vVector<size_t> idx;
+ *   cc::order::argsort (v, idx);                           // v[idx[0]] is the smallest
+ *
+ * Kernels are AVX2 for float, double and (internally, for argsort) int64. argsort of
+ * floats packs each key with its index into one int64, so it is stable and vectorised,
+ * but limited to 2^32 elements; for other types it sorts indices with std::stable_sort. Data
+ * must not contain NaNs. quantiles interpolate linearly between order statistics, as
+ * numpy's default does.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(__AVX2__)
+# error "sort_ops.h needs at least -mavx2"
+#endif
+
+namespace cc {
+    namespace order {
+
+        //! Ranges longer than this are sorted with OpenMP tasks
+        constexpr size_t parallel_min = 1 << 16;
+
+        namespace detail {
+
+            //! Build a 32-bit lane index vector for permutevar8x32 from a permutation p of N lanes
+            template <int N>
+            inline __m256i perm_idx (const int* p)
+            {
+                alignas(32) int32_t idx[8];
+                constexpr int w = 8 / N; // 32-bit lanes per element
+                for (int i = 0; i < N; ++i) { for (int h = 0; h < w; ++h) { idx[i * w + h] = p[i] * w + h; } }
+                return _mm256_load_si256 (reinterpret_cast<const __m256i*>(idx));
+            }
+            //! A blend mask selecting the lanes i of N for which sel[i]
+            template <int N>
+            inline __m256i lane_mask (const bool* sel)
+            {
+                alignas(32) int32_t m[8];
+                constexpr int w = 8 / N;
+                for (int i = 0; i < N; ++i) { for (int h = 0; h < w; ++h) { m[i * w + h] = sel[i] ? -1 : 0; } }
+                return _mm256_load_si256 (reinterpret_cast<const __m256i*>(m));
+            }
+
+            // The AVX2 kernels for each element type: loads, min/max, the lanes below a pivot as
+            // bits, and permutes and blends by 32-bit lane index/mask vectors
+            struct f32x8
+            {
+                typedef float T;
+                typedef __m256 reg;
+                static constexpr int n = 8;
+                static reg load (const T* p) { return _mm256_loadu_ps (p); }
+                static void store (T* p, reg v) { _mm256_storeu_ps (p, v); }
+                static reg set1 (T f) { return _mm256_set1_ps (f); }
+                static reg min (reg a, reg b) { return _mm256_min_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_ps (a, b); }
+                static int lt (reg v, reg piv) { return _mm256_movemask_ps (_mm256_cmp_ps (v, piv, _CMP_LT_OQ)); }
+                static reg permute (reg v, __m256i idx) { return _mm256_permutevar8x32_ps (v, idx); }
+                static reg blend (reg a, reg b, __m256i m) { return _mm256_blendv_ps (a, b, _mm256_castsi256_ps (m)); }
+                static T highest() { return std::numeric_limits<T>::infinity(); }
+                //! The smallest value greater than t
+                static T successor (T t) { return std::nextafter (t, highest()); }
+            };
+
+            struct f64x4
+            {
+                typedef double T;
+                typedef __m256d reg;
+                static constexpr int n = 4;
+                static reg load (const T* p) { return _mm256_loadu_pd (p); }
+                static void store (T* p, reg v) { _mm256_storeu_pd (p, v); }
+                static reg set1 (T f) { return _mm256_set1_pd (f); }
+                static reg min (reg a, reg b) { return _mm256_min_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_pd (a, b); }
+                static int lt (reg v, reg piv) { return _mm256_movemask_pd (_mm256_cmp_pd (v, piv, _CMP_LT_OQ)); }
+                static reg permute (reg v, __m256i idx) { return _mm256_castps_pd (_mm256_permutevar8x32_ps (_mm256_castpd_ps (v), idx)); }
+                static reg blend (reg a, reg b, __m256i m) { return _mm256_blendv_pd (a, b, _mm256_castsi256_pd (m)); }
+                static T highest() { return std::numeric_limits<T>::infinity(); }
+                static T successor (T t) { return std::nextafter (t, highest()); }
+            };
+
+            struct i64x4
+            {
+                typedef int64_t T;
+                typedef __m256i reg;
+                static constexpr int n = 4;
+                static reg load (const T* p) { return _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(p)); }
+                static void store (T* p, reg v) { _mm256_storeu_si256 (reinterpret_cast<__m256i*>(p), v); }
+                static reg set1 (T f) { return _mm256_set1_epi64x (f); }
+                static reg min (reg a, reg b) { return _mm256_blendv_epi8 (a, b, _mm256_cmpgt_epi64 (a, b)); }
+                static reg max (reg a, reg b) { return _mm256_blendv_epi8 (b, a, _mm256_cmpgt_epi64 (a, b)); }
+                static int lt (reg v, reg piv) { return _mm256_movemask_pd (_mm256_castsi256_pd (_mm256_cmpgt_epi64 (piv, v))); }
+                static reg permute (reg v, __m256i idx) { return _mm256_permutevar8x32_epi32 (v, idx); }
+                static reg blend (reg a, reg b, __m256i m) { return _mm256_blendv_epi8 (a, b, m); }
+                static T highest() { return std::numeric_limits<T>::max(); }
+                static T successor (T t) { return t == highest() ? t : t + 1; }
+            };
+
+            template <typename T> struct kernels_for;
+            template <> struct kernels_for<float> { typedef f32x8 type; };
+            template <> struct kernels_for<double> { typedef f64x4 type; };
+            template <> struct kernels_for<int64_t> { typedef i64x4 type; };
+
+            //! The permutations and masks the kernels for V need, built once
+            template <typename V>
+            struct tables
+            {
+                static constexpr int N = V::n;
+                static constexpr int n_sort_stages = N == 8 ? 6 : 3;
+                static constexpr int n_merge_stages = N == 8 ? 3 : 2;
+                //! For each movemask: the permutation putting the set lanes first, in order
+                __m256i compress[1 << N];
+                //! Bitonic sort of one register: partner permutation and take-the-max mask per stage
+                __m256i sort_idx[n_sort_stages], sort_max[n_sort_stages];
+                //! Bitonic merge (all ascending) of one register
+                __m256i merge_idx[n_merge_stages], merge_max[n_merge_stages];
+                __m256i reverse;
+
+                tables()
+                {
+                    int p[N];
+                    bool sel[N];
+                    for (int m = 0; m < (1 << N); ++m) {
+                        int k = 0;
+                        for (int i = 0; i < N; ++i) { if (m & (1 << i)) { p[k++] = i; } }
+                        for (int i = 0; i < N; ++i) { if (!(m & (1 << i))) { p[k++] = i; } }
+                        this->compress[m] = perm_idx<N> (p);
+                    }
+                    int s = 0;
+                    for (int k = 2; k <= N; k *= 2) {
+                        for (int j = k / 2; j >= 1; j /= 2) {
+                            for (int i = 0; i < N; ++i) {
+                                p[i] = i ^ j;
+                                const bool ascending = (i & k) == 0;
+                                sel[i] = (i < (i ^ j)) != ascending;
+                            }
+                            this->sort_idx[s] = perm_idx<N> (p);
+                            this->sort_max[s] = lane_mask<N> (sel);
+                            ++s;
+                        }
+                    }
+                    s = 0;
+                    for (int j = N / 2; j >= 1; j /= 2) {
+                        for (int i = 0; i < N; ++i) { p[i] = i ^ j; sel[i] = i > (i ^ j); }
+                        this->merge_idx[s] = perm_idx<N> (p);
+                        this->merge_max[s] = lane_mask<N> (sel);
+                        ++s;
+                    }
+                    for (int i = 0; i < N; ++i) { p[i] = N - 1 - i; }
+                    this->reverse = perm_idx<N> (p);
+                }
+
+                static const tables& get() { static const tables t; return t; }
+            };
+
+            //! Sort the lanes of v
+            template <typename V>
+            inline typename V::reg sort_reg (typename V::reg v, const tables<V>& t)
+            {
+                for (int s = 0; s < tables<V>::n_sort_stages; ++s) {
+                    typename V::reg q = V::permute (v, t.sort_idx[s]);
+                    v = V::blend (V::min (v, q), V::max (v, q), t.sort_max[s]);
+                }
+                return v;
+            }
+
+            //! Sort the lanes of a bitonic v
+            template <typename V>
+            inline typename V::reg merge_reg (typename V::reg v, const tables<V>& t)
+            {
+                for (int s = 0; s < tables<V>::n_merge_stages; ++s) {
+                    typename V::reg q = V::permute (v, t.merge_idx[s]);
+                    v = V::blend (V::min (v, q), V::max (v, q), t.merge_max[s]);
+                }
+                return v;
+            }
+
+            //! Sort up to 2 * V::n elements with a bitonic network in two registers
+            template <typename V>
+            void sort_small (typename V::T* a, size_t n)
+            {
+                typedef typename V::T T;
+                const tables<V>& t = tables<V>::get();
+                alignas(32) T buf[2 * V::n];
+                for (int i = 0; i < 2 * V::n; ++i) { buf[i] = V::highest(); }
+                std::memcpy (buf, a, n * sizeof(T));
+                typename V::reg lo = sort_reg<V> (V::load (buf), t);
+                if (n > static_cast<size_t>(V::n)) {
+                    typename V::reg hi = V::permute (sort_reg<V> (V::load (buf + V::n), t), t.reverse);
+                    typename V::reg mn = V::min (lo, hi);
+                    hi = merge_reg<V> (V::max (lo, hi), t);
+                    lo = merge_reg<V> (mn, t);
+                    V::store (buf + V::n, hi);
+                }
+                V::store (buf, lo);
+                std::memcpy (a, buf, n * sizeof(T));
+            }
+
+            //! Partition v about the pivot into the store pointers (see partition)
+            template <typename V>
+            inline void partition_reg (typename V::reg v, typename V::reg piv, typename V::T* a, size_t& l_store, size_t& r_store,
+                                       const tables<V>& t)
+            {
+                const int m = V::lt (v, piv);
+                const int k = __builtin_popcount (static_cast<unsigned>(m));
+                typename V::reg p = V::permute (v, t.compress[m]);
+                // Both full stores land in free space: there are at least n free slots on each side
+                V::store (a + l_store, p);
+                V::store (a + r_store - V::n, p);
+                l_store += k;
+                r_store -= V::n - k;
+            }
+
+            /*!
+             * Partition a[0, n) so that a[0, p) < pivot <= a[p, n) and return p. A register
+             * is loaded from each end first to make space, then each register read (from
+             * whichever end has less free space) is permuted and stored to both ends.
+             */
+            template <typename V>
+            size_t partition (typename V::T* a, size_t n, typename V::T pivot)
+            {
+                size_t left = 0, right = n;
+                // Shorten the range to a whole number of registers with scalar swaps
+                for (size_t r = n % V::n; r > 0; --r) {
+                    if (a[left] < pivot) { ++left; } else { std::swap (a[left], a[--right]); }
+                }
+                if (left == right) { return left; }
+                const tables<V>& t = tables<V>::get();
+                const typename V::reg piv = V::set1 (pivot);
+                if (right - left == static_cast<size_t>(V::n)) {
+                    typename V::reg v = V::load (a + left);
+                    const int m = V::lt (v, piv);
+                    V::store (a + left, V::permute (v, t.compress[m]));
+                    return left + __builtin_popcount (static_cast<unsigned>(m));
+                }
+                const typename V::reg vl = V::load (a + left);
+                const typename V::reg vr = V::load (a + right - V::n);
+                size_t l_store = left, r_store = right;
+                left += V::n;
+                right -= V::n;
+                while (left < right) {
+                    typename V::reg v;
+                    if (r_store - right < left - l_store) {
+                        right -= V::n;
+                        v = V::load (a + right);
+                    } else {
+                        v = V::load (a + left);
+                        left += V::n;
+                    }
+                    partition_reg<V> (v, piv, a, l_store, r_store, t);
+                }
+                // The free space is now the 2 * n slots [l_store, r_store)
+                partition_reg<V> (vl, piv, a, l_store, r_store, t);
+                // and then exactly n slots, so one store places both parts of vr
+                const int m = V::lt (vr, piv);
+                V::store (a + l_store, V::permute (vr, t.compress[m]));
+                return l_store + __builtin_popcount (static_cast<unsigned>(m));
+            }
+
+            //! Median of three
+            template <typename T>
+            inline T median3 (T x, T y, T z) { return std::max (std::min (x, y), std::min (std::max (x, y), z)); }
+
+            template <typename T>
+            T choose_pivot (const T* a, size_t n)
+            {
+                if (n < 1024) { return median3 (a[0], a[n / 2], a[n - 1]); }
+                const size_t s = n / 8;
+                return median3 (median3 (a[0], a[s], a[2 * s]), median3 (a[3 * s], a[4 * s], a[5 * s]),
+                                median3 (a[6 * s], a[7 * s], a[n - 1]));
+            }
+
+            /*!
+             * Partition a[0, n) about a chosen pivot, returning p with a[0, p) <= a[p, n) and
+             * 0 < p < n, or n if a can't be split (all equal, or NaNs) and should be finished
+             * with std::sort. If nothing is below the pivot, the pivot is the minimum, so the
+             * elements equal to it are split off instead.
+             */
+            template <typename V>
+            size_t split (typename V::T* a, size_t n)
+            {
+                const typename V::T pivot = choose_pivot (a, n);
+                size_t p = partition<V> (a, n, pivot);
+                if (p == 0) {
+                    p = partition<V> (a, n, V::successor (pivot));
+                    if (p == 0 || p == n) { return n; }
+                }
+                return p;
+            }
+
+            template <typename V>
+            void quicksort (typename V::T* a, size_t n, int depth)
+            {
+                while (n > static_cast<size_t>(2 * V::n)) {
+                    if (depth-- == 0) { std::sort (a, a + n); return; }
+                    const size_t p = split<V> (a, n);
+                    if (p == n) { std::sort (a, a + n); return; }
+                    // Sort the smaller part (in a task if it's big enough) and carry on with the larger
+                    typename V::T* sa = p < n - p ? a : a + p;
+                    const size_t sn = p < n - p ? p : n - p;
+                    if (p >= n - p) { n = p; } else { a += p; n -= p; }
+                    if (sn >= parallel_min) {
+#pragma omp task firstprivate(sa, sn, depth)
+                        quicksort<V> (sa, sn, depth);
+                    } else {
+                        quicksort<V> (sa, sn, depth);
+                    }
+                }
+                if (n > 1) { sort_small<V> (a, n); }
+            }
+
+            template <typename V>
+            void sort (typename V::T* a, size_t n)
+            {
+                const int depth = 2 * (64 - __builtin_clzll (n | 1));
+                if (n >= parallel_min) {
+#pragma omp parallel
+#pragma omp single nowait
+                    quicksort<V> (a, n, depth);
+                } else {
+                    quicksort<V> (a, n, depth);
+                }
+            }
+
+            /*!
+             * Rearrange a[0, n) so that every rank in ranks[0, nr) (sorted, each < n) holds the
+             * element a sorted a would have there, with smaller elements before it and larger after.
+             */
+            template <typename V>
+            void select (typename V::T* a, size_t n, const size_t* ranks, size_t nr, int depth)
+            {
+                std::vector<size_t> own; // ranks, once they have been shifted into a right part
+                while (nr > 0) {
+                    if (n <= static_cast<size_t>(2 * V::n)) { if (n > 1) { sort_small<V> (a, n); } return; }
+                    if (depth-- == 0) { std::sort (a, a + n); return; }
+                    const size_t p = split<V> (a, n);
+                    if (p == n) { std::sort (a, a + n); return; }
+                    // Ranks [0, nl) are in the left part, the rest in the right
+                    const size_t nl = std::lower_bound (ranks, ranks + nr, p) - ranks;
+                    if (nl < nr) {
+                        std::vector<size_t> right (ranks + nl, ranks + nr);
+                        for (auto& r : right) { r -= p; }
+                        typename V::T* ra = a + p;
+                        const size_t rn = n - p;
+                        if (nl == 0) {
+                            // Nothing to do on the left; carry on with the right
+                            own.swap (right);
+                            ranks = own.data();
+                            a = ra;
+                            n = rn;
+                            continue;
+                        }
+                        if (rn >= parallel_min) {
+#pragma omp task firstprivate(right, ra, rn, depth)
+                            select<V> (ra, rn, right.data(), right.size(), depth);
+                        } else {
+                            select<V> (ra, rn, right.data(), right.size(), depth);
+                        }
+                    }
+                    n = p;
+                    nr = nl;
+                }
+            }
+
+            template <typename V>
+            void select_ranks (typename V::T* a, size_t n, const std::vector<size_t>& ranks)
+            {
+                const int depth = 2 * (64 - __builtin_clzll (n | 1));
+                if (n >= parallel_min && ranks.size() > 1) {
+#pragma omp parallel
+#pragma omp single nowait
+                    select<V> (a, n, ranks.data(), ranks.size(), depth);
+                } else {
+                    select<V> (a, n, ranks.data(), ranks.size(), depth);
+                }
+            }
+
+            //! An int64 that orders as the float f does, with the index i in the low 32 bits
+            inline int64_t pack_key (float f, uint32_t i)
+            {
+                uint32_t u;
+                std::memcpy (&u, &f, sizeof(u));
+                u = (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+                return static_cast<int64_t>(((static_cast<uint64_t>(u) << 32) | i) ^ (uint64_t{1} << 63));
+            }
+        } // namespace detail
+
+        //! Sort a into ascending order
+        template <typename T>
+        void sort (morph::vVector<T>& a)
+        {
+            detail::sort<typename detail::kernels_for<T>::type> (a.data(), a.size());
+        }
+
+        //! Set idx so that a[idx[0]] <= a[idx[1]] <= ... Equal elements keep their order.
+        inline void argsort (const morph::vVector<float>& a, morph::vVector<size_t>& idx)
+        {
+            const size_t n = a.size();
+            if (n > std::numeric_limits<uint32_t>::max()) { throw std::runtime_error ("argsort: more than 2^32 elements"); }
+            std::vector<int64_t> keys (n);
+            const long long nl = static_cast<long long>(n);
+#pragma omp parallel for
+            for (long long i = 0; i < nl; ++i) { keys[i] = detail::pack_key (a[i], static_cast<uint32_t>(i)); }
+            detail::sort<detail::i64x4> (keys.data(), n);
+            if (idx.size() != n) { idx.resize (n); }
+#pragma omp parallel for
+            for (long long i = 0; i < nl; ++i) { idx[i] = static_cast<uint32_t>(keys[i]); }
+        }
+
+        //! argsort for element types without a packed key: sorts indices with std::stable_sort
+        template <typename T>
+        void argsort (const morph::vVector<T>& a, morph::vVector<size_t>& idx)
+        {
+            if (idx.size() != a.size()) { idx.resize (a.size()); }
+            for (size_t i = 0; i < a.size(); ++i) { idx[i] = i; }
+            std::stable_sort (idx.begin(), idx.end(), [&a](size_t i, size_t j) { return a[i] < a[j]; });
+        }
+
+        //! Rearrange a like std::nth_element and return a[k]
+        template <typename T>
+        T nth_element (morph::vVector<T>& a, size_t k)
+        {
+            if (k >= a.size()) { throw std::runtime_error ("nth_element: k out of range"); }
+            detail::select_ranks<typename detail::kernels_for<T>::type> (a.data(), a.size(), std::vector<size_t>{ k });
+            return a[k];
+        }
+
+        //! The q quantiles of a, each q in [0, 1], interpolating linearly between order statistics
+        template <typename T>
+        std::vector<T> quantiles (const morph::vVector<T>& a, const std::vector<double>& q)
+        {
+            const size_t n = a.size();
+            if (n == 0) { throw std::runtime_error ("quantiles: empty vVector"); }
+            std::vector<size_t> ranks;
+            for (double qi : q) {
+                if (!(qi >= 0.0 && qi <= 1.0)) { throw std::runtime_error ("quantiles: q must be in [0, 1]"); }
+                const double r = qi * (n - 1);
+                ranks.push_back (static_cast<size_t>(std::floor (r)));
+                ranks.push_back (static_cast<size_t>(std::ceil (r)));
+            }
+            std::sort (ranks.begin(), ranks.end());
+            ranks.erase (std::unique (ranks.begin(), ranks.end()), ranks.end());
+            morph::vVector<T> work = a;
+            detail::select_ranks<typename detail::kernels_for<T>::type> (work.data(), n, ranks);
+            std::vector<T> result;
+            for (double qi : q) {
+                const double r = qi * (n - 1);
+                const size_t lo = static_cast<size_t>(std::floor (r));
+                const size_t hi = static_cast<size_t>(std::ceil (r));
+                result.push_back (static_cast<T>(work[lo] + (r - lo) * (work[hi] - work[lo])));
+            }
+            return result;
+        }
+
+        //! The median of a
+        template <typename T>
+        T median (const morph::vVector<T>& a) { return quantiles (a, { 0.5 })[0]; }
+
+    } // namespace order
+} // namespace cc
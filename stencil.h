@@ -0,0 +1,407 @@
+/*
+ * Stencils over 1-D and 2-D fields held in a vVector (row major, x fastest): the
+ * Laplacian, arbitrary neighbourhoods given as (dx, dy, weight) taps, and rolling window
+ * sums, means, maxima and minima. The grid is swept in tiles of tile_x columns by tile_y
+ * rows so that the rows a stencil reads stay in cache across a tile however wide the
+ * field is, the tiles are shared out over OpenMP threads, and within a row the interior
+ * (where every tap is in range) is done with SIMD, leaving the scalar boundary handling
+ * to the few cells within a stencil radius of the edges.
+ *
+ *   cc::stencil::laplacian (u, nx, ny, lap, 1.0f / (h * h), cc::stencil::periodic);
+ *   cc::stencil::stencil s = cc::stencil::stencil::moore (1, 1.0);  // sum of the 8 neighbours
+ *   cc::stencil::apply (s, u, nx, ny, out, cc::stencil::clamp);
+ *   cc::stencil::rolling (a, 9, cc::stencil::mean, out, cc::stencil::clamp); // centred window of 9
+ *
+ * Boundaries: periodic wraps; clamp repeats the edge cell (zero flux for the Laplacian);
+ * zero treats everything outside the field as 0.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <immintrin.h>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+#if !defined(__AVX2__)
+# error "stencil.h needs at least -mavx2"
+#endif
+
+namespace cc {
+    namespace stencil {
+
+        //! What lies beyond the edges of the field
+        enum boundary { periodic, clamp, zero };
+
+        //! Columns and rows per tile
+        inline size_t tile_x = 2048;
+        inline size_t tile_y = 32;
+        //! Below this many cells, sweep on the calling thread
+        inline size_t parallel_min = 1 << 16;
+
+        //! One term of a stencil: weight * a[x + dx, y + dy]
+        struct tap
+        {
+            int dx;
+            int dy;
+            double w;
+        };
+
+        //! A linear stencil: out[x, y] = sum over the taps of w * a[x + dx, y + dy]
+        struct stencil
+        {
+            std::vector<tap> taps;
+
+            int radius_x() const
+            {
+                int r = 0;
+                for (const auto& t : this->taps) { r = std::max (r, std::abs (t.dx)); }
+                return r;
+            }
+            int radius_y() const
+            {
+                int r = 0;
+                for (const auto& t : this->taps) { r = std::max (r, std::abs (t.dy)); }
+                return r;
+            }
+
+            //! The 3 point 1-D Laplacian, times scale
+            static stencil laplacian1d (double scale = 1.0)
+            {
+                return stencil{ { { -1, 0, scale }, { 0, 0, -2.0 * scale }, { 1, 0, scale } } };
+            }
+            //! The 5 point 2-D Laplacian, times scale
+            static stencil laplacian5 (double scale = 1.0)
+            {
+                return stencil{ { { 0, -1, scale }, { -1, 0, scale }, { 0, 0, -4.0 * scale }, { 1, 0, scale }, { 0, 1, scale } } };
+            }
+            //! The 9 point (isotropic, Oono-Puri) 2-D Laplacian, times scale
+            static stencil laplacian9 (double scale = 1.0)
+            {
+                const double e = 0.5 * scale, c = 0.25 * scale;
+                return stencil{ { { -1, -1, c }, { 0, -1, e }, { 1, -1, c },
+                                  { -1, 0, e }, { 0, 0, -3.0 * scale }, { 1, 0, e },
+                                  { -1, 1, c }, { 0, 1, e }, { 1, 1, c } } };
+            }
+            //! w times each cell within Chebyshev distance r, excluding the centre
+            static stencil moore (int r, double w)
+            {
+                stencil s;
+                for (int dy = -r; dy <= r; ++dy) {
+                    for (int dx = -r; dx <= r; ++dx) { if (dx || dy) { s.taps.push_back ({ dx, dy, w }); } }
+                }
+                return s;
+            }
+            //! w times each cell within Manhattan distance r, excluding the centre
+            static stencil von_neumann (int r, double w)
+            {
+                stencil s;
+                for (int dy = -r; dy <= r; ++dy) {
+                    for (int dx = -r; dx <= r; ++dx) { if ((dx || dy) && std::abs (dx) + std::abs (dy) <= r) { s.taps.push_back ({ dx, dy, w }); } }
+                }
+                return s;
+            }
+        };
+
+        //! Rolling window reductions
+        enum window { sum, mean, max, min };
+
+        namespace detail {
+
+            template <typename T> struct simd;
+#if defined(__AVX512F__)
+            template <>
+            struct simd<float>
+            {
+                typedef __m512 reg;
+                static constexpr size_t n = 16;
+                static reg load (const float* p) { return _mm512_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm512_storeu_ps (p, v); }
+                static reg set1 (float f) { return _mm512_set1_ps (f); }
+                static reg zero() { return _mm512_setzero_ps(); }
+                static reg add (reg a, reg b) { return _mm512_add_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_ps (a, b); }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m512d reg;
+                static constexpr size_t n = 8;
+                static reg load (const double* p) { return _mm512_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm512_storeu_pd (p, v); }
+                static reg set1 (double f) { return _mm512_set1_pd (f); }
+                static reg zero() { return _mm512_setzero_pd(); }
+                static reg add (reg a, reg b) { return _mm512_add_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm512_mul_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm512_max_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm512_min_pd (a, b); }
+            };
+#else
+            template <>
+            struct simd<float>
+            {
+                typedef __m256 reg;
+                static constexpr size_t n = 8;
+                static reg load (const float* p) { return _mm256_loadu_ps (p); }
+                static void store (float* p, reg v) { _mm256_storeu_ps (p, v); }
+                static reg set1 (float f) { return _mm256_set1_ps (f); }
+                static reg zero() { return _mm256_setzero_ps(); }
+                static reg add (reg a, reg b) { return _mm256_add_ps (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_ps (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_ps (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_ps (a, b); }
+            };
+            template <>
+            struct simd<double>
+            {
+                typedef __m256d reg;
+                static constexpr size_t n = 4;
+                static reg load (const double* p) { return _mm256_loadu_pd (p); }
+                static void store (double* p, reg v) { _mm256_storeu_pd (p, v); }
+                static reg set1 (double f) { return _mm256_set1_pd (f); }
+                static reg zero() { return _mm256_setzero_pd(); }
+                static reg add (reg a, reg b) { return _mm256_add_pd (a, b); }
+                static reg mul (reg a, reg b) { return _mm256_mul_pd (a, b); }
+                static reg max (reg a, reg b) { return _mm256_max_pd (a, b); }
+                static reg min (reg a, reg b) { return _mm256_min_pd (a, b); }
+            };
+#endif
+
+            //! Map the coordinate i of a line of n cells to [0, n), or -1 for outside a zero boundary
+            inline long map (long i, long n, boundary b)
+            {
+                if (i >= 0 && i < n) { return i; }
+                if (b == periodic) { return ((i % n) + n) % n; }
+                if (b == clamp) { return i < 0 ? 0 : n - 1; }
+                return -1;
+            }
+
+            //! Call fn(k) for each of nk tiles; on this thread if there are fewer than parallel_min cells
+            template <typename Fn>
+            inline void for_tiles (long long nk, size_t cells, Fn fn)
+            {
+                if (nk == 1 || cells < parallel_min) {
+                    for (long long k = 0; k < nk; ++k) { fn (k); }
+                } else {
+#pragma omp parallel for schedule(static)
+                    for (long long k = 0; k < nk; ++k) { fn (k); }
+                }
+            }
+
+            /*!
+             * Apply the nt taps to columns [x0, x1) of one row. rp[t] is the start of the row
+             * that tap t reads (already mapped for dy), dx[t] and w[t] its offset and weight.
+             * NT is the tap count when it's known at compile time (so the loop over taps
+             * unrolls), 0 otherwise.
+             */
+            template <size_t NT, typename T>
+            void row (const T* const* rp, const int* dx, const T* w, size_t nt, T* o, long x0, long x1, long nx, long rx, boundary b)
+            {
+                typedef simd<T> S;
+                if constexpr (NT > 0) { nt = NT; }
+                auto cell = [&](long x) {
+                    T acc = T{0};
+                    for (size_t t = 0; t < nt; ++t) {
+                        const long xs = map (x + dx[t], nx, b);
+                        if (xs >= 0) { acc += w[t] * rp[t][xs]; }
+                    }
+                    o[x] = acc;
+                };
+                const long lo = std::min (std::max (x0, rx), x1);
+                const long hi = std::max (lo, std::min (x1, nx - rx));
+                long x = x0;
+                for (; x < lo; ++x) { cell (x); }
+                typename S::reg vw[NT > 0 ? NT : 1];
+                if constexpr (NT > 0) { for (size_t t = 0; t < NT; ++t) { vw[t] = S::set1 (w[t]); } }
+                for (; x + static_cast<long>(2 * S::n) <= hi; x += 2 * S::n) {
+                    typename S::reg a0 = S::zero(), a1 = S::zero();
+                    for (size_t t = 0; t < nt; ++t) {
+                        typename S::reg wt;
+                        if constexpr (NT > 0) { wt = vw[t]; } else { wt = S::set1 (w[t]); }
+                        const T* p = rp[t] + x + dx[t];
+                        a0 = S::add (a0, S::mul (wt, S::load (p)));
+                        a1 = S::add (a1, S::mul (wt, S::load (p + S::n)));
+                    }
+                    S::store (o + x, a0);
+                    S::store (o + x + S::n, a1);
+                }
+                for (; x < hi; ++x) {
+                    T acc = T{0};
+                    for (size_t t = 0; t < nt; ++t) { acc += w[t] * rp[t][x + dx[t]]; }
+                    o[x] = acc;
+                }
+                for (; x < x1; ++x) { cell (x); }
+            }
+
+            template <size_t NT, typename T>
+            void sweep (const stencil& s, const T* a, size_t nx, size_t ny, T* o, boundary b)
+            {
+                const size_t nt = s.taps.size();
+                std::vector<int> dx (nt), dy (nt);
+                std::vector<T> w (nt);
+                for (size_t t = 0; t < nt; ++t) {
+                    dx[t] = s.taps[t].dx;
+                    dy[t] = s.taps[t].dy;
+                    w[t] = static_cast<T>(s.taps[t].w);
+                }
+                const long rx = s.radius_x();
+                // The row that a tap reads beyond a zero boundary
+                std::vector<T> zeros (b == zero && s.radius_y() > 0 ? nx : 0, T{0});
+
+                const size_t tx = std::max (size_t{1}, tile_x);
+                const size_t ty = std::max (size_t{1}, tile_y);
+                const long long ntx = (nx + tx - 1) / tx;
+                const long long nty = (ny + ty - 1) / ty;
+                for_tiles (ntx * nty, nx * ny, [&](long long k) {
+                    const long x0 = (k % ntx) * tx;
+                    const long x1 = std::min (static_cast<long>(nx), x0 + static_cast<long>(tx));
+                    const size_t y0 = (k / ntx) * ty;
+                    const size_t y1 = std::min (ny, y0 + ty);
+                    // Row pointers on the stack when the tap count is fixed: no allocation per tile
+                    const T* rp_fixed[NT > 0 ? NT : 1];
+                    std::vector<const T*> rp_any (NT > 0 ? 0 : nt);
+                    const T** rp = NT > 0 ? rp_fixed : rp_any.data();
+                    for (size_t y = y0; y < y1; ++y) {
+                        for (size_t t = 0; t < nt; ++t) {
+                            const long ys = map (static_cast<long>(y) + dy[t], ny, b);
+                            rp[t] = ys >= 0 ? a + ys * nx : zeros.data();
+                        }
+                        row<NT> (rp, dx.data(), w.data(), nt, o + y * nx, x0, x1, static_cast<long>(nx), rx, b);
+                    }
+                });
+            }
+
+            template <typename T>
+            void check (const morph::vVector<T>& a, size_t nx, size_t ny, morph::vVector<T>& out)
+            {
+                if (a.size() != nx * ny) { throw std::runtime_error ("stencil: field size is not nx * ny"); }
+                if (&a == &out) { throw std::runtime_error ("stencil: out must not be the input"); }
+                if (out.size() != a.size()) { out.resize (a.size()); }
+            }
+
+            //! Rolling sum of width w (odd) over columns [x0, x1), a running sum kept in double
+            template <typename T>
+            void rolling_sum (const T* a, long n, long w, long x0, long x1, boundary b, double scale, T* o)
+            {
+                const long h = w / 2;
+                auto at = [&](long i) { const long m = map (i, n, b); return m >= 0 ? static_cast<double>(a[m]) : 0.0; };
+                double s = 0.0;
+                for (long i = x0 - h; i <= x0 + h; ++i) { s += at (i); }
+                o[x0] = static_cast<T>(s * scale);
+                for (long x = x0 + 1; x < x1; ++x) {
+                    s += at (x + h) - at (x - h - 1);
+                    o[x] = static_cast<T>(s * scale);
+                }
+            }
+
+            /*!
+             * Rolling max (or min) of width w over columns [x0, x1), by van Herk/Gil-Werman:
+             * running maxima forward and backward within blocks of w, so that every window,
+             * which spans at most two blocks, is the max of one of each. Three comparisons a
+             * cell whatever w is.
+             */
+            template <bool Max, typename T>
+            void rolling_extreme (const T* a, long n, long w, long x0, long x1, boundary b, T* o)
+            {
+                typedef simd<T> S;
+                const long h = w / 2;
+                const long len = x1 - x0 + 2 * h;
+                std::vector<T> e (len), fwd (len), bwd (len);
+                for (long j = 0; j < len; ++j) {
+                    const long m = map (x0 - h + j, n, b);
+                    e[j] = m >= 0 ? a[m] : T{0};
+                }
+                auto op = [](T p, T q) { return Max ? std::max (p, q) : std::min (p, q); };
+                for (long j0 = 0; j0 < len; j0 += w) {
+                    const long j1 = std::min (len, j0 + w);
+                    fwd[j0] = e[j0];
+                    for (long j = j0 + 1; j < j1; ++j) { fwd[j] = op (fwd[j - 1], e[j]); }
+                    bwd[j1 - 1] = e[j1 - 1];
+                    for (long j = j1 - 2; j >= j0; --j) { bwd[j] = op (bwd[j + 1], e[j]); }
+                }
+                // The window for x0 + j is e[j, j + w): bwd[j] covers its first block, fwd[j + w - 1] its second
+                const long m = x1 - x0;
+                long j = 0;
+                for (; j + static_cast<long>(S::n) <= m; j += S::n) {
+                    const typename S::reg p = S::load (bwd.data() + j), q = S::load (fwd.data() + j + w - 1);
+                    S::store (o + x0 + j, Max ? S::max (p, q) : S::min (p, q));
+                }
+                for (; j < m; ++j) { o[x0 + j] = op (bwd[j], fwd[j + w - 1]); }
+            }
+        } // namespace detail
+
+        //! Apply the stencil s to the nx by ny field a, writing out (which must not be a)
+        template <typename T>
+        void apply (const stencil& s, const morph::vVector<T>& a, size_t nx, size_t ny, morph::vVector<T>& out, boundary b)
+        {
+            detail::check (a, nx, ny, out);
+            if (a.empty()) { return; }
+            // The common tap counts get their tap loop unrolled
+            switch (s.taps.size()) {
+            case 3: detail::sweep<3> (s, a.data(), nx, ny, out.data(), b); break;
+            case 5: detail::sweep<5> (s, a.data(), nx, ny, out.data(), b); break;
+            case 9: detail::sweep<9> (s, a.data(), nx, ny, out.data(), b); break;
+            default: detail::sweep<0> (s, a.data(), nx, ny, out.data(), b); break;
+            }
+        }
+
+        //! Apply the stencil s, which must have only dy = 0 taps, to the 1-D field a
+        template <typename T>
+        void apply (const stencil& s, const morph::vVector<T>& a, morph::vVector<T>& out, boundary b)
+        {
+            if (s.radius_y() != 0) { throw std::runtime_error ("stencil: a 1-D field needs a stencil with dy = 0"); }
+            apply (s, a, a.size(), 1, out, b);
+        }
+
+        //! out = scale * the 5 point Laplacian of the nx by ny field a
+        template <typename T>
+        void laplacian (const morph::vVector<T>& a, size_t nx, size_t ny, morph::vVector<T>& out, T scale, boundary b)
+        {
+            apply (stencil::laplacian5 (scale), a, nx, ny, out, b);
+        }
+
+        //! out = scale * the 3 point Laplacian of the 1-D field a
+        template <typename T>
+        void laplacian (const morph::vVector<T>& a, morph::vVector<T>& out, T scale, boundary b)
+        {
+            apply (stencil::laplacian1d (scale), a, a.size(), 1, out, b);
+        }
+
+        //! out[i] = the sum, mean, max or min of a over the centred window [i - w/2, i + w/2], w odd
+        template <typename T>
+        void rolling (const morph::vVector<T>& a, size_t w, window op, morph::vVector<T>& out, boundary b)
+        {
+            if (w % 2 == 0) { throw std::runtime_error ("stencil: the rolling window must have an odd width"); }
+            const size_t n = a.size();
+            detail::check (a, n, 1, out);
+            if (n == 0) { return; }
+            const long h = static_cast<long>(w / 2);
+            if ((op == sum || op == mean) && w <= 17) {
+                // Narrow enough to be a SIMD stencil
+                stencil s;
+                const double wt = op == mean ? 1.0 / w : 1.0;
+                for (long dx = -h; dx <= h; ++dx) { s.taps.push_back ({ static_cast<int>(dx), 0, wt }); }
+                apply (s, a, n, 1, out, b);
+                return;
+            }
+            const size_t tx = std::max (size_t{1}, tile_x);
+            const long long nk = (n + tx - 1) / tx;
+            const T* ap = a.data();
+            T* op_ = out.data();
+            detail::for_tiles (nk, n, [&](long long k) {
+                const long x0 = k * tx;
+                const long x1 = std::min (static_cast<long>(n), x0 + static_cast<long>(tx));
+                switch (op) {
+                case sum: detail::rolling_sum (ap, n, w, x0, x1, b, 1.0, op_); break;
+                case mean: detail::rolling_sum (ap, n, w, x0, x1, b, 1.0 / w, op_); break;
+                case max: detail::rolling_extreme<true> (ap, n, w, x0, x1, b, op_); break;
+                case min: detail::rolling_extreme<false> (ap, n, w, x0, x1, b, op_); break;
+                }
+            });
+        }
+
+    } // namespace stencil
+} // namespace cc
@@ -0,0 +1,276 @@
+/*
+ * A streaming executor for vVector elementwise ops on data that is too large to hold in
+ * memory. The input is read from a file of raw F values in cache-sized chunks. Each
+ * chunk is passed through a chain of operations (scale, mult, div, pow) and then
+ * reduced into a running sum. Reads are double-buffered: the next chunk is read on a
+ * prefetch thread (one per run) while the current chunk is computed, so that a large
+ * enough dataset runs at the disk's bandwidth rather than at (disk + compute) speed.
+ *
+ * Peak memory use is 2 buffers per input source, independent of the file size.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <cstddef>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+namespace cc {
+
+    /*!
+     * A file of raw F values, read one chunk at a time with pread, so that two reads can
+     * be in flight from different threads without sharing a file position.
+     */
+    template <typename F>
+    struct stream_source
+    {
+        stream_source (const std::string& path)
+        {
+            this->fd = open (path.c_str(), O_RDONLY);
+            if (this->fd < 0) {
+                throw std::runtime_error ("stream_source: can't open " + path + ": " + std::strerror (errno));
+            }
+            off_t bytes = lseek (this->fd, 0, SEEK_END);
+            if (bytes < 0) {
+                const std::string err = std::strerror (errno);
+                close (this->fd);
+                throw std::runtime_error ("stream_source: can't find the size of " + path + ": " + err);
+            }
+            this->n_elements = static_cast<size_t>(bytes) / sizeof(F);
+#ifdef __GLN__
+            posix_fadvise (this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        }
+        ~stream_source() { if (this->fd >= 0) { close (this->fd); } }
+
+        stream_source (const stream_source&) = delete;
+        stream_source& operator= (const stream_source&) = delete;
+
+        /*!
+         * Read chunk number chunk_idx into buf. buf is resized to the number of elements
+         * actually read (which is only less than chunk_len for the last chunk, and zero
+         * past the end of the file). Resizing down never reallocates, so buf's storage is
+         * reused from chunk to chunk.
+         */
+        size_t read_chunk (morph::vVector<F>& buf, size_t chunk_idx, size_t chunk_len) const
+        {
+            size_t first = chunk_idx * chunk_len;
+            size_t n = first < this->n_elements ? std::min (chunk_len, this->n_elements - first) : 0;
+            buf.resize (n);
+            char* p = reinterpret_cast<char*>(buf.data());
+            size_t want = n * sizeof(F);
+            off_t offset = static_cast<off_t>(first * sizeof(F));
+            while (want > 0) {
+                ssize_t got = pread (this->fd, p, want, offset);
+                if (got < 0 && errno == EINTR) { continue; }
+                if (got <= 0) {
+                    throw std::runtime_error (std::string("stream_source: read failed: ") + std::strerror (errno));
+                }
+                p += got;
+                offset += got;
+                want -= static_cast<size_t>(got);
+            }
+#ifdef __GLN__
+            // We won't come back to this chunk, so don't let it push other data out of the page cache
+            posix_fadvise (this->fd, static_cast<off_t>(first * sizeof(F)), static_cast<off_t>(n * sizeof(F)), POSIX_FADV_DONTNEED);
+#endif
+            return n;
+        }
+
+        int fd = -1;
+        size_t n_elements = 0;
+    };
+
+    namespace detail {
+        /*!
+         * One long-lived reader thread that runs fetch(slot, chunk_idx) on request, so a
+         * pipeline run doesn't start a thread per chunk. One request is in flight at a time;
+         * wait() returns its result, or rethrows what it threw. The thread is stopped and
+         * joined on destruction, including when the run is unwinding from an exception.
+         */
+        class prefetch_thread
+        {
+        public:
+            template <typename Fetch>
+            prefetch_thread (Fetch fetch)
+            {
+                this->reader = std::thread ([this, fetch]() {
+                    std::unique_lock<std::mutex> lk (this->m);
+                    for (;;) {
+                        this->cv.wait (lk, [this] { return this->requested || this->stop; });
+                        if (this->stop) { return; }
+                        this->requested = false;
+                        const int slot = this->req_slot;
+                        const size_t chunk_idx = this->req_chunk;
+                        lk.unlock();
+                        size_t n = 0;
+                        std::exception_ptr e;
+                        try { n = fetch (slot, chunk_idx); } catch (...) { e = std::current_exception(); }
+                        lk.lock();
+                        this->got = n;
+                        this->failed = e;
+                        this->done = true;
+                        this->cv.notify_all();
+                    }
+                });
+            }
+            ~prefetch_thread()
+            {
+                {
+                    std::lock_guard<std::mutex> lk (this->m);
+                    this->stop = true;
+                }
+                this->cv.notify_all();
+                this->reader.join();
+            }
+            prefetch_thread (const prefetch_thread&) = delete;
+            prefetch_thread& operator= (const prefetch_thread&) = delete;
+
+            //! Start reading chunk_idx into buffer slot
+            void request (int slot, size_t chunk_idx)
+            {
+                {
+                    std::lock_guard<std::mutex> lk (this->m);
+                    this->req_slot = slot;
+                    this->req_chunk = chunk_idx;
+                    this->requested = true;
+                    this->done = false;
+                }
+                this->cv.notify_all();
+            }
+
+            //! Wait for the last request, and return the number of elements it read
+            size_t wait()
+            {
+                std::unique_lock<std::mutex> lk (this->m);
+                this->cv.wait (lk, [this] { return this->done; });
+                this->done = false;
+                if (this->failed) { std::rethrow_exception (this->failed); }
+                return this->got;
+            }
+
+        private:
+            std::mutex m;
+            std::condition_variable cv;
+            bool requested = false;
+            bool done = false;
+            bool stop = false;
+            int req_slot = 0;
+            size_t req_chunk = 0;
+            size_t got = 0;
+            std::exception_ptr failed;
+            std::thread reader;
+        };
+    } // namespace detail
+
+    /*!
+     * A chain of elementwise operations applied chunk by chunk to one (or, for mult and
+     * div, two) stream_sources, ending in a sum reduction. Usage:
+     *
+     *   cc::stream_pipeline<float> p;
+     *   p.scale (2.0f).pow (0.5f);
+     *   double s = p.run (cc::stream_source<float>("data.bin"));
+     */
+    template <typename F>
+    struct stream_pipeline
+    {
+        //! Elements per chunk. The default 64K floats (256 KB) keeps a chunk plus its
+        //! operand in L2 on most current hosts.
+        size_t chunk_len = 65536;
+
+        //! Multiply each element by s
+        stream_pipeline<F>& scale (const F s)
+        {
+            this->ops.push_back ([s](morph::vVector<F>& a, const morph::vVector<F>&) { a *= s; });
+            return *this;
+        }
+        //! Multiply each element by the corresponding element of the second source
+        stream_pipeline<F>& mult()
+        {
+            this->needs_b = true;
+            this->ops.push_back ([](morph::vVector<F>& a, const morph::vVector<F>& b) { a *= b; });
+            return *this;
+        }
+        //! Divide each element by the corresponding element of the second source
+        stream_pipeline<F>& div()
+        {
+            this->needs_b = true;
+            this->ops.push_back ([](morph::vVector<F>& a, const morph::vVector<F>& b) { a /= b; });
+            return *this;
+        }
+        //! Raise each element to the power p
+        stream_pipeline<F>& pow (const F p)
+        {
+            this->ops.push_back ([p](morph::vVector<F>& a, const morph::vVector<F>&) { a.pow_inplace (p); });
+            return *this;
+        }
+
+        //! Stream a through the op chain and return the sum of the results
+        double run (const stream_source<F>& a)
+        {
+            if (this->needs_b) { throw std::runtime_error ("stream_pipeline: mult/div need a second source"); }
+            return this->run_impl (a, nullptr);
+        }
+
+        //! Stream a and b in lockstep through the op chain and return the sum of the results
+        double run (const stream_source<F>& a, const stream_source<F>& b)
+        {
+            if (a.n_elements != b.n_elements) { throw std::runtime_error ("stream_pipeline: sources differ in length"); }
+            return this->run_impl (a, &b);
+        }
+
+        //! Number of bytes read by the last run (for computing bandwidth)
+        size_t bytes_read = 0;
+
+    private:
+        double run_impl (const stream_source<F>& a, const stream_source<F>* b)
+        {
+            this->bytes_read = 0;
+            // Two buffers per source. While ops run on buffer [cur], buffer [1-cur] is filled.
+            morph::vVector<F> abuf[2];
+            morph::vVector<F> bbuf[2];
+            for (int i = 0; i < 2; ++i) {
+                abuf[i].reserve (this->chunk_len);
+                if (b != nullptr) { bbuf[i].reserve (this->chunk_len); }
+            }
+
+            auto fetch = [this, &a, b, &abuf, &bbuf](int slot, size_t chunk_idx) -> size_t {
+                size_t n = a.read_chunk (abuf[slot], chunk_idx, this->chunk_len);
+                if (b != nullptr) { b->read_chunk (bbuf[slot], chunk_idx, this->chunk_len); }
+                return n;
+            };
+
+            double total = 0.0;
+            int cur = 0;
+            // Declared after the buffers, so it's joined before they're destroyed
+            detail::prefetch_thread prefetch (fetch);
+            prefetch.request (cur, 0);
+            for (size_t chunk_idx = 0; ; ++chunk_idx) {
+                size_t n = prefetch.wait();
+                if (n == 0) { break; }
+                this->bytes_read += n * sizeof(F) * (b != nullptr ? 2 : 1);
+                prefetch.request (1 - cur, chunk_idx + 1);
+                for (auto& op : this->ops) { op (abuf[cur], bbuf[cur]); }
+                total += static_cast<double>(abuf[cur].sum());
+                cur = 1 - cur;
+            }
+            return total;
+        }
+
+        std::vector<std::function<void(morph::vVector<F>&, const morph::vVector<F>&)>> ops;
+        bool needs_b = false;
+    };
+
+} // namespace cc
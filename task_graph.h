@@ -0,0 +1,133 @@
+/*
+ * Asynchronous and deferred vVector operations on a cc::thread_pool.
+ *
+ * cc::run_async submits one callable and returns a std::future for its result:
+ *
+ *   std::future<float> s = cc::run_async (pool, [&]() { return v.sum(); });
+ *
+ * Wait on such futures from outside the pool only (see run_async).
+ *
+ * cc::task_graph records tasks and the tasks they depend on, then runs the whole graph,
+ * starting each task as soon as its dependencies have finished. Independent chains run
+ * concurrently:
+ *
+ *   cc::task_graph g;
+ *   auto m = g.add ([&]() { cc::par::mult (pool, a, b, ab); });
+ *   auto d = g.add ([&]() { cc::par::div (pool, a, b, a_b); });
+ *   g.add ([&]() { total = ab.sum() + a_b.sum(); }, { m, d });
+ *   g.run (pool);
+ *
+ * Tasks may themselves use the pool (for example through cc::par ops); threads waiting on
+ * those inner parallel_fors run other tasks meanwhile.
+ */
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <future>
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include "parallel_backend.h"
+
+namespace cc {
+
+    /*!
+     * Run fn on the pool, returning a future for its result. Don't get() or wait() on the
+     * future from one of the pool's own threads (inside a task or a parallel_for body): a
+     * pool thread blocked on a future doesn't run other work meanwhile, so once every
+     * thread is waiting like that, fn is never run and the pool deadlocks.
+     */
+    template <typename Fn>
+    auto run_async (thread_pool& pool, Fn fn) -> std::future<std::invoke_result_t<Fn>>
+    {
+        typedef std::invoke_result_t<Fn> R;
+        auto task = std::make_shared<std::packaged_task<R()>> (std::move (fn));
+        std::future<R> f = task->get_future();
+        pool.submit ([task]() { (*task)(); });
+        return f;
+    }
+
+    class task_graph
+    {
+    public:
+        typedef size_t task_id;
+
+        //! Record fn, to run after all of the tasks in deps. Returns the new task's id.
+        task_id add (std::function<void()> fn, std::initializer_list<task_id> deps = {})
+        {
+            return this->add (std::move (fn), std::vector<task_id>(deps));
+        }
+
+        task_id add (std::function<void()> fn, const std::vector<task_id>& deps)
+        {
+            task_id id = this->nodes.size();
+            for (task_id d : deps) {
+                if (d >= id) { throw std::runtime_error ("task_graph: a task can only depend on earlier tasks"); }
+                this->nodes[d]->successors.push_back (id);
+            }
+            this->nodes.emplace_back (new node);
+            this->nodes.back()->fn = std::move (fn);
+            this->nodes.back()->n_deps = deps.size();
+            return id;
+        }
+
+        size_t size() const { return this->nodes.size(); }
+
+        /*!
+         * Run every task, each once its dependencies are done, and return when all have
+         * finished. The graph can be run again. If a task throws, the remaining tasks
+         * still run and the first exception is rethrown from here.
+         */
+        void run (thread_pool& pool)
+        {
+            for (auto& n : this->nodes) { n->remaining.store (n->n_deps); }
+            this->unfinished.store (this->nodes.size());
+            this->error = nullptr;
+            for (task_id i = 0; i < this->nodes.size(); ++i) {
+                if (this->nodes[i]->n_deps == 0) { this->launch (pool, i); }
+            }
+            pool.wait ([this]() { return this->unfinished.load (std::memory_order_acquire) == 0; });
+            if (this->error) { std::rethrow_exception (this->error); }
+        }
+
+        //! Run the tasks one after another on the calling thread, in the order they were added
+        void run_serial()
+        {
+            for (auto& n : this->nodes) { n->fn(); }
+        }
+
+    private:
+        struct node
+        {
+            std::function<void()> fn;
+            std::vector<task_id> successors;
+            size_t n_deps = 0;
+            std::atomic<size_t> remaining {0};
+        };
+
+        void launch (thread_pool& pool, task_id i)
+        {
+            pool.submit ([this, &pool, i]() {
+                try {
+                    this->nodes[i]->fn();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lk (this->error_m);
+                    if (!this->error) { this->error = std::current_exception(); }
+                }
+                for (task_id s : this->nodes[i]->successors) {
+                    if (this->nodes[s]->remaining.fetch_sub (1, std::memory_order_acq_rel) == 1) { this->launch (pool, s); }
+                }
+                this->unfinished.fetch_sub (1, std::memory_order_release);
+            });
+        }
+
+        std::vector<std::unique_ptr<node>> nodes;
+        std::atomic<size_t> unfinished {0};
+        std::mutex error_m;
+        std::exception_ptr error;
+    };
+
+} // namespace cc
@@ -0,0 +1,123 @@
+/*
+ * Temporal blocking: tile the iteration loop together with the data loop, so that a
+ * cache-sized block of a vVector gets several successive passes before the next block is
+ * touched, instead of every pass streaming the whole vector from DRAM.
+ *
+ * Pointwise passes, where pass it at element i reads only element i (of any vector,
+ * written by any earlier pass), can be blocked with no restriction: each block runs every
+ * pass in order, and blocks are independent, so they're shared out over OpenMP threads.
+ *
+ *   // for (it = 0; it < 500; ++it) { v = v * s + c; } with 500 passes per block
+ *   cc::tblock::pointwise (v.size(), 500, cc::tblock::block_for<float> (1), [&](size_t it, size_t i0, size_t i1) {
+ *       for (size_t i = i0; i < i1; ++i) { v[i] = v[i] * s + c; }
+ *   });
+ *
+ * Stencil passes, where pass it at i reads pass it - 1 at [i - r, i + r], are blocked
+ * with overlapped (ghost zone) tiles: for depth passes at a time, each block copies itself
+ * plus depth * r halo cells either side into private scratch, runs the passes over a range
+ * that shrinks by r a pass (recomputing the halo, which is the price of independence), and
+ * writes its own cells of the result. The vector then crosses DRAM once per depth passes.
+ *
+ *   // Jacobi smoothing: out[i] = (in[i-1] + in[i] + in[i+1]) / 3, edges clamped
+ *   cc::tblock::stencil (u, 500, 1, 16, cc::tblock::block_for<float> (2), [](size_t, const float* in, float* out, size_t i0, size_t i1, size_t n) {
+ *       for (size_t i = i0; i < i1; ++i) { out[i] = (in[i > 0 ? i - 1 : 0] + in[i] + in[i + 1 < n ? i + 1 : i]) / 3.0f; }
+ *   });
+ *
+ * The stencil op is given base pointers such that in[j] and out[j] are element j of the
+ * whole vector, but only [i0 - r, i1 + r] intersected with [0, n) is valid. So boundary
+ * handling must stay within [0, n): clamped or zero edges work, periodic ones don't.
+ */
+#pragma once
+
+#include <morph/vVector.h>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+namespace cc {
+    namespace tblock {
+
+        //! Bytes of working set a block should keep in cache (about half of a typical L2)
+        inline size_t block_bytes = 256 * 1024;
+
+        //! Elements per block for ops touching streams vectors of T, a multiple of 64
+        template <typename T>
+        size_t block_for (size_t streams)
+        {
+            const size_t b = block_bytes / (std::max (size_t{1}, streams) * sizeof(T));
+            return std::max (size_t{64}, b / 64 * 64);
+        }
+
+        namespace detail {
+            //! Call fn(k) for each of nk blocks, starting an OpenMP team only if there's more than one
+            template <typename Fn>
+            inline void for_blocks (long long nk, Fn fn)
+            {
+                if (nk == 1) {
+                    fn (0);
+                } else {
+#pragma omp parallel for schedule(static)
+                    for (long long k = 0; k < nk; ++k) { fn (k); }
+                }
+            }
+        } // namespace detail
+
+        /*!
+         * The equivalent of for (it = 0; it < iters; ++it) { op (it, 0, n); } for a pointwise
+         * op, run as op (it, i0, i1) for every pass over each block of block elements in turn.
+         */
+        template <typename Op>
+        void pointwise (size_t n, size_t iters, size_t block, Op op)
+        {
+            if (block == 0) { throw std::runtime_error ("tblock: block must be at least 1"); }
+            if (n == 0) { return; }
+            const long long nk = static_cast<long long>((n + block - 1) / block);
+            detail::for_blocks (nk, [&](long long k) {
+                const size_t i0 = k * block;
+                const size_t i1 = std::min (n, i0 + block);
+                for (size_t it = 0; it < iters; ++it) { op (it, i0, i1); }
+            });
+        }
+
+        /*!
+         * The equivalent of iters passes of a = op(a) for a stencil op of radius r, depth
+         * passes per trip through memory. op (it, in, out, i0, i1, n) computes out[i] for i in
+         * [i0, i1) from in[j] for j in [i - r, i + r] and [0, n).
+         */
+        template <typename T, typename Op>
+        void stencil (morph::vVector<T>& a, size_t iters, size_t r, size_t depth, size_t block, Op op)
+        {
+            if (block == 0 || depth == 0) { throw std::runtime_error ("tblock: block and depth must be at least 1"); }
+            const size_t n = a.size();
+            if (n == 0 || iters == 0) { return; }
+            morph::vVector<T> next (n);
+            const long long nk = static_cast<long long>((n + block - 1) / block);
+            for (size_t it0 = 0; it0 < iters; it0 += depth) {
+                const size_t d = std::min (depth, iters - it0);
+                const T* ap = a.data();
+                T* np = next.data();
+                detail::for_blocks (nk, [&](long long k) {
+                    const size_t b0 = k * block;
+                    const size_t b1 = std::min (n, b0 + block);
+                    // The block and its halo, clipped to the vector
+                    const size_t lo = b0 > d * r ? b0 - d * r : 0;
+                    const size_t hi = std::min (n, b1 + d * r);
+                    // Scratch indexed by global position: s[p][j] for j in [lo, hi)
+                    std::vector<T> s0 (ap + lo, ap + hi), s1 (hi - lo);
+                    T* s[2] = { s0.data() - lo, s1.data() - lo };
+                    for (size_t p = 0; p < d; ++p) {
+                        // After pass p only cells at least (p + 1) * r inside the halo are right,
+                        // except at the ends of the vector, where the op's boundary handling holds
+                        const size_t shrink = (p + 1) * r;
+                        const size_t i0 = lo == 0 ? 0 : lo + shrink;
+                        const size_t i1 = hi == n ? n : hi - shrink;
+                        op (it0 + p, s[p % 2], s[(p + 1) % 2], i0, i1, n);
+                    }
+                    std::copy (s[d % 2] + b0, s[d % 2] + b1, np + b0);
+                });
+                a.swap (next);
+            }
+        }
+
+    } // namespace tblock
+} // namespace cc